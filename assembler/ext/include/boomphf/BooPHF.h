@@ -613,6 +613,12 @@ class bitVector {
         return curent_rank;
     }
 
+    // SPADES LOCAL: prefetches the memory rank(pos) is going to touch
+    void prefetch(uint64_t pos) const {
+        __builtin_prefetch(_bitArray + (pos >> 6ULL));
+        __builtin_prefetch(_ranks.data() + pos / _nb_bits_per_rank_sample);
+    }
+
     uint64_t rank(uint64_t pos) const {
         uint64_t word_idx = pos / 64ULL;
         uint64_t word_offset = pos % 64;
@@ -686,6 +692,11 @@ class level{
         return bitset.get(hashi);
     }
 
+    // SPADES LOCAL
+    void prefetch(uint64_t hash_raw) const {
+        bitset.prefetch(fastrange64(hash_raw, hash_domain));
+    }
+
     uint64_t idx_begin;
     uint64_t hash_domain;
     bitVector bitset;
@@ -804,6 +815,15 @@ class mphf {
     }
 
 
+    // SPADES LOCAL: prefetches the first level of the lookup of elem, which
+    // resolves most of the elements
+    template<class elem_t>
+    void prefetch(elem_t elem) const {
+        if (!_built || _nb_levels < 2)
+            return;
+        _levels[0].prefetch(_hasher.hashpair128(elem)[0]);
+    }
+
     template<class elem_t>
     uint64_t lookup(elem_t elem) {
         if (!_built) return ULLONG_MAX;
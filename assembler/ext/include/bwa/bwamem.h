@@ -110,6 +110,14 @@ extern "C" {
 
 	extern void (*mem_fmt_fnc)(const mem_opt_t*, const bntseq_t*, struct __kstring_t*, bseq1_t*, int, const mem_aln_t*, int, const mem_aln_t*, const mem_aln_t*);
 
+	/**
+	 * Append $l bytes of $p to the output string of mem_fmt_fnc. The string
+	 * stays NUL-terminated, so binary output could use 0 as an end marker.
+	 * SPADES LOCAL.
+	 */
+	struct __kstring_t;
+	void mem_kputsn(const char *p, int l, struct __kstring_t *s);
+
 	/**
 	 * Align a batch of sequences and generate the alignments in the SAM format
 	 *
@@ -151,6 +159,18 @@ extern "C" {
 	 */
 	mem_alnreg_v mem_align1(const mem_opt_t *opt, const bwt_t *bwt, const bntseq_t *bns, const uint8_t *pac, int l_seq, const char *seq);
 
+	/**
+	 * Same as mem_align1(), but converts $seq to the 2-bit encoding in place and
+	 * uses the SMEM buffer $buf, which could be shared by consequent calls
+	 * from a single thread. SPADES LOCAL.
+	 *
+	 * @param buf    buffer allocated by mem_buf_init(); if NULL, a temporary one is used
+	 */
+	mem_alnreg_v mem_align1_buf(const mem_opt_t *opt, const bwt_t *bwt, const bntseq_t *bns, const uint8_t *pac, int l_seq, char *seq, void *buf);
+
+	void *mem_buf_init(void);
+	void mem_buf_destroy(void *buf);
+
 	/**
 	 * Generate CIGAR and forward-strand position from alignment region
 	 *
@@ -111,6 +111,10 @@ static void smem_aux_destroy(smem_aux_t *a)
 	free(a);
 }
 
+/* SPADES LOCAL: expose SMEM buffers, so they could be reused across mem_align1_buf() calls */
+void *mem_buf_init(void) { return smem_aux_init(); }
+void mem_buf_destroy(void *buf) { smem_aux_destroy((smem_aux_t*)buf); }
+
 static void mem_collect_intv(const mem_opt_t *opt, const bwt_t *bwt, int len, const uint8_t *seq, smem_aux_t *a)
 {
 	int i, k, x = 0, old_n;
@@ -87,6 +87,23 @@ mem_alnreg_v mem_align1(const mem_opt_t *opt, const bwt_t *bwt, const bntseq_t *
 	return ar;
 }
 
+/* SPADES LOCAL */
+mem_alnreg_v mem_align1_buf(const mem_opt_t *opt, const bwt_t *bwt, const bntseq_t *bns, const uint8_t *pac, int l_seq, char *seq, void *buf)
+{ // same as mem_align1(), but modifies the input sequence and uses the SMEM buffer from mem_buf_init()
+	extern mem_alnreg_v mem_align1_core(const mem_opt_t *opt, const bwt_t *bwt, const bntseq_t *bns, const uint8_t *pac, int l_seq, char *seq, void *buf);
+	extern void mem_mark_primary_se(const mem_opt_t *opt, int n, mem_alnreg_t *a, int64_t id);
+	mem_alnreg_v ar;
+	ar = mem_align1_core(opt, bwt, bns, pac, l_seq, seq, buf);
+	mem_mark_primary_se(opt, ar.n, ar.a, 42);
+	return ar;
+}
+
+/* SPADES LOCAL: kstring.h is not exported, but custom mem_fmt_fnc needs to append to the output */
+void mem_kputsn(const char *p, int l, kstring_t *s)
+{
+	kputsn(p, l, s);
+}
+
 static inline int get_pri_idx(double XA_drop_ratio, const mem_alnreg_t *a, int i)
 {
 	int k = a[i].secondary_all;
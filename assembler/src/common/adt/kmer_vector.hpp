@@ -66,7 +66,7 @@ public:
               vector_(realloc(), size_, el_sz_) {
     }
 
-    KMerVector(KMerVector &&that)
+    KMerVector(KMerVector &&that) noexcept
             : K_(that.K_), size_(that.size_), capacity_(that.capacity_), el_sz_(that.el_sz_),
               storage_(that.storage_),
               vector_(storage_, size_, el_sz_) {
@@ -133,6 +133,12 @@ public:
         }
     }
 
+    void resize(size_t amount) {
+        reserve(amount);
+        size_ = amount;
+        vector_.set_size(size_);
+    }
+
     void clear() {
         size_ = 0;
         vector_.set_size(size_);
@@ -0,0 +1,134 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace adt {
+
+// Storage for objects, which are always created and destroyed in pairs (e.g.
+// graph elements and their conjugates). Both objects of a pair are placed next
+// to each other in large slabs, so consequently allocated pairs are adjacent
+// in memory. The pool only manages memory: objects are constructed and
+// destroyed by the caller. Thread-safe.
+//
+// Pairs are handed out from the current slab by an atomic bump index without
+// locking. The lock is taken only when the slab is exhausted: then freed pairs
+// are reused first, and a new slab is added only when there are none.
+template<class T>
+class pair_pool {
+    struct Pair {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type items[2];
+    };
+
+    // Slabs are never freed before the pool, so a pointer to one stays valid
+    // for lock-free readers even after it stops being the current slab
+    struct Slab {
+        Slab(size_t n)
+                : pairs(new Pair[n]), size(n), used(0) {}
+
+        // Claims the next unused pair, nullptr if the slab is exhausted
+        Pair *bump() {
+            size_t i = used.fetch_add(1, std::memory_order_relaxed);
+            return i < size ? &pairs[i] : nullptr;
+        }
+
+        std::unique_ptr<Pair[]> pairs;
+        size_t size;
+        std::atomic<size_t> used;
+    };
+
+    static const size_t SLAB_SIZE = 1 << 12;
+
+    // Makes a new slab of n pairs current, the rest of the previous one goes to the freelist
+    void AddSlab(size_t n) {
+        Slab *old = current_.load(std::memory_order_relaxed);
+        if (old) {
+            size_t used = old->used.exchange(old->size, std::memory_order_relaxed);
+            for (size_t i = used; i < old->size; ++i)
+                free_.push_back(&old->pairs[i]);
+        }
+        slabs_.emplace_back(new Slab(n));
+        current_.store(slabs_.back().get(), std::memory_order_release);
+    }
+
+  public:
+    pair_pool()
+            : current_(nullptr), allocated_(0) {}
+
+    pair_pool(const pair_pool &) = delete;
+    pair_pool &operator=(const pair_pool &) = delete;
+
+    // Returns the storage for two adjacent objects
+    T *allocate() {
+        allocated_.fetch_add(1, std::memory_order_relaxed);
+
+        Slab *slab = current_.load(std::memory_order_acquire);
+        Pair *pair = slab ? slab->bump() : nullptr;
+        if (!pair) {
+            std::lock_guard<std::mutex> guard(lock_);
+            pair = AllocateSlow();
+        }
+
+        return reinterpret_cast<T*>(pair->items);
+    }
+
+    // Takes back the storage returned by allocate(), both objects should be destroyed
+    void deallocate(T *p) {
+        std::lock_guard<std::mutex> guard(lock_);
+        VERIFY(allocated_ > 0);
+        allocated_.fetch_sub(1, std::memory_order_relaxed);
+        free_.push_back(reinterpret_cast<Pair*>(p));
+    }
+
+    // Preallocates memory for n more pairs at once, so that they are handed
+    // out without locking
+    void reserve(size_t n) {
+        std::lock_guard<std::mutex> guard(lock_);
+        Slab *slab = current_.load(std::memory_order_relaxed);
+        size_t used = slab ? slab->used.load(std::memory_order_relaxed) : 0;
+        if (slab && used < slab->size && slab->size - used >= n)
+            return;
+        AddSlab(n);
+    }
+
+    // Number of allocated pairs
+    size_t size() const {
+        return allocated_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    Pair *AllocateSlow() {
+        // Another thread might have added a slab while we were waiting
+        Slab *slab = current_.load(std::memory_order_relaxed);
+        if (Pair *pair = slab ? slab->bump() : nullptr)
+            return pair;
+
+        if (!free_.empty()) {
+            Pair *pair = free_.back();
+            free_.pop_back();
+            return pair;
+        }
+
+        AddSlab(SLAB_SIZE);
+        return current_.load(std::memory_order_relaxed)->bump();
+    }
+
+    std::mutex lock_;
+    std::vector<std::unique_ptr<Slab>> slabs_;
+    std::vector<Pair*> free_;
+    std::atomic<Slab*> current_;
+    std::atomic<size_t> allocated_;
+};
+
+}
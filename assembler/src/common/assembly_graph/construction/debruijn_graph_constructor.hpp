@@ -452,6 +452,7 @@ private:
         size_t size = sequences.size();
         records.resize(size * 2, LinkRecord(0, EdgeId(), false, false));
         restricted::IdSegmentStorage id_storage = helper.graph().GetGraphIdDistributor().Reserve(size * 2);
+        helper.ReserveEdges(size * 2);
 #       pragma omp parallel for schedule(guided)
         for (size_t i = 0; i < size; ++i) {
             size_t j = i << 1;
@@ -488,6 +489,12 @@ public:
         size_t size = records.size();
         vector<vector<VertexId>> vertices_list(omp_get_max_threads());
         restricted::IdSegmentStorage id_storage = helper.graph().GetGraphIdDistributor().Reserve(size * 2);
+        size_t vertex_count = 0;
+        for (size_t i = 0; i < size; i++) {
+            if ((i == 0 || records[i].GetHash() != records[i - 1].GetHash()) && !records[i].IsInvalid())
+                vertex_count += 1;
+        }
+        helper.ReserveVertices(vertex_count * 2);
 #       pragma omp parallel for schedule(guided)
         for (size_t i = 0; i < size; i++) {
             if (i != 0 && records[i].GetHash() == records[i - 1].GetHash())
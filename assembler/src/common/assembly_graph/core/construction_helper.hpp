@@ -66,17 +66,20 @@ public:
     }
 
     void DeleteUnlinkedEdge(EdgeId e) {
-        EdgeId rc = graph_.conjugate(e);
-        if (e != rc) {
-            delete rc.get();
-        }
-        delete e.get();
+        graph_.DestroyEdge(e);
     }
 
     void DeleteUnlinkedVertex(VertexId v) {
-        VertexId rc = graph_.conjugate(v);
-        delete rc.get(); // These guys do check that everything is unlinked.
-        delete v.get();
+        graph_.DestroyVertex(v); // These guys do check that everything is unlinked.
+    }
+
+    // Preallocates storage for the given number of elements (conjugates included)
+    void ReserveEdges(size_t n) {
+        graph_.ReserveEdges(n);
+    }
+
+    void ReserveVertices(size_t n) {
+        graph_.ReserveVertices(n);
     }
 
     VertexId CreateVertex(const VertexData &data) {
@@ -14,6 +14,7 @@
 #include "utils/stl_utils.hpp"
 
 #include "adt/small_pod_vector.hpp"
+#include "adt/pair_pool.hpp"
 
 #include <boost/iterator/iterator_facade.hpp>
 #include <btree/safe_btree_set.h>
@@ -243,6 +244,9 @@ private:
    restricted::LocalIdDistributor id_distributor_;
    DataMaster master_;
    VertexContainer vertices_;
+   // Conjugate elements are allocated together
+   adt::pair_pool<PairedVertex<DataMaster>> vertex_pool_;
+   adt::pair_pool<PairedEdge<DataMaster>> edge_pool_;
 
    friend class ConstructionHelper<DataMaster>;
 public:
@@ -286,8 +290,27 @@ private:
 
    void DestroyVertex(VertexId vertex) {
        VertexId conjugate = vertex->conjugate();
-       delete vertex.get();
-       delete conjugate.get();
+       PairedVertex<DataMaster> *storage = std::min(vertex.get(), conjugate.get());
+       vertex->~PairedVertex();
+       conjugate->~PairedVertex();
+       vertex_pool_.deallocate(storage);
+   }
+
+   void DestroyEdge(EdgeId edge) {
+       EdgeId conjugate = edge->conjugate();
+       PairedEdge<DataMaster> *storage = std::min(edge.get(), conjugate.get());
+       if (edge != conjugate)
+           conjugate->~PairedEdge();
+       edge->~PairedEdge();
+       edge_pool_.deallocate(storage);
+   }
+
+   void ReserveVertices(size_t n) {
+       vertex_pool_.reserve((n + 1) / 2);
+   }
+
+   void ReserveEdges(size_t n) {
+       edge_pool_.reserve((n + 1) / 2);
    }
 
    bool AdditionalCompressCondition(VertexId v) const {
@@ -297,8 +320,9 @@ private:
 protected:
 
    VertexId CreateVertex(const VertexData& data1, const VertexData& data2, restricted::IdDistributor& id_distributor) {
-       VertexId vertex1(new PairedVertex<DataMaster>(data1), id_distributor);
-       VertexId vertex2(new PairedVertex<DataMaster>(data2), id_distributor);
+       PairedVertex<DataMaster> *storage = vertex_pool_.allocate();
+       VertexId vertex1(new (storage) PairedVertex<DataMaster>(data1), id_distributor);
+       VertexId vertex2(new (storage + 1) PairedVertex<DataMaster>(data2), id_distributor);
        vertex1->set_conjugate(vertex2);
        vertex2->set_conjugate(vertex1);
        return vertex1;
@@ -335,21 +359,23 @@ protected:
     /////////////////////////low-level ops (move to helper?!)
 
     ////what with this method?
-    EdgeId AddSingleEdge(VertexId v1, VertexId v2, const EdgeData &data,
+    EdgeId AddSingleEdge(PairedEdge<DataMaster> *storage,
+                         VertexId v1, VertexId v2, const EdgeData &data,
                          restricted::IdDistributor &idDistributor) {
-        EdgeId newEdge(new PairedEdge<DataMaster>(v2, data), idDistributor);
+        EdgeId newEdge(new (storage) PairedEdge<DataMaster>(v2, data), idDistributor);
         if (v1 != VertexId())
             v1->AddOutgoingEdge(newEdge);
         return newEdge;
     }
 
     EdgeId HiddenAddEdge(const EdgeData& data, restricted::IdDistributor& id_distributor) {
-        EdgeId result = AddSingleEdge(VertexId(), VertexId(), data, id_distributor);
+        PairedEdge<DataMaster> *storage = edge_pool_.allocate();
+        EdgeId result = AddSingleEdge(storage, VertexId(), VertexId(), data, id_distributor);
         if (this->master().isSelfConjugate(data)) {
             result->set_conjugate(result);
             return result;
         }
-        EdgeId rcEdge = AddSingleEdge(VertexId(), VertexId(), this->master().conjugate(data), id_distributor);
+        EdgeId rcEdge = AddSingleEdge(storage + 1, VertexId(), VertexId(), this->master().conjugate(data), id_distributor);
         result->set_conjugate(rcEdge);
         rcEdge->set_conjugate(result);
         return result;
@@ -362,7 +388,8 @@ protected:
     EdgeId HiddenAddEdge(VertexId v1, VertexId v2, const EdgeData& data, restricted::IdDistributor& id_distributor) {
         //      todo was suppressed for concurrent execution reasons (see concurrent_graph_component.hpp)
         //      VERIFY(this->vertices_.find(v1) != this->vertices_.end() && this->vertices_.find(v2) != this->vertices_.end());
-        EdgeId result = AddSingleEdge(v1, v2, data, id_distributor);
+        PairedEdge<DataMaster> *storage = edge_pool_.allocate();
+        EdgeId result = AddSingleEdge(storage, v1, v2, data, id_distributor);
         if (this->master().isSelfConjugate(data) && (v1 == conjugate(v2))) {
             //              todo why was it removed???
             //          Because of some split issues: when self-conjugate edge is split armageddon happends
@@ -371,7 +398,7 @@ protected:
             result->set_conjugate(result);
             return result;
         }
-        EdgeId rcEdge = AddSingleEdge(v2->conjugate(), v1->conjugate(), this->master().conjugate(data), id_distributor);
+        EdgeId rcEdge = AddSingleEdge(storage + 1, v2->conjugate(), v1->conjugate(), this->master().conjugate(data), id_distributor);
         result->set_conjugate(rcEdge);
         rcEdge->set_conjugate(result);
         return result;
@@ -388,10 +415,7 @@ protected:
         VertexId start = conjugate(rcEdge->end());
         start->RemoveOutgoingEdge(edge);
         rcStart->RemoveOutgoingEdge(rcEdge);
-        if (edge != rcEdge) {
-            delete rcEdge.get();
-        }
-        delete edge.get();
+        DestroyEdge(edge);
     }
 
     void HiddenDeletePath(const std::vector<EdgeId>& edgesToDelete, const std::vector<VertexId>& verticesToDelete) {
@@ -8,56 +8,24 @@
 
 #include "utils/stl_utils.hpp"
 #include "dijkstra_settings.hpp"
+#include "dijkstra_workspace.hpp"
 
-#include <queue>
+#include <algorithm>
 #include <vector>
 #include <set>
-#include <map>
 
 namespace omnigraph {
 
-template<typename Graph, typename distance_t = size_t>
-struct element_t{
-    typedef typename Graph::VertexId VertexId;
-    typedef typename Graph::EdgeId EdgeId;
-
-    distance_t distance;
-    VertexId curr_vertex;
-    VertexId prev_vertex;
-    EdgeId edge_between;
-
-    element_t(distance_t new_distance, VertexId new_cur_vertex, VertexId new_prev_vertex,
-            EdgeId new_edge_between) : distance(new_distance), curr_vertex(new_cur_vertex),
-                    prev_vertex(new_prev_vertex), edge_between(new_edge_between) { }
-};
-
-template<typename T>
-class ReverseDistanceComparator {
-public:
-  ReverseDistanceComparator() {
-  }
-
-  bool operator()(T obj1, T obj2){
-      if(obj1.distance != obj2.distance)
-          return obj2.distance < obj1.distance;
-      if(obj2.curr_vertex != obj1.curr_vertex)
-          return obj2.curr_vertex < obj1.curr_vertex;
-      if(obj2.prev_vertex != obj1.prev_vertex)
-          return obj2.prev_vertex < obj1.prev_vertex;
-      return obj2.edge_between < obj1.edge_between;
-  }
-};
-
 template<class Graph, class DijkstraSettings, typename distance_t = size_t>
 class Dijkstra {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
     typedef distance_t DistanceType;
 
-    typedef std::map<VertexId, distance_t> distances_map;
-    typedef typename distances_map::const_iterator distances_map_ci;
-    typedef typename std::priority_queue<element_t<Graph, distance_t>, std::vector<element_t<Graph, distance_t>>,
-            ReverseDistanceComparator<element_t<Graph, distance_t>>> queue_t;
+    typedef DijkstraWorkspace<Graph, distance_t> workspace_t;
+    typedef typename workspace_t::Element element_t;
+    typedef typename workspace_t::Queue queue_t;
+    typedef WorkspacePool<workspace_t> pool_t;
 
     // constructor parameters
     const Graph& graph_;
@@ -69,20 +37,15 @@ class Dijkstra {
     size_t vertex_number_;
     bool vertex_limit_exceeded_;
 
-    // accumulative structures
-    distances_map distances_;
-    std::set<VertexId> processed_vertices_;
-    std::map<VertexId, pair<VertexId, EdgeId>> prev_vert_map_;
+    // accumulative structures, a record exists for every vertex fetched from the queue
+    typename pool_t::Ptr workspace_;
 
     void Init(VertexId start, queue_t &queue) {
         vertex_number_ = 0;
-        distances_.clear();
-        processed_vertices_.clear();
-        prev_vert_map_.clear();
+        workspace_->Clear();
         set_finished(false);
         settings_.Init(start);
-        queue.push(element_t<Graph, distance_t>(0, start, VertexId(), EdgeId()));
-        prev_vert_map_[start] = std::pair<VertexId, EdgeId>(VertexId(), EdgeId());
+        queue.push(element_t(0, start, VertexId(), EdgeId()));
     }
 
     void set_finished(bool state) {
@@ -117,8 +80,8 @@ class Dijkstra {
                 TRACE("Entry: vertex " << graph_.str(cur_vertex) << " distance " << new_dist);
                 if (CheckPutVertex(cur_pair.vertex, cur_pair.edge, new_dist)) {
                     TRACE("CheckPutVertex returned true and new entry is added");
-                    queue.push(element_t<Graph, distance_t>(new_dist, cur_pair.vertex,
-                                    cur_vertex, cur_pair.edge));
+                    queue.push(element_t(new_dist, cur_pair.vertex,
+                                         cur_vertex, cur_pair.edge));
                 }
             }
             TRACE("Checking new neighbour of vertex " << graph_.str(cur_vertex) << " finished");
@@ -133,7 +96,8 @@ public:
         max_vertex_number_(max_vertex_number),
         finished_(false),
         vertex_number_(0),
-        vertex_limit_exceeded_(false) {}
+        vertex_limit_exceeded_(false),
+        workspace_(pool_t::Acquire()) {}
 
     Dijkstra(Dijkstra&& /*other*/) = default; 
 
@@ -148,41 +112,54 @@ public:
     }
 
     bool DistanceCounted(VertexId vertex) const {
-        return distances_.find(vertex) != distances_.end();
+        return workspace_->Find(vertex) != workspace_t::NO_RECORD;
     }
 
     distance_t GetDistance(VertexId vertex) const {
-        VERIFY(DistanceCounted(vertex));
-        return distances_.find(vertex)->second;
+        size_t idx = workspace_->Find(vertex);
+        VERIFY(idx != workspace_t::NO_RECORD);
+        return (*workspace_)[idx].distance;
     }
 
-    std::pair<distances_map_ci, distances_map_ci> GetDistances() const {
-        distances_map_ci begin = distances_.begin();
-        distances_map_ci end = distances_.end();
-        return make_pair(begin, end);
+    // Distances to all reached vertices sorted by vertex
+    std::vector<std::pair<VertexId, distance_t>> GetDistances() const {
+        std::vector<std::pair<VertexId, distance_t>> result;
+        result.reserve(workspace_->records().size());
+        for (const auto &record : workspace_->records())
+            result.emplace_back(record.vertex, record.distance);
+        std::sort(result.begin(), result.end());
+        return result;
     }
 
     void Run(VertexId start) {
         TRACE("Starting dijkstra run from vertex " << graph_.str(start));
-        queue_t queue;
+        queue_t &queue = workspace_->queue();
         Init(start, queue);
         TRACE("Priority queue initialized. Starting search");
 
         while (!queue.empty() && !finished()) {
             TRACE("Dijkstra iteration started");
-            const element_t<Graph, distance_t>& next = queue.top();
+            const element_t next = queue.top();
+            queue.pop();
             distance_t distance = next.distance;
             VertexId vertex = next.curr_vertex;
-
-            prev_vert_map_[vertex] = std::pair<VertexId, EdgeId>(next.prev_vertex, next.edge_between);
-            queue.pop();
             TRACE("Vertex " << graph_.str(vertex) << " with distance " << distance << " fetched from queue");
 
-            if (DistanceCounted(vertex)) {
+            size_t idx = workspace_->Find(vertex);
+            if (idx != workspace_t::NO_RECORD) {
+                auto &record = (*workspace_)[idx];
+                record.prev_vertex = next.prev_vertex;
+                record.edge_between = next.edge_between;
                 TRACE("Distance to vertex " << graph_.str(vertex) << " already counted. Proceeding to next queue entry.");
                 continue;
             }
-            distances_.insert(make_pair(vertex, distance));
+            idx = workspace_->FindOrAdd(vertex);
+            {
+                auto &record = (*workspace_)[idx];
+                record.prev_vertex = next.prev_vertex;
+                record.edge_between = next.edge_between;
+                record.distance = distance;
+            }
 
             TRACE("Vertex " << graph_.str(vertex) << " is found to be at distance "
                     << distance << " from vertex " << graph_.str(start));
@@ -190,7 +167,7 @@ public:
                 TRACE("Check for processing vertex failed. Proceeding to the next queue entry.");
                 continue;
             }
-            processed_vertices_.insert(vertex);
+            (*workspace_)[idx].processed = true;
             AddNeighboursToQueue(vertex, distance, queue);
         }
         set_finished(true);
@@ -199,36 +176,42 @@ public:
 
     std::vector<EdgeId> GetShortestPathTo(VertexId vertex) {
         std::vector<EdgeId> path;
-        if (prev_vert_map_.find(vertex) == prev_vert_map_.end())
+        size_t idx = workspace_->Find(vertex);
+        if (idx == workspace_t::NO_RECORD)
             return path;
 
-        VertexId curr_vertex = vertex;
-        VertexId prev_vertex = utils::get(prev_vert_map_, vertex).first;
-        EdgeId edge = utils::get(prev_vert_map_, curr_vertex).second;
+        VertexId prev_vertex = (*workspace_)[idx].prev_vertex;
+        EdgeId edge = (*workspace_)[idx].edge_between;
 
         while (prev_vertex != VertexId()) {
             if (graph_.EdgeStart(edge) == prev_vertex)
                 path.insert(path.begin(), edge);
             else
                 path.push_back(edge);
-            curr_vertex = prev_vertex;
-            const auto& prev_v_e = utils::get(prev_vert_map_, curr_vertex);
-            prev_vertex = prev_v_e.first;
-            edge = prev_v_e.second;
+            idx = workspace_->Find(prev_vertex);
+            VERIFY(idx != workspace_t::NO_RECORD);
+            prev_vertex = (*workspace_)[idx].prev_vertex;
+            edge = (*workspace_)[idx].edge_between;
         }
         return path;
     }
 
     vector<VertexId> ReachedVertices() const {
         vector<VertexId> result;
-        for (auto it = distances_.begin(); it != distances_.end(); ++it) {
-            result.push_back(it->first);
-        }
+        result.reserve(workspace_->records().size());
+        for (const auto &record : workspace_->records())
+            result.push_back(record.vertex);
+        std::sort(result.begin(), result.end());
         return result;
     }
 
-    const set<VertexId>& ProcessedVertices() const {
-        return processed_vertices_;
+    set<VertexId> ProcessedVertices() const {
+        set<VertexId> result;
+        for (const auto &record : workspace_->records()) {
+            if (record.processed)
+                result.insert(record.vertex);
+        }
+        return result;
     }
 
     bool VertexLimitExceeded() const {
@@ -0,0 +1,227 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace omnigraph {
+
+template<typename Graph, typename distance_t = size_t>
+struct element_t{
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+
+    distance_t distance;
+    VertexId curr_vertex;
+    VertexId prev_vertex;
+    EdgeId edge_between;
+
+    element_t(distance_t new_distance, VertexId new_cur_vertex, VertexId new_prev_vertex,
+            EdgeId new_edge_between) : distance(new_distance), curr_vertex(new_cur_vertex),
+                    prev_vertex(new_prev_vertex), edge_between(new_edge_between) { }
+};
+
+template<typename T>
+class ReverseDistanceComparator {
+public:
+  ReverseDistanceComparator() {
+  }
+
+  bool operator()(const T &obj1, const T &obj2) const {
+      if(obj1.distance != obj2.distance)
+          return obj2.distance < obj1.distance;
+      if(obj2.curr_vertex != obj1.curr_vertex)
+          return obj2.curr_vertex < obj1.curr_vertex;
+      if(obj2.prev_vertex != obj1.prev_vertex)
+          return obj2.prev_vertex < obj1.prev_vertex;
+      return obj2.edge_between < obj1.edge_between;
+  }
+};
+
+// Min-heap with D children per node on top of the reusable vector, the
+// order of extraction is the same as of std::priority_queue with Compare
+template<typename T, typename Compare, size_t D = 4>
+class DaryHeap {
+    std::vector<T> data_;
+    Compare less_;
+
+    // true if a should be extracted after b
+    bool after(const T &a, const T &b) const {
+        return less_(a, b);
+    }
+
+public:
+    bool empty() const {
+        return data_.empty();
+    }
+
+    size_t size() const {
+        return data_.size();
+    }
+
+    void clear() {
+        data_.clear();
+    }
+
+    const T &top() const {
+        return data_.front();
+    }
+
+    void push(const T &value) {
+        size_t i = data_.size();
+        data_.push_back(value);
+        while (i > 0) {
+            size_t parent = (i - 1) / D;
+            if (!after(data_[parent], data_[i]))
+                break;
+            std::swap(data_[parent], data_[i]);
+            i = parent;
+        }
+    }
+
+    void pop() {
+        VERIFY(!data_.empty());
+        data_.front() = data_.back();
+        data_.pop_back();
+
+        size_t i = 0, size = data_.size();
+        while (true) {
+            size_t first = i * D + 1;
+            if (first >= size)
+                break;
+            size_t best = first;
+            for (size_t c = first + 1; c < std::min(first + D, size); ++c) {
+                if (after(data_[best], data_[c]))
+                    best = c;
+            }
+            if (!after(data_[i], data_[best]))
+                break;
+            std::swap(data_[i], data_[best]);
+            i = best;
+        }
+    }
+};
+
+// State of a single Dijkstra run. Vertices are mapped to the records of the
+// current run with a dense array indexed by vertex int id. An entry of the
+// array is valid only if it points to the record of the same vertex, so the
+// workspace is cleared in O(1) and keeps its memory for the subsequent runs.
+template<class Graph, typename distance_t = size_t>
+class DijkstraWorkspace {
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+
+public:
+    typedef element_t<Graph, distance_t> Element;
+    typedef DaryHeap<Element, ReverseDistanceComparator<Element>> Queue;
+
+    struct Record {
+        VertexId vertex;
+        VertexId prev_vertex;
+        EdgeId edge_between;
+        distance_t distance;
+        bool processed;
+
+        Record(VertexId v)
+                : vertex(v), distance(0), processed(false) {}
+    };
+
+    static const size_t NO_RECORD = size_t(-1);
+
+    void Clear() {
+        records_.clear();
+        queue_.clear();
+    }
+
+    size_t Find(VertexId v) const {
+        size_t id = v.int_id();
+        if (id >= index_.size())
+            return NO_RECORD;
+        size_t idx = index_[id];
+        if (idx < records_.size() && records_[idx].vertex == v)
+            return idx;
+        return NO_RECORD;
+    }
+
+    size_t FindOrAdd(VertexId v) {
+        size_t idx = Find(v);
+        if (idx != NO_RECORD)
+            return idx;
+
+        size_t id = v.int_id();
+        if (id >= index_.size())
+            index_.resize(std::max(id + 1, index_.size() * 2));
+        VERIFY(records_.size() < std::numeric_limits<uint32_t>::max());
+        index_[id] = uint32_t(records_.size());
+        records_.emplace_back(v);
+        return records_.size() - 1;
+    }
+
+    Record &operator[](size_t idx) {
+        return records_[idx];
+    }
+
+    const Record &operator[](size_t idx) const {
+        return records_[idx];
+    }
+
+    const std::vector<Record> &records() const {
+        return records_;
+    }
+
+    Queue &queue() {
+        return queue_;
+    }
+
+private:
+    std::vector<uint32_t> index_;
+    std::vector<Record> records_;
+    Queue queue_;
+};
+
+// Workspaces are taken from and returned to the pool of the current thread,
+// so the repeated runs do not allocate memory
+template<class Workspace>
+class WorkspacePool {
+    static const size_t MAX_POOLED = 16;
+
+    static std::vector<std::unique_ptr<Workspace>> &pool() {
+        static thread_local std::vector<std::unique_ptr<Workspace>> pool;
+        return pool;
+    }
+
+public:
+    struct Releaser {
+        void operator()(Workspace *workspace) const {
+            std::unique_ptr<Workspace> ptr(workspace);
+            auto &free = pool();
+            if (free.size() < MAX_POOLED) {
+                ptr->Clear();
+                free.push_back(std::move(ptr));
+            }
+        }
+    };
+
+    typedef std::unique_ptr<Workspace, Releaser> Ptr;
+
+    static Ptr Acquire() {
+        auto &free = pool();
+        if (free.empty())
+            return Ptr(new Workspace());
+        Ptr res(free.back().release());
+        free.pop_back();
+        return res;
+    }
+};
+
+}
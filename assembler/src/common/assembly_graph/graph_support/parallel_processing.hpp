@@ -12,6 +12,10 @@
 #include "assembly_graph/graph_support/graph_processing_algorithm.hpp"
 #include "utils/parallel/openmp_wrapper.h"
 
+#include <algorithm>
+#include <memory>
+#include <unordered_set>
+
 namespace omnigraph {
 
 template<class Graph, class ElementId>
@@ -390,7 +394,117 @@ public:
     }
 
 private:
-    DECL_LOGGER("PersistentProcessingAlgorithm"); 
+    DECL_LOGGER("PersistentProcessingAlgorithm");
+};
+
+/**
+ * Processes graph elements in rounds. Within a round all pending elements are
+ * analysed concurrently on the same state of the graph, then the changes found
+ * are applied one by one in the element order. Every change comes with its
+ * footprint: the vertices the analysis depended on and the change might modify
+ * (conjugates are added automatically). Changes overlapping with the ones
+ * applied before in the same round are postponed to the next round together
+ * with the elements returned for consideration.
+ */
+template<class Graph, class ElementId, class Change>
+class RoundProcessingAlgorithm : public PersistentAlgorithmBase<Graph> {
+    typedef typename Graph::VertexId VertexId;
+
+    struct Candidate {
+        size_t idx;
+        Change change;
+        std::vector<VertexId> footprint;
+    };
+
+    std::unique_ptr<SmartSetIterator<Graph, ElementId>> next_round_;
+
+    std::vector<Candidate> FindCandidates(const std::vector<ElementId> &elements) const {
+        std::vector<std::vector<Candidate>> found(omp_get_max_threads());
+
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < elements.size(); ++i) {
+            Candidate candidate{i, Change(), {}};
+            if (!Analyze(elements[i], candidate.change, candidate.footprint))
+                continue;
+            size_t footprint_size = candidate.footprint.size();
+            for (size_t j = 0; j < footprint_size; ++j)
+                candidate.footprint.push_back(this->g().conjugate(candidate.footprint[j]));
+            found[omp_get_thread_num()].push_back(std::move(candidate));
+        }
+
+        std::vector<Candidate> answer;
+        for (auto &chunk : found)
+            std::move(chunk.begin(), chunk.end(), std::back_inserter(answer));
+        std::sort(answer.begin(), answer.end(),
+                  [](const Candidate &a, const Candidate &b) { return a.idx < b.idx; });
+        return answer;
+    }
+
+protected:
+    //Called concurrently, should not modify the graph. The footprint should
+    //include the vertices of the element itself.
+    //Returns false if there is nothing to do with the element
+    virtual bool Analyze(ElementId el, Change &change, std::vector<VertexId> &footprint) const = 0;
+
+    //Returns true if the graph was changed
+    virtual bool Apply(ElementId el, const Change &change) = 0;
+
+    void ReturnForConsideration(ElementId el) {
+        VERIFY(next_round_);
+        next_round_->push(el);
+    }
+
+public:
+    RoundProcessingAlgorithm(Graph &g)
+            : PersistentAlgorithmBase<Graph>(g) {}
+
+    //Every launch starts from scratch
+    size_t Run(bool /*force_primary_launch*/ = false,
+               double /*iter_run_progress*/ = 1.) override {
+        std::vector<ElementId> elements;
+        const IterationHelper<Graph, ElementId> it_helper(this->g());
+        for (auto it = it_helper.begin(), end = it_helper.end(); it != end; ++it)
+            elements.push_back(*it);
+
+        size_t triggered = 0;
+        size_t round = 0;
+        while (!elements.empty()) {
+            TRACE("Round " << round << ". " << elements.size() << " elements to consider");
+            std::vector<Candidate> candidates = FindCandidates(elements);
+
+            //postponed elements get into the next round before any change,
+            //so that the ones deleted meanwhile are dropped
+            next_round_.reset(new SmartSetIterator<Graph, ElementId>(this->g()));
+            std::unordered_set<VertexId> touched;
+            std::vector<const Candidate*> selected;
+            for (const Candidate &c : candidates) {
+                if (std::any_of(c.footprint.begin(), c.footprint.end(),
+                                [&](VertexId v) { return touched.count(v); })) {
+                    next_round_->push(elements[c.idx]);
+                    continue;
+                }
+                touched.insert(c.footprint.begin(), c.footprint.end());
+                selected.push_back(&c);
+            }
+            TRACE(candidates.size() << " candidates found, " << selected.size() << " selected");
+
+            for (const Candidate *c : selected) {
+                if (Apply(elements[c->idx], c->change))
+                    triggered++;
+            }
+
+            elements.clear();
+            for (; !next_round_->IsEnd(); ++(*next_round_))
+                elements.push_back(**next_round_);
+            next_round_.reset();
+            round++;
+        }
+        TRACE("Finished processing. Triggered = " << triggered);
+        return triggered;
+    }
+
+private:
+    DECL_LOGGER("RoundProcessingAlgorithm");
 };
 
 template<class Graph,
@@ -112,6 +112,11 @@ class UsedUniqueStorage {
     set<EdgeId> used_;
     const ScaffoldingUniqueEdgeStorage& unique_;
 
+    //Speculative storages see the edges used in the committed one, but keep their own insertions
+    const UsedUniqueStorage *committed_;
+    //Edges looked up in the committed storage
+    mutable set<EdgeId> checked_;
+
 public:
     UsedUniqueStorage(const UsedUniqueStorage&) = delete;
     UsedUniqueStorage& operator=(const UsedUniqueStorage&) = delete;
@@ -120,7 +125,10 @@ public:
     UsedUniqueStorage& operator=(UsedUniqueStorage&&) = default;
 
     explicit UsedUniqueStorage(const ScaffoldingUniqueEdgeStorage& unique):
-            unique_(unique) {}
+            unique_(unique), committed_(nullptr) {}
+
+    explicit UsedUniqueStorage(const UsedUniqueStorage *committed):
+            unique_(committed->unique_), committed_(committed) {}
 
     void insert(EdgeId e) {
         if (unique_.IsUnique(e)) {
@@ -134,7 +142,28 @@ public:
 //    }
 
     bool IsUsedAndUnique(EdgeId e) const {
-        return (unique_.IsUnique(e) && used_.find(e) != used_.end());
+        if (!unique_.IsUnique(e))
+            return false;
+        if (used_.find(e) != used_.end())
+            return true;
+        if (!committed_)
+            return false;
+        checked_.insert(e);
+        return committed_->used_.find(e) != committed_->used_.end();
+    }
+
+    //Moves the state of a speculative storage out, so that it can be reused
+    void Take(set<EdgeId> &used, set<EdgeId> &checked) {
+        VERIFY(committed_);
+        used = std::move(used_);
+        checked = std::move(checked_);
+        used_.clear();
+        checked_.clear();
+    }
+
+    void Commit(const set<EdgeId> &used) {
+        VERIFY(!committed_);
+        used_.insert(used.begin(), used.end());
     }
 
     bool UniqueCheckEnabled() const {
@@ -102,8 +102,12 @@ class BidirectionalPath : public PathListener {
     const Graph& g_;
     std::deque<EdgeId> data_;
     BidirectionalPath* conj_path_;
+    // Positions of edge starts and of the path end on some fixed coordinate axis, so
+    // that adding / removing edges at either end does not shift the others.
     // Length from beginning of i-th edge to path end: L(e_i + gap_(i+1) + e_(i+1) + ... + gap_N + e_N)
-    std::deque<size_t> cumulative_len_;
+    // is end_pos_ - start_pos_[i]. Positions might wrap around, only differences matter.
+    std::deque<size_t> start_pos_;
+    size_t end_pos_;
     std::deque<Gap> gap_len_;  // e0 -> gap1 -> e1 -> ... -> gapN -> eN; gap0 = 0
     std::vector<PathListener *> listeners_;
     const uint64_t id_;  //Unique ID
@@ -113,22 +117,20 @@ public:
     BidirectionalPath(const Graph& g)
             : g_(g),
               conj_path_(nullptr),
+              end_pos_(0),
               id_(path_id_++),
               weight_(1.0) {
     }
 
     BidirectionalPath(const Graph& g, const std::vector<EdgeId>& path)
             : BidirectionalPath(g) {
-        cumulative_len_.resize(path.size(), 0);
         data_.resize(path.size());
         gap_len_.resize(path.size(), Gap());
 
         for (size_t i = 0; i < path.size(); ++i) {
             data_[i] = path[i];
-            cumulative_len_.front() += g_.length(path[i]);
-        }
-        for (size_t i = 1; i < path.size(); ++i) {
-            cumulative_len_[i] = cumulative_len_[i - 1] - g_.length(data_[i - 1]);
+            start_pos_.push_back(end_pos_);
+            end_pos_ += g_.length(path[i]);
         }
     }
 
@@ -141,7 +143,8 @@ public:
             : g_(path.g_),
               data_(path.data_),
               conj_path_(nullptr),
-              cumulative_len_(path.cumulative_len_),
+              start_pos_(path.start_pos_),
+              end_pos_(path.end_pos_),
               gap_len_(path.gap_len_),
               listeners_(),
               id_(path_id_++),
@@ -202,7 +205,7 @@ public:
             return 0;
         }
         VERIFY(gap_len_[0].gap == 0);
-        return cumulative_len_[0];
+        return LengthAt(0);
     }
 
     //TODO iterators forward/reverse
@@ -220,7 +223,7 @@ public:
 
     // Length from beginning of i-th edge to path end for forward directed path: L(e1 + e2 + ... + eN)
     size_t LengthAt(size_t index) const {
-        return cumulative_len_[index];
+        return end_pos_ - start_pos_[index];
     }
 
     Gap GapAt(size_t index) const {
@@ -502,19 +505,14 @@ private:
     }
 
     void IncreaseLengths(size_t length, int gap) {
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter += length + gap;
-        }
-        cumulative_len_.push_back(length);
+        end_pos_ += gap;
+        start_pos_.push_back(end_pos_);
+        end_pos_ += length;
     }
 
     void DecreaseLengths() {
-        size_t length = g_.length(data_.back()) + gap_len_.back().gap;
-
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter -= length;
-        }
-        cumulative_len_.pop_back();
+        end_pos_ = start_pos_.back() - gap_len_.back().gap;
+        start_pos_.pop_back();
     }
 
     void NotifyFrontEdgeAdded(EdgeId e, Gap gap) {
@@ -549,11 +547,12 @@ private:
         }
         gap_len_.push_front(Gap());
 
-        int length = (int) g_.length(e);
-        if (cumulative_len_.empty()) {
-            cumulative_len_.push_front(length);
+        size_t length = g_.length(e);
+        if (start_pos_.empty()) {
+            end_pos_ = length;
+            start_pos_.push_front(0);
         } else {
-            cumulative_len_.push_front(cumulative_len_.front() + length + gap.gap);
+            start_pos_.push_front(start_pos_.front() - gap.gap - length);
         }
         NotifyFrontEdgeAdded(e, gap);
     }
@@ -562,7 +561,7 @@ private:
         EdgeId e = data_.front();
         data_.pop_front();
         gap_len_.pop_front();
-        cumulative_len_.pop_front();
+        start_pos_.pop_front();
         if (!gap_len_.empty()) {
             gap_len_.front() = Gap();
         }
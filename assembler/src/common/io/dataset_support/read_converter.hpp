@@ -21,7 +21,7 @@ typedef SequencingLibrary<LibraryData> SequencingLibraryT;
 
 class ReadConverter {
 
-    static const size_t BINARY_FORMAT_VERSION = 12;
+    static const size_t BINARY_FORMAT_VERSION = 13;
 
     static bool CheckBinaryReadsExist(SequencingLibraryT& lib) {
         return fs::FileExists(lib.data().binary_reads_info.bin_reads_info_file);
@@ -50,13 +50,15 @@ class ReadConverter {
             info >> lib_index;
         }
 
-        if (chunk_num != data.binary_reads_info.chunk_num ||
+        if (chunk_num == 0 ||
             format != BINARY_FORMAT_VERSION ||
             lib_index != data.lib_index) {
             return false;
         }
 
         INFO("Binary reads detected");
+        //files are split between the streams if their number differs
+        data.binary_reads_info.file_num = chunk_num;
         info >> data.unmerged_read_length;
         info >> data.merged_read_length;
         info >> data.read_count;
@@ -73,6 +75,7 @@ class ReadConverter {
         info.open(data.binary_reads_info.bin_reads_info_file.c_str(), std::ios_base::out);
         info << "0 0 0";
         info.close();
+        data.binary_reads_info.file_num = data.binary_reads_info.chunk_num;
 
         INFO("Converting reads to binary format for library #" << data.lib_index << " (takes a while)");
         INFO("Converting paired reads");
@@ -120,7 +123,9 @@ class ReadConverter {
 
 public:
     static void ConvertToBinaryIfNeeded(SequencingLibraryT& lib) {
-        if (lib.data().binary_reads_info.binary_converted && CheckBinaryReadsExist(lib))
+        const auto& info = lib.data().binary_reads_info;
+        //the number of files is missing in lib data saved by older versions, take it from the info file then
+        if (info.binary_converted && info.file_num > 0 && CheckBinaryReadsExist(lib))
             return;
 
         if (LoadLibIfExists(lib)) {
@@ -131,6 +136,29 @@ public:
     }
 };
 
+//Produces chunk_num streams from the binary read files of the library,
+//the files are split into parts with their indices if needed
+template<class ReadType, class StreamFactory>
+ReadStreamList<ReadType> split_binary_files(const SequencingLibraryT &lib,
+                                            const StreamFactory &create_stream) {
+    const auto& info = lib.data().binary_reads_info;
+    const size_t stream_num = info.chunk_num;
+    const size_t file_num = info.file_num;
+    VERIFY(stream_num > 0 && file_num > 0);
+    const size_t parts = (stream_num + file_num - 1) / file_num;
+
+    std::vector<ReadStreamList<ReadType>> streams(stream_num);
+    for (size_t i = 0; i < file_num * parts; ++i) {
+        streams[i % stream_num].push_back(create_stream(i / parts, i % parts, parts));
+    }
+
+    ReadStreamList<ReadType> answer;
+    for (auto &stream : streams) {
+        answer.push_back(stream.size() == 1 ? stream.ptr_at(0) : MultifileWrap<ReadType>(stream));
+    }
+    return answer;
+}
+
 inline
 BinaryPairedStreams paired_binary_readers(SequencingLibraryT &lib,
                                           bool followed_by_rc,
@@ -140,22 +168,22 @@ BinaryPairedStreams paired_binary_readers(SequencingLibraryT &lib,
     const auto& data = lib.data();
     CHECK_FATAL_ERROR(data.binary_reads_info.binary_converted, 
             "Lib was not converted to binary, cannot produce binary stream");
+    if (include_merged) {
+        VERIFY(lib.data().unmerged_read_length != 0);
+    }
 
-    ReadStreamList<PairedReadSeq> paired_streams;
-    const size_t n = data.binary_reads_info.chunk_num;
-
-    for (size_t i = 0; i < n; ++i) {
+    BinaryPairedStreams paired_streams = split_binary_files<PairedReadSeq>(lib,
+                                                                           [&](size_t i, size_t part, size_t parts) {
         BinaryPairedStreamPtr stream = make_shared<BinaryFilePairedStream>(data.binary_reads_info.paired_read_prefix,
-                                                     i, insert_size);
+                                                                           i, insert_size, part, parts);
         if (include_merged) {
-            VERIFY(lib.data().unmerged_read_length != 0);
             stream = MultifileWrap<PairedReadSeq>(stream,
                                                   make_shared<BinaryUnmergingPairedStream>(data.binary_reads_info.merged_read_prefix,
-                                                                                           i, insert_size, lib.data().unmerged_read_length));
+                                                                                           i, insert_size, lib.data().unmerged_read_length,
+                                                                                           part, parts));
         }
-
-        paired_streams.push_back(stream);
-    }
+        return stream;
+    });
 
     if (followed_by_rc) {
         paired_streams = RCWrap<PairedReadSeq>(paired_streams);
@@ -173,28 +201,20 @@ BinarySingleStreams single_binary_readers(SequencingLibraryT &lib,
     CHECK_FATAL_ERROR(data.binary_reads_info.binary_converted,
                "Lib was not converted to binary, cannot produce binary stream");
 
-    BinarySingleStreams single_streams;
-    const size_t n = data.binary_reads_info.chunk_num;
-
-    for (size_t i = 0; i < n; ++i) {
-        single_streams.push_back(make_shared<BinaryFileSingleStream>(data.binary_reads_info.single_read_prefix, i));
-    }
-
-    if (including_paired_and_merged) {
-        BinarySingleStreams merged_streams;
-        for (size_t i = 0; i < n; ++i) {
-            merged_streams.push_back(make_shared<BinaryFileSingleStream>(data.binary_reads_info.merged_read_prefix, i));
+    BinarySingleStreams single_streams = split_binary_files<SingleReadSeq>(lib,
+                                                                           [&](size_t i, size_t part, size_t parts) {
+        BinarySingleStreamPtr stream = make_shared<BinaryFileSingleStream>(data.binary_reads_info.single_read_prefix,
+                                                                           i, part, parts);
+        if (including_paired_and_merged) {
+            stream = MultifileWrap<SingleReadSeq>(stream,
+                                                  make_shared<BinaryFileSingleStream>(data.binary_reads_info.merged_read_prefix,
+                                                                                      i, part, parts));
+            BinaryPairedStreamPtr paired_stream = make_shared<BinaryFilePairedStream>(data.binary_reads_info.paired_read_prefix,
+                                                                                      i, 0, part, parts);
+            stream = MultifileWrap<SingleReadSeq>(stream, make_shared<SquashingWrapper<PairedReadSeq>>(paired_stream));
         }
-        single_streams = WrapPairsInMultifiles<SingleReadSeq>(single_streams, merged_streams);
-
-        BinaryPairedStreams paired_streams;
-        for (size_t i = 0; i < n; ++i) {
-            paired_streams.push_back(make_shared<BinaryFilePairedStream>(data.binary_reads_info.paired_read_prefix,
-                                                                             i, 0));
-        }
-        single_streams = WrapPairsInMultifiles<SingleReadSeq>(single_streams,
-                                                              SquashingWrap<PairedReadSeq>(paired_streams));
-    }
+        return stream;
+    });
 
     if (followed_by_rc) {
         single_streams = RCWrap<SingleReadSeq>(single_streams);
@@ -8,126 +8,392 @@
 
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/core/construction_helper.hpp"
+#include "adt/concurrent_dsu.hpp"
+#include "sequence/sequence.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/parallel/parallel_wrapper.hpp"
 
-#include "gfa1/gfa.h"
+#include <zlib.h>
 
+#include <cstdio>
 #include <string>
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 using namespace debruijn_graph;
 
 namespace gfa {
 
-GFAReader::GFAReader()
-        : gfa_(nullptr, gfa_destroy) {}
-GFAReader::GFAReader(const std::string &filename)
-        : gfa_(gfa_read(filename.c_str()), gfa_destroy) {}
-bool GFAReader::open(const std::string &filename) {
-    gfa_.reset(gfa_read(filename.c_str()));
+namespace {
 
-    return (bool)gfa_;
-}
+// Buffered reader over (possibly gzipped) GFA file
+class GFAStream {
+    static const size_t BUFFER_SIZE = 1 << 20;
 
-uint32_t GFAReader::num_edges() const { return gfa_->n_seg; }
-uint64_t GFAReader::num_links() const { return gfa_->n_arc; }
+    bool Refill() {
+        int res = gzread(fp_, buf_.data(), unsigned(buf_.size()));
+        VERIFY_MSG(res >= 0, "Failed to read GFA file");
+        pos_ = 0;
+        size_ = size_t(res);
+        return size_ > 0;
+    }
 
-void GFAReader::to_graph(ConjugateDeBruijnGraph &g,
-                         bool numeric_ids) {
-    auto helper = g.GetConstructionHelper();
-
-    // INFO("Loading segments");
-    std::vector<EdgeId> edges;
-    edges.reserve(gfa_->n_seg);
-
-    if (numeric_ids) {
-        uint64_t mid = 0;
-        std::unordered_set<uint64_t> ids;
-        for (size_t i = 0; i < gfa_->n_seg; ++i) {
-            gfa_seg_t *seg = gfa_->seg + i;
-            uint64_t id = std::atoll(seg->name);
-            VERIFY_MSG(ids.insert(id).second, "Unique numeric ids are required");
-            if (mid < id)
-                mid = id;
+  public:
+    GFAStream(const std::string &filename)
+            : fp_(gzopen(filename.c_str(), "r")), buf_(BUFFER_SIZE), pos_(0), size_(0), line_(1) {}
+
+    ~GFAStream() {
+        if (fp_)
+            gzclose(fp_);
+    }
+
+    bool is_open() const { return fp_ != nullptr; }
+    size_t line() const { return line_; }
+
+    int get() {
+        if (pos_ == size_ && !Refill())
+            return EOF;
+        return (unsigned char)buf_[pos_++];
+    }
+
+    // Passes the characters of the current field to f, returns the field
+    // delimiter: tab, newline or EOF
+    template<class F>
+    int ReadField(F f) {
+        while (true) {
+            int c = get();
+            if (c == '\t' || c == EOF)
+                return c;
+            if (c == '\n') {
+                line_ += 1;
+                return c;
+            }
+            if (c != '\r')
+                f(char(c));
         }
-        restricted::IdSegmentStorage eid_storage = helper.graph().GetGraphIdDistributor().Reserve(mid + 2, 
-                /*force zero shift*/true);
-        for (size_t i = 0; i < gfa_->n_seg; ++i) {
-            gfa_seg_t *seg = gfa_->seg + i;
+    }
 
-            uint64_t id = std::atoll(seg->name);
+    int ReadField(std::string &s) {
+        s.clear();
+        return ReadField([&](char c) { s.push_back(c); });
+    }
 
-            uint64_t ids[] = { id, id + 1};
-            auto id_distributor = eid_storage.GetSegmentIdDistributor(std::begin(ids), std::end(ids));
-            EdgeId e = helper.AddEdge(DeBruijnEdgeData(Sequence(seg->seq)), id_distributor);
-            edges.push_back(e);
+    int SkipLine(int delim) {
+        while (delim != '\n' && delim != EOF)
+            delim = ReadField([](char) {});
+        return delim;
+    }
+
+  private:
+    gzFile fp_;
+    std::vector<char> buf_;
+    size_t pos_, size_;
+    size_t line_;
+};
+
+// Nucleotides packed 2 bits each
+class PackedNucls {
+    typedef seq_element_type ST;
+    static const size_t STN = sizeof(ST) * 4;
+
+  public:
+    PackedNucls() : size_(0) {}
+
+    void push_back(char c) {
+        if (size_ % STN == 0)
+            data_.push_back(0);
+        data_.back() |= ST(dignucl(c)) << (size_ % STN * 2);
+        size_ += 1;
+    }
+
+    char operator[](size_t i) const {
+        return char((data_[i / STN] >> (i % STN * 2)) & 3);
+    }
+
+    size_t size() const { return size_; }
+
+  private:
+    std::vector<ST> data_;
+    size_t size_;
+};
+
+class GFAGraphBuilder {
+    typedef DeBruijnGraph::HelperT HelperT;
+
+    // Edges are created in batches of this total length
+    static const size_t BATCH_NUCLS = 1 << 26;
+
+    struct Segment {
+        size_t idx;
+        uint64_t id;
+        PackedNucls nucls;
+    };
+
+    struct Link {
+        size_t from, to; // (segment index << 1 | orientation)
+    };
+
+  public:
+    GFAGraphBuilder(DeBruijnGraph &g, bool numeric_ids)
+            : g_(g), helper_(g.GetConstructionHelper()),
+              numeric_ids_(numeric_ids), max_id_(0), batch_nucls_(0),
+              num_edges_(0), num_links_(0) {}
+
+    size_t SegmentIdx(const std::string &name) {
+        auto res = names_.insert({name, names_.size()});
+        return res.first->second;
+    }
+
+    void AddSegment(const std::string &name, PackedNucls nucls) {
+        VERIFY(nucls.size());
+        size_t idx = SegmentIdx(name);
+        if (defined_.size() <= idx)
+            defined_.resize(idx + 1);
+        CHECK_FATAL_ERROR(!defined_[idx], "Duplicate segment " << name);
+        defined_[idx] = true;
+
+        uint64_t id = 0;
+        if (numeric_ids_) {
+            id = std::atoll(name.c_str());
+            VERIFY_MSG(numeric_seen_.insert(id).second, "Unique numeric ids are required");
+            max_id_ = std::max(max_id_, id);
         }
-    } else {
-        restricted::IdSegmentStorage eid_storage = helper.graph().GetGraphIdDistributor().Reserve(gfa_->n_seg * 2);
-        for (size_t i = 0; i < gfa_->n_seg; ++i) {
-            gfa_seg_t *seg = gfa_->seg + i;
-
-            auto id_distributor = eid_storage.GetSegmentIdDistributor(i << 1, (i << 1) + 2);
-            EdgeId e = helper.AddEdge(DeBruijnEdgeData(Sequence(seg->seq)), id_distributor);
-            edges.push_back(e);
+
+        batch_nucls_ += nucls.size();
+        batch_.push_back({ idx, id, std::move(nucls) });
+        if (batch_nucls_ > BATCH_NUCLS)
+            FlushSegments();
+    }
+
+    void AddLink(size_t from, size_t to) {
+        links_.push_back({ from, to });
+    }
+
+    void Finish() {
+        FlushSegments();
+        LinkEdges();
+    }
+
+    uint64_t num_edges() const { return num_edges_; }
+    uint64_t num_links() const { return num_links_; }
+
+  private:
+    void FlushSegments() {
+        if (batch_.empty())
+            return;
+
+        edges_.resize(names_.size());
+        std::unique_ptr<restricted::IdSegmentStorage> eid_storage;
+        if (numeric_ids_) {
+            // Ids are taken directly from the names, so the whole range
+            // is (re)reserved from zero
+            eid_storage.reset(new restricted::IdSegmentStorage(
+                    g_.GetGraphIdDistributor().Reserve(max_id_ + 2, /*force zero shift*/true)));
+        } else {
+            eid_storage.reset(new restricted::IdSegmentStorage(
+                    g_.GetGraphIdDistributor().Reserve(batch_.size() * 2)));
+        }
+
+        helper_.ReserveEdges(batch_.size() * 2);
+#       pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < batch_.size(); ++i) {
+            Segment &seg = batch_[i];
+            Sequence seq(seg.nucls);
+            seg.nucls = PackedNucls();
+
+            EdgeId e;
+            if (numeric_ids_) {
+                uint64_t eids[] = { seg.id, seg.id + 1 };
+                auto id_distributor = eid_storage->GetSegmentIdDistributor(std::begin(eids), std::end(eids));
+                e = helper_.AddEdge(DeBruijnEdgeData(seq), id_distributor);
+            } else {
+                auto id_distributor = eid_storage->GetSegmentIdDistributor(i << 1, (i << 1) + 2);
+                e = helper_.AddEdge(DeBruijnEdgeData(seq), id_distributor);
+            }
+            edges_[seg.idx] = e;
         }
+
+        num_edges_ += batch_.size();
+        batch_.clear();
+        batch_nucls_ = 0;
     }
 
-    // INFO("Creating vertices");
-    restricted::IdSegmentStorage vid_storage = helper.graph().GetGraphIdDistributor().Reserve(gfa_->n_seg * 4);
-    std::unordered_set<VertexId> vertices;
-    for (uint32_t i = 0; i < gfa_->n_seg; ++i) {
-        auto id_distributor = vid_storage.GetSegmentIdDistributor(size_t(i << 2), size_t(i << 2) + 4); // indices for four vertices are required
-        VertexId v1 = helper.CreateVertex(DeBruijnVertexData(), id_distributor),
-                 v2 = helper.CreateVertex(DeBruijnVertexData(), id_distributor);
-
-        helper.LinkIncomingEdge(v1, edges[i]);
-        if (edges[i] != g.conjugate(edges[i]))
-            helper.LinkIncomingEdge(v2, g.conjugate(edges[i]));
-
-        vertices.insert(v1);
-        vertices.insert(v2);
-    }
-
-    // INFO("Linking edges");
-    for (uint32_t i = 0; i < gfa_->n_seg; ++i) {
-        EdgeId e1 = edges[i];
-        // Process direct links
-        {
-            uint32_t vv = i << 1 | 0;
-            gfa_arc_t *av = gfa_arc_a(gfa_.get(), vv);
-            for (size_t j = 0; j < gfa_arc_n(gfa_.get(), vv); ++j) {
-                EdgeId e2 = edges[av[j].w >> 1];
-                if (av[j].w & 1)
-                    e2 = g.conjugate(e2);
-                helper.LinkEdges(e1, e2);
+    // Directed edge: segment index << 1 | orientation. Self-conjugate edges
+    // have a single direction
+    size_t Dir(size_t sidx, bool rc) const {
+        return sidx << 1 | (rc && g_.conjugate(edges_[sidx]) != edges_[sidx]);
+    }
+
+    EdgeId DirEdge(size_t d) const {
+        EdgeId e = edges_[d >> 1];
+        return (d & 1) ? g_.conjugate(e) : e;
+    }
+
+    size_t ConjDir(size_t d) const {
+        return Dir(d >> 1, !(d & 1));
+    }
+
+    // Ends of directed edges (and their conjugates) are glued by links, every
+    // resulting class of ends becomes a vertex. Item (d << 1 | 0) is the end of
+    // directed edge d, item (d << 1 | 1) is its conjugate, i.e. the start of
+    // the conjugate direction.
+    void LinkEdges() {
+        edges_.resize(names_.size());
+        size_t dir_cnt = edges_.size() * 2;
+
+        size_t missing = 0;
+        dsu::ConcurrentDSU ends(dir_cnt * 2);
+#       pragma omp parallel for schedule(guided) reduction(+:missing)
+        for (size_t i = 0; i < links_.size(); ++i) {
+            const Link &l = links_[i];
+            if (edges_[l.from >> 1] == EdgeId() || edges_[l.to >> 1] == EdgeId()) {
+                missing += 1;
+                continue;
             }
+
+            // end(from) == start(to) == conj(end(conj(to)))
+            size_t from = Dir(l.from >> 1, l.from & 1),
+                     to = ConjDir(Dir(l.to >> 1, l.to & 1));
+            ends.unite(from << 1 | 0, to << 1 | 1);
+            ends.unite(from << 1 | 1, to << 1 | 0);
+        }
+        num_links_ = links_.size();
+        links_.clear();
+        links_.shrink_to_fit();
+        if (missing)
+            WARN(missing << " links refer to undefined segments and were ignored");
+
+        // (class, item) for all ends
+        std::vector<std::pair<size_t, size_t>> records;
+        records.reserve(dir_cnt * 2);
+        for (size_t d = 0; d < dir_cnt; ++d) {
+            if (edges_[d >> 1] == EdgeId() || Dir(d >> 1, d & 1) != d)
+                continue;
+            records.emplace_back(ends.find_set(d << 1 | 0), d << 1 | 0);
+            records.emplace_back(ends.find_set(d << 1 | 1), d << 1 | 1);
         }
+        parallel::sort(records.begin(), records.end());
 
-        // Process rc links
-        {
-            e1 = g.conjugate(e1);
-            uint32_t vv = i << 1 | 1;
-            gfa_arc_t *av = gfa_arc_a(gfa_.get(), vv);
-            for (size_t j = 0; j < gfa_arc_n(gfa_.get(), vv); ++j) {
-                EdgeId e2 = edges[av[j].w >> 1];
-                if (av[j].w & 1)
-                    e2 = g.conjugate(e2);
-                helper.LinkEdges(e1, e2);
+        std::vector<size_t> starts;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (i == 0 || records[i].first != records[i - 1].first)
+                starts.push_back(i);
+        }
+        starts.push_back(records.size());
+
+        size_t group_cnt = starts.size() - 1;
+        restricted::IdSegmentStorage vid_storage = g_.GetGraphIdDistributor().Reserve(group_cnt * 2);
+        helper_.ReserveVertices(group_cnt);
+        std::vector<std::vector<VertexId>> vertices(omp_get_max_threads());
+        size_t palindromic = 0;
+#       pragma omp parallel for schedule(guided) reduction(+:palindromic)
+        for (size_t i = 0; i < group_cnt; ++i) {
+            size_t cls = records[starts[i]].first;
+            size_t item = records[starts[i]].second;
+            size_t conj_cls = ends.find_set(item ^ 1);
+            // Every pair of conjugate classes is processed once
+            if (conj_cls < cls)
+                continue;
+
+            auto id_distributor = vid_storage.GetSegmentIdDistributor(i << 1, (i << 1) + 2);
+            VertexId v = helper_.CreateVertex(DeBruijnVertexData(), id_distributor);
+            vertices[omp_get_thread_num()].push_back(v);
+
+            // Self-conjugate vertices are not supported, such class is
+            // split into the vertex and its conjugate
+            palindromic += (conj_cls == cls);
+            for (size_t j = starts[i]; j < starts[i + 1]; ++j) {
+                size_t cur = records[j].second;
+                if (conj_cls == cls && (cur & 1))
+                    continue;
+                helper_.LinkIncomingEdge((cur & 1) ? g_.conjugate(v) : v, DirEdge(cur >> 1));
             }
         }
+        if (palindromic)
+            WARN(palindromic << " self-conjugate vertices were split");
+
+        for (const auto &vs : vertices)
+            helper_.AddVerticesToGraph(vs.begin(), vs.end());
     }
 
-    // INFO("Filtering dangling vertices");
-    for (auto it = vertices.begin(); it != vertices.end(); ) {
-        VertexId v = *it;
-        if (g.OutgoingEdgeCount(v) == 0 && g.IncomingEdgeCount(v) == 0) {
-            it = vertices.erase(it);
-        } else
-            ++it;
+    DeBruijnGraph &g_;
+    HelperT helper_;
+    bool numeric_ids_;
+
+    std::unordered_map<std::string, size_t> names_;
+    std::vector<bool> defined_;
+    std::unordered_set<uint64_t> numeric_seen_;
+    uint64_t max_id_;
+
+    std::vector<Segment> batch_;
+    size_t batch_nucls_;
+    std::vector<EdgeId> edges_;
+    std::vector<Link> links_;
+
+    uint64_t num_edges_;
+    uint64_t num_links_;
+};
+
+}
+
+GFAReader::GFAReader()
+        : valid_(false), num_edges_(0), num_links_(0) {}
+
+GFAReader::GFAReader(const std::string &filename)
+        : GFAReader() {
+    open(filename);
+}
+
+bool GFAReader::open(const std::string &filename) {
+    filename_ = filename;
+    valid_ = GFAStream(filename).is_open();
+
+    return valid_;
+}
+
+void GFAReader::to_graph(ConjugateDeBruijnGraph &g,
+                         bool numeric_ids) {
+    GFAStream in(filename_);
+    CHECK_FATAL_ERROR(in.is_open(), "Cannot open GFA file " << filename_);
+
+    GFAGraphBuilder builder(g, numeric_ids);
+    std::string type, name, ori;
+    while (true) {
+        int delim = in.ReadField(type);
+        if (delim == EOF && type.empty())
+            break;
+
+        size_t line = in.line();
+        if (type == "S") {
+            CHECK_FATAL_ERROR(in.ReadField(name) == '\t', "Invalid S-line at line " << line);
+            PackedNucls nucls;
+            delim = in.ReadField([&](char c) {
+                CHECK_FATAL_ERROR(is_nucl(c), "Invalid nucleotide in segment " << name << " at line " << line);
+                nucls.push_back(c);
+            });
+            CHECK_FATAL_ERROR(nucls.size(), "Segment " << name << " has no sequence at line " << line);
+            builder.AddSegment(name, std::move(nucls));
+        } else if (type == "L") {
+            auto read_end = [&]() {
+                CHECK_FATAL_ERROR(in.ReadField(name) == '\t', "Invalid L-line at line " << line);
+                delim = in.ReadField(ori);
+                CHECK_FATAL_ERROR(ori == "+" || ori == "-", "Invalid L-line at line " << line);
+                return builder.SegmentIdx(name) << 1 | (ori == "-");
+            };
+            size_t from = read_end();
+            CHECK_FATAL_ERROR(delim == '\t', "Invalid L-line at line " << line);
+            size_t to = read_end();
+            builder.AddLink(from, to);
+        }
+        if (in.SkipLine(delim) == EOF)
+            break;
     }
-    helper.AddVerticesToGraph(vertices.begin(), vertices.end());
+
+    builder.Finish();
+    num_edges_ = builder.num_edges();
+    num_links_ = builder.num_links();
 }
 
 }
@@ -4,12 +4,10 @@
 //* See file LICENSE for details.
 //***************************************************************************
 
-#include <memory>
-#include <string>
+#pragma once
 
-extern "C" {
-    typedef struct gfa_s gfa_t;
-};
+#include <cstdint>
+#include <string>
 
 namespace debruijn_graph {
 class DeBruijnGraph;
@@ -17,24 +15,28 @@ class DeBruijnGraph;
 
 namespace gfa {
 
+// Streaming GFA1 reader. Only S- and L-lines are used, segment sequences are
+// packed to 2 bits per nucleotide while being read, the text is never kept
+// in memory as a whole.
 class GFAReader {
   public:
     GFAReader();
     GFAReader(const std::string &filename);
     bool open(const std::string &filename);
-    bool valid() const { return (bool)gfa_; }
-    gfa_t *get() const { return gfa_.get(); }
+    bool valid() const { return valid_; }
 
-    uint32_t num_edges() const;
-    uint64_t num_links() const;
+    // Statistics of the last to_graph() call
+    uint64_t num_edges() const { return num_edges_; }
+    uint64_t num_links() const { return num_links_; }
 
     void to_graph(debruijn_graph::DeBruijnGraph &g,
                   bool numeric_ids = true);
-    
+
   private:
-    std::unique_ptr<gfa_t, void(*)(gfa_t*)> gfa_;
+    std::string filename_;
+    bool valid_;
+    uint64_t num_edges_;
+    uint64_t num_links_;
 };
 
 };
-
-
@@ -17,6 +17,7 @@
 
 #include "utils/verify.hpp"
 #include "ireader.hpp"
+#include "binary_file.hpp"
 #include "single_read.hpp"
 #include "paired_read.hpp"
 #include "orientation.hpp"
@@ -74,11 +75,19 @@ class BinaryWriter {
         std::vector<std::vector<Read>> buf(file_num_, std::vector<Read>(buffer_reads) );
         std::vector<ReadStreamStat> read_stats(file_num_);
         std::vector<size_t> current_buf_sizes(file_num_, 0);
+        std::vector<std::vector<uint64_t>> index(file_num_);
+        std::vector<size_t> written(file_num_, 0);
         size_t read_count = 0;
 
+        auto write = [&](size_t i, const Read &r) {
+            if (written[i]++ % BINARY_INDEX_STEP == 0)
+                index[i].push_back(file_ds_[i]->tellp());
+            writer.Write(*file_ds_[i], r);
+        };
+
         for (size_t i = 0; i < file_num_; ++i) {
             file_ds_[i]->seekp(0);
-            read_stats[i].write(*file_ds_[i]);
+            BinaryFileHeader().write(*file_ds_[i]);
         }
 
         size_t buf_index;
@@ -95,7 +104,7 @@ class BinaryWriter {
             if (read_count % reads_to_flush == 0) {
                 for (size_t i = 0; i < file_num_; ++i) {
                     for (const Read &read : buf[i]) {
-                        writer.Write(*file_ds_[i], read);
+                        write(i, read);
                     }
                     current_buf_sizes[i] = 0;
                 }
@@ -106,11 +115,18 @@ class BinaryWriter {
         for (size_t i = 0; i < file_num_; ++i) {
             buf[i].resize(current_buf_sizes[i]);
             for (const Read &r : buf[i]) {
-                writer.Write(*file_ds_[i], r);
+                write(i, r);
             }
 
+            BinaryFileHeader header;
+            header.stat = read_stats[i];
+            header.index_offset = file_ds_[i]->tellp();
+            uint64_t index_size = index[i].size();
+            file_ds_[i]->write((const char *) &index_size, sizeof(index_size));
+            file_ds_[i]->write((const char *) index[i].data(), index_size * sizeof(index[i][0]));
+
             file_ds_[i]->seekp(0);
-            read_stats[i].write(*file_ds_[i]);
+            header.write(*file_ds_[i]);
             result.merge(read_stats[i]);
         }
 
@@ -0,0 +1,135 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "ireader.hpp"
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace io {
+
+/*
+ * Layout of a binary read file:
+ *   header: read stream stat, offset of the index
+ *   reads
+ *   index: number of entries, offsets of every BINARY_INDEX_STEP-th read
+ * The index allows to split a file between several readers.
+ */
+static const size_t BINARY_INDEX_STEP = 1 << 14;
+
+struct BinaryFileHeader {
+    ReadStreamStat stat;
+    uint64_t index_offset;
+
+    BinaryFileHeader(): index_offset(0) {}
+
+    template<class Stream>
+    void write(Stream &stream) const {
+        stat.write(stream);
+        stream.write((const char *) &index_offset, sizeof(index_offset));
+    }
+
+    template<class Stream>
+    void read(Stream &stream) {
+        stat.read(stream);
+        stream.read((char *) &index_offset, sizeof(index_offset));
+    }
+};
+
+//Read-only memory mapping of the whole file with the istream-like interface
+//used by BinRead methods
+class MappedBinaryFile {
+    static const size_t READAHEAD = 16 << 20;
+
+    const char *data_;
+    size_t size_;
+    size_t pos_;
+    bool fail_;
+
+public:
+    MappedBinaryFile(const std::string &file_name)
+            : data_(nullptr), size_(0), pos_(0), fail_(false) {
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            fail_ = true;
+            return;
+        }
+
+        struct stat buf;
+        if (fstat(fd, &buf) != 0)
+            FATAL_ERROR("fstat(2) failed. Reason: " << strerror(errno) << ". File: " << file_name);
+        size_ = buf.st_size;
+        if (size_) {
+            void *addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED)
+                FATAL_ERROR("mmap(2) failed. Reason: " << strerror(errno) << ". File: " << file_name);
+            data_ = (const char *) addr;
+            madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    MappedBinaryFile(const MappedBinaryFile &) = delete;
+    MappedBinaryFile &operator=(const MappedBinaryFile &) = delete;
+
+    ~MappedBinaryFile() {
+        close();
+    }
+
+    bool is_open() const {
+        return data_ != nullptr;
+    }
+
+    void close() {
+        if (data_)
+            munmap((void *) data_, size_);
+        data_ = nullptr;
+        size_ = pos_ = 0;
+    }
+
+    MappedBinaryFile &read(char *buf, size_t amount) {
+        if (pos_ + amount > size_) {
+            fail_ = true;
+            return *this;
+        }
+        memcpy(buf, data_ + pos_, amount);
+        pos_ += amount;
+        return *this;
+    }
+
+    //Also asks the kernel to start reading the data from the new position
+    void seek(size_t pos) {
+        VERIFY(pos <= size_);
+        pos_ = pos;
+        fail_ = false;
+        if (pos_ < size_) {
+            size_t page_pos = pos_ / getpagesize() * getpagesize();
+            madvise((void *) (data_ + page_pos), std::min(READAHEAD, size_ - page_pos), MADV_WILLNEED);
+        }
+    }
+
+    size_t tell() const {
+        return pos_;
+    }
+
+    bool fail() const {
+        return fail_;
+    }
+};
+
+}
@@ -7,61 +7,110 @@
 
 #pragma once
 
-#include <fstream>
-
 #include "utils/verify.hpp"
 #include "ireader.hpp"
+#include "binary_file.hpp"
 #include "single_read.hpp"
 #include "paired_read.hpp"
 
 namespace io {
 
-class BinaryFileSingleStream: public ReadStream<SingleReadSeq> {
-    std::ifstream stream_;
-    ReadStreamStat read_stat_;
+//Range of reads of a binary read file, which is split into equal parts by its index
+class BinaryFileRange {
+    MappedBinaryFile file_;
+    size_t begin_;
+    size_t end_;
+    size_t begin_offset_;
     size_t current_;
 
-    void Init() {
-        stream_.clear();
-        stream_.seekg(0);
-        VERIFY(stream_.good());
-        read_stat_.read(stream_);
-        current_ = 0;
+public:
+    BinaryFileRange(const std::string& file_name_prefix, size_t file_num,
+                    size_t part, size_t parts)
+            : file_(file_name_prefix + "_" + std::to_string(file_num) + ".seq") {
+        VERIFY(part < parts);
+        BinaryFileHeader header;
+        header.read(file_);
+        VERIFY(!file_.fail());
+
+        size_t read_count = header.stat.read_count;
+        begin_ = 0;
+        end_ = read_count;
+        begin_offset_ = file_.tell();
+        if (parts > 1) {
+            uint64_t index_size = 0;
+            file_.seek(header.index_offset);
+            file_.read((char *) &index_size, sizeof(index_size));
+            size_t chunk_begin = index_size * part / parts;
+            size_t chunk_end = index_size * (part + 1) / parts;
+            begin_ = std::min(chunk_begin * BINARY_INDEX_STEP, read_count);
+            end_ = std::min(chunk_end * BINARY_INDEX_STEP, read_count);
+            if (chunk_begin < index_size) {
+                uint64_t offset = 0;
+                file_.seek(header.index_offset + sizeof(index_size) + chunk_begin * sizeof(offset));
+                file_.read((char *) &offset, sizeof(offset));
+                begin_offset_ = offset;
+            }
+            VERIFY(!file_.fail());
+        }
+
+        reset();
     }
 
-public:
+    bool is_open() const {
+        return file_.is_open();
+    }
 
-    BinaryFileSingleStream(const std::string& file_name_prefix, size_t file_num) {
-        std::string fname;
-        fname = file_name_prefix + "_" + std::to_string(file_num) + ".seq";
-        stream_.open(fname.c_str(), std::ios_base::binary | std::ios_base::in);
+    bool eof() const {
+        return current_ >= end_;
+    }
 
-        Init();
+    //File positioned at the next read
+    MappedBinaryFile &next() {
+        VERIFY(current_ < end_);
+        ++current_;
+        return file_;
+    }
+
+    void close() {
+        current_ = end_;
+        file_.close();
+    }
+
+    void reset() {
+        file_.seek(begin_offset_);
+        current_ = begin_;
+    }
+};
+
+class BinaryFileSingleStream: public ReadStream<SingleReadSeq> {
+    BinaryFileRange file_;
+
+public:
+
+    BinaryFileSingleStream(const std::string& file_name_prefix, size_t file_num,
+                           size_t part = 0, size_t parts = 1)
+            : file_(file_name_prefix, file_num, part, parts) {
     }
 
     bool is_open() override {
-        return stream_.is_open();
+        return file_.is_open();
     }
 
     bool eof() override {
-        return current_ == read_stat_.read_count;
+        return file_.eof();
     }
 
     BinaryFileSingleStream& operator>>(SingleReadSeq& read) override {
-        read.BinRead(stream_);
-        VERIFY(current_ < read_stat_.read_count);
-
-        ++current_;
+        read.BinRead(file_.next());
         return *this;
     }
 
     void close() override {
-        current_ = 0;
-        stream_.close();
+        file_.close();
     }
 
     void reset() override {
-        Init();
+        file_.reset();
     }
 
 };
@@ -71,6 +120,8 @@ class BinaryUnmergingPairedStream: public ReadStream<PairedReadSeq> {
     BinaryFileSingleStream stream_;
     size_t insert_size_;
     size_t read_length_;
+    //Reused to keep the sequence buffer between the reads
+    SingleReadSeq single_read_;
 
     PairedReadSeq Convert(const SingleReadSeq &read) const {
         if (read.GetLeftOffset() >= read_length_ ||
@@ -95,8 +146,9 @@ public:
     BinaryUnmergingPairedStream(const std::string& file_name_prefix,
                                size_t file_num,
                                size_t insert_size,
-                               size_t read_length) :
-            stream_(file_name_prefix, file_num),
+                               size_t read_length,
+                               size_t part = 0, size_t parts = 1) :
+            stream_(file_name_prefix, file_num, part, parts),
             insert_size_(insert_size),
             read_length_(read_length) {
     }
@@ -110,9 +162,10 @@ public:
     }
 
     BinaryUnmergingPairedStream& operator>>(PairedReadSeq& read) override {
-        SingleReadSeq single_read;
-        stream_ >> single_read;
-        read = Convert(single_read);
+        //The previous halves share the buffer of single_read_
+        read = PairedReadSeq();
+        stream_ >> single_read_;
+        read = Convert(single_read_);
         return *this;
     }
 
@@ -127,53 +180,35 @@ public:
 };
 
 class BinaryFilePairedStream: public ReadStream<PairedReadSeq> {
-    std::ifstream stream_;
+    BinaryFileRange file_;
     size_t insert_size_;
-    ReadStreamStat read_stat_;
-    size_t current_;
-
-    void Init() {
-        stream_.clear();
-        stream_.seekg(0);
-        VERIFY(stream_.good());
-        read_stat_.read(stream_);
-        current_ = 0;
-    }
 
 public:
 
-    BinaryFilePairedStream(const std::string& file_name_prefix, size_t file_num, size_t insert_szie): stream_(), insert_size_ (insert_szie) {
-        std::string fname;
-        fname = file_name_prefix + "_" + std::to_string(file_num) + ".seq";
-        stream_.open(fname.c_str(), std::ios_base::binary | std::ios_base::in);
-
-        Init();
+    BinaryFilePairedStream(const std::string& file_name_prefix, size_t file_num, size_t insert_szie,
+                           size_t part = 0, size_t parts = 1)
+            : file_(file_name_prefix, file_num, part, parts), insert_size_ (insert_szie) {
     }
 
     bool is_open() override {
-        return stream_.is_open();
+        return file_.is_open();
     }
 
     bool eof() override {
-        return current_ >= read_stat_.read_count;
+        return file_.eof();
     }
 
     BinaryFilePairedStream& operator>>(PairedReadSeq& read) override {
-        read.BinRead(stream_, insert_size_);
-        VERIFY(current_ < read_stat_.read_count);
-
-        ++current_;
+        read.BinRead(file_.next(), insert_size_);
         return *this;
     }
 
     void close() override {
-        current_ = 0;
-        stream_.close();
+        file_.close();
     }
 
-
     void reset() override {
-        Init();
+        file_.reset();
     }
 
 };
@@ -25,7 +25,8 @@ struct ReadStreamStat {
         stream.write((const char *) &total_len, sizeof(total_len));
     }
 
-    void read(std::istream& stream) {
+    template<class Stream>
+    void read(Stream& stream) {
         stream.read((char *) &read_count, sizeof(read_count));
         stream.read((char *) &max_len, sizeof(max_len));
         stream.read((char *) &total_len, sizeof(total_len));
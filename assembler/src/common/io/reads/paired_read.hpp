@@ -89,7 +89,8 @@ public:
                insert_size_ == paired_read.insert_size_;
     }
 
-    bool BinRead(std::istream &file, size_t estimated_is) {
+    template<class Stream>
+    bool BinRead(Stream &file, size_t estimated_is) {
         first_.BinRead(file);
         second_.BinRead(file);
 
@@ -258,7 +258,8 @@ public:
     SingleReadSeq() : seq_(), left_offset_(0), right_offset_(0) {
     }
 
-    bool BinRead(std::istream &file) {
+    template<class Stream>
+    bool BinRead(Stream &file) {
         seq_.BinRead(file);
         file.read((char *) &left_offset_, sizeof(left_offset_));
         file.read((char *) &right_offset_, sizeof(right_offset_));
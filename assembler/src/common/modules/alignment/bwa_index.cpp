@@ -12,9 +12,23 @@
 #include "bwa/rope.h"
 #include "bwa/utils.h"
 
+#include "utils/filesystem/path_helper.hpp"
+#include "utils/logger/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <memory>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #define MEM_F_SOFTCLIP  0x200
 
 #define _set_pac(pac, l, c) ((pac)[(l)>>2] |= uint8_t((c)<<((~(l)&3)<<1)))
@@ -25,12 +39,18 @@ int is_bwt(uint8_t *T, bwtint_t n);
 
 namespace alignment {
 
-BWAIndex::BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode, size_t length_cutoff)
+BWAIndex::MappedFile::~MappedFile() {
+    munmap(addr, size);
+}
+
+BWAIndex::BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode, size_t length_cutoff,
+                   const std::string &cache_dir)
         : g_(g),
           memopt_(mem_opt_init(), free),
           idx_(nullptr, bwa_idx_destroy),
           mode_(mode),
-          length_cutoff_(length_cutoff) {
+          length_cutoff_(length_cutoff),
+          cache_dir_(cache_dir) {
     memopt_->flag |= MEM_F_SOFTCLIP;
     switch (mode) {
         default:
@@ -63,110 +83,52 @@ BWAIndex::BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode, size_t le
 
 BWAIndex::~BWAIndex() {}
 
-static uint8_t* seqlib_add1(const std::string &seq, const std::string &name,
-                            bntseq_t *bns, uint8_t *pac, int64_t *m_pac, int *m_seqs, int *m_holes, bntamb1_t **q) {
-    bntann1_t *p;
-    int lasts;
-    if (bns->n_seqs == *m_seqs) {
-        *m_seqs <<= 1;
-        bns->anns = (bntann1_t*)realloc(bns->anns, *m_seqs * sizeof(bntann1_t));
-    }
-    p = bns->anns + bns->n_seqs;
-    p->name = strdup(name.c_str());
-    p->anno = strdup("(null");
-    p->gi = 0; p->len = int(seq.size());
-    p->offset = (bns->n_seqs == 0)? 0 : (p-1)->offset + (p-1)->len;
-    p->n_ambs = 0;
-    for (size_t i = lasts = 0; i < seq.size(); ++i) {
-        int c = nst_nt4_table[unsigned(seq[i])];
-        if (c >= 4) { // N
-            if (lasts == seq[i]) { // contiguous N
-                ++(*q)->len;
-            } else {
-                if (bns->n_holes == *m_holes) {
-                    (*m_holes) <<= 1;
-                    bns->ambs = (bntamb1_t*)realloc(bns->ambs, (*m_holes) * sizeof(bntamb1_t));
-                }
-                *q = bns->ambs + bns->n_holes;
-                (*q)->len = 1;
-                (*q)->offset = p->offset + i;
-                (*q)->amb = seq[i];
-                ++p->n_ambs;
-                ++bns->n_holes;
-            }
-        }
-        lasts = seq[i];
-        { // fill buffer
-            if (c >= 4) c = lrand48() & 3;
-            if (bns->l_pac == *m_pac) { // double the pac size
-                *m_pac <<= 1;
-                pac = (uint8_t*)realloc(pac, *m_pac/4);
-                memset(pac + bns->l_pac/4, 0, (*m_pac - bns->l_pac)/4);
-            }
-            _set_pac(pac, bns->l_pac, c);
-            ++bns->l_pac;
+// Forward sequences of all edges followed by their reverse complement, one nucleotide per byte
+static ubyte_t *seqlib_make_text(const debruijn_graph::Graph &g,
+                                 const std::vector<debruijn_graph::EdgeId> &ids,
+                                 const std::vector<size_t> &offsets, size_t tlen) {
+    ubyte_t *buf = (ubyte_t*)calloc(2 * tlen + 1, 1);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const Sequence &seq = g.EdgeNucls(ids[i]);
+        size_t offset = offsets[i];
+        for (size_t j = 0; j < seq.size(); ++j) {
+            ubyte_t c = ubyte_t(seq[j]);
+            buf[offset + j] = c;
+            buf[2 * tlen - 1 - offset - j] = ubyte_t(3 - c);
         }
     }
-    ++bns->n_seqs;
 
-    return pac;
+    return buf;
 }
 
-static uint8_t* seqlib_make_pac(const debruijn_graph::Graph &g,
-                                const std::vector<debruijn_graph::EdgeId> &ids,
-                                bool for_only) {
-    bntseq_t * bns = (bntseq_t*)calloc(1, sizeof(bntseq_t));
-    uint8_t *pac = 0;
-    int32_t m_seqs, m_holes;
-    int64_t m_pac, l;
-    bntamb1_t *q;
-
-    bns->seed = 11; // fixed seed for random generator
-    m_seqs = m_holes = 8; m_pac = 0x10000;
-    bns->anns = (bntann1_t*)calloc(m_seqs, sizeof(bntann1_t));
-    bns->ambs = (bntamb1_t*)calloc(m_holes, sizeof(bntamb1_t));
-    pac = (uint8_t*) calloc(m_pac/4, 1);
-    q = bns->ambs;
-
-    // Move through the sequences
-    for (auto e : ids) {
-        std::string ref = std::to_string(g.int_id(e));
-        std::string seq = g.EdgeNucls(e).str();
-
-        // make the forward only pac
-        pac = seqlib_add1(seq, ref, bns, pac, &m_pac, &m_seqs, &m_holes, &q);
-    }
+// Packs first len nucleotides of the text into forward-only pac
+static uint8_t* seqlib_make_pac(const ubyte_t *buf, size_t len) {
+    uint8_t *pac = (uint8_t*)calloc(len / 4 + 1, 1);
 
-    if (!for_only) {
-        // add the reverse complemented sequence
-        m_pac = (bns->l_pac * 2 + 3) / 4 * 4;
-        pac = (uint8_t*)realloc(pac, m_pac/4);
-        memset(pac + (bns->l_pac+3)/4, 0, (m_pac - (bns->l_pac+3)/4*4) / 4);
-        for (l = bns->l_pac - 1; l >= 0; --l, ++bns->l_pac)
-            _set_pac(pac, bns->l_pac, 3-_get_pac(pac, l));
+    #pragma omp parallel for
+    for (size_t i = 0; i < (len + 3) / 4; ++i) {
+        for (size_t l = 4 * i; l < std::min(4 * i + 4, len); ++l)
+            _set_pac(pac, l, buf[l]);
     }
 
-    bns_destroy(bns);
-
     return pac;
 }
 
-static bwt_t *seqlib_bwt_pac2bwt(const uint8_t *pac, size_t bwt_seq_lenr) {
+// Takes the ownership of the text
+static bwt_t *seqlib_bwt_text2bwt(ubyte_t *buf, size_t bwt_seq_lenr) {
     bwt_t *bwt;
-    ubyte_t *buf;
 
     // Initialization
     bwt = (bwt_t*)calloc(1, sizeof(bwt_t));
     bwt->seq_len = bwt_seq_lenr;
     bwt->bwt_size = (bwt->seq_len + 15) >> 4;
 
-    // Prepare sequence
+    // Count nucleotides
     memset(bwt->L2, 0, 5 * 4);
-    buf = (ubyte_t*)calloc(bwt->seq_len + 1, 1);
-    for (bwtint_t i = 0; i < bwt->seq_len; ++i) {
-        buf[i] = pac[i>>2] >> ((3 - (i&3)) << 1) & 3;
+    for (bwtint_t i = 0; i < bwt->seq_len; ++i)
         ++bwt->L2[1+buf[i]];
-    }
     for (bwtint_t i = 2; i <= 4; ++i)
         bwt->L2[i] += bwt->L2[i-1];
 
@@ -207,11 +169,11 @@ static bwt_t *seqlib_bwt_pac2bwt(const uint8_t *pac, size_t bwt_seq_lenr) {
     return bwt;
 }
 
-static bntann1_t* seqlib_add_to_anns(const std::string& name, const std::string& seq, bntann1_t* ann, size_t offset) {
+static bntann1_t* seqlib_add_to_anns(const std::string& name, size_t len, bntann1_t* ann, size_t offset) {
     ann->offset = offset;
     ann->name = strdup(name.c_str());
     ann->anno = strdup("(null)");
-    ann->len = int(seq.length());
+    ann->len = int(len);
     ann->n_ambs = 0; // number of "holes"
     ann->gi = 0; // gi?
     ann->is_alt = 0;
@@ -219,8 +181,120 @@ static bntann1_t* seqlib_add_to_anns(const std::string& name, const std::string&
     return ann;
 }
 
-void BWAIndex::Init() {
+namespace {
+
+struct IndexFileHeader {
+    char magic[8];
+    uint64_t fingerprint;
+    uint64_t l_mem;
+};
+
+const char INDEX_FILE_MAGIC[8] = { 'S', 'P', 'B', 'W', 'A', 'I', '0', '1' };
+
+}
+
+// Hash of ids and sequences of all indexed edges
+static uint64_t GraphFingerprint(const debruijn_graph::Graph &g,
+                                 const std::vector<debruijn_graph::EdgeId> &ids) {
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+    std::vector<uint64_t> hashes(ids.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const Sequence &seq = g.EdgeNucls(ids[i]);
+        uint64_t h = (14695981039346656037ULL ^ g.int_id(ids[i])) * FNV_PRIME;
+        for (size_t j = 0; j < seq.size(); ++j)
+            h = (h ^ seq[j]) * FNV_PRIME;
+        hashes[i] = (h ^ seq.size()) * FNV_PRIME;
+    }
+
+    uint64_t res = g.k();
+    for (uint64_t h : hashes)
+        res = (res ^ h) * FNV_PRIME;
+    return res;
+}
+
+std::string BWAIndex::IndexFileName(uint64_t fingerprint) const {
+    std::ostringstream ss;
+    ss << "graph_" << std::hex << fingerprint << ".bwaidx";
+    return fs::append_path(cache_dir_, ss.str());
+}
+
+bool BWAIndex::LoadIndex(uint64_t fingerprint) {
+    std::string fname = IndexFileName(fingerprint);
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    IndexFileHeader header;
+    bool valid = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(header) &&
+                 pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                 memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.fingerprint == fingerprint &&
+                 header.l_mem == size_t(st.st_size) - sizeof(header);
+    if (!valid) {
+        close(fd);
+        WARN("BWA index file " << fname << " is corrupted, rebuilding");
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        WARN("Cannot mmap BWA index file " << fname << ", rebuilding");
+        return false;
+    }
+    mapping_.reset(new MappedFile{mapped, size_t(st.st_size)});
+
+    // Index structures point directly into the mapping, bwa should not free it
     idx_.reset((bwaidx_t*)calloc(1, sizeof(bwaidx_t)));
+    idx_->is_shm = 1;
+    bwa_mem2idx(int64_t(header.l_mem), (uint8_t*)mapped + sizeof(header), idx_.get());
+    INFO("BWA index loaded from " << fname);
+
+    return true;
+}
+
+void BWAIndex::StoreIndex(uint64_t fingerprint) {
+    // Flatten the index into a single memory block, which is exactly what is written
+    bwa_idx2mem(idx_.get());
+
+    fs::make_dirs(cache_dir_);
+    std::string fname = IndexFileName(fingerprint);
+    // Several processes or indices might be storing the same file, each writes its own one
+    std::string tmp_fname = fname + ".XXXXXX";
+    int fd = mkstemp(&tmp_fname[0]);
+    if (fd < 0) {
+        WARN("Cannot create temporary file for BWA index " << fname << ": " << strerror(errno));
+        return;
+    }
+    close(fd);
+    {
+        std::ofstream os(tmp_fname, std::ios::binary);
+        IndexFileHeader header;
+        memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+        header.fingerprint = fingerprint;
+        header.l_mem = idx_->l_mem;
+        os.write((const char*)&header, sizeof(header));
+        os.write((const char*)idx_->mem, idx_->l_mem);
+        if (!os.good()) {
+            WARN("Cannot write BWA index to " << tmp_fname);
+            os.close();
+            fs::remove_if_exists(tmp_fname);
+            return;
+        }
+    }
+    // rename is atomic, readers see either no file or a complete one
+    if (rename(tmp_fname.c_str(), fname.c_str()) != 0) {
+        WARN("Cannot rename " << tmp_fname << " to " << fname << ": " << strerror(errno));
+        fs::remove_if_exists(tmp_fname);
+        return;
+    }
+    INFO("BWA index saved to " << fname);
+}
+
+void BWAIndex::Init() {
     ids_.clear();
 
     for (auto it = g_.ConstEdgeBegin(true); !it.IsEnd(); ++it)
@@ -228,21 +302,30 @@ void BWAIndex::Init() {
             ids_.push_back(*it);
         }
 
-    // construct the forward-only pac
-    uint8_t* fwd_pac = seqlib_make_pac(g_, ids_, true); // true->for_only
+    uint64_t fingerprint = 0;
+    if (!cache_dir_.empty()) {
+        fingerprint = GraphFingerprint(g_, ids_);
+        if (LoadIndex(fingerprint))
+            return;
+    }
 
-    // construct the forward-reverse pac ("packed" 2 bit sequence)
-    uint8_t* pac = seqlib_make_pac(g_, ids_, false); // don't write, because only used to make BWT
+    idx_.reset((bwaidx_t*)calloc(1, sizeof(bwaidx_t)));
 
+    std::vector<size_t> offsets(ids_.size());
     size_t tlen = 0;
-    for (auto e : ids_)
-        tlen += g_.EdgeNucls(e).size();
+    for (size_t i = 0; i < ids_.size(); ++i) {
+        offsets[i] = tlen;
+        tlen += g_.EdgeNucls(ids_[i]).size();
+    }
+
+    // construct the forward-reverse text and the forward-only pac ("packed" 2 bit sequence) from it
+    ubyte_t *text = seqlib_make_text(g_, ids_, offsets, tlen);
+    uint8_t* fwd_pac = seqlib_make_pac(text, tlen);
 
     // make the bwt
     bwt_t *bwt;
-    bwt = seqlib_bwt_pac2bwt(pac, tlen*2); // *2 for fwd and rev
+    bwt = seqlib_bwt_text2bwt(text, tlen*2); // *2 for fwd and rev
     bwt_bwtupdate_core(bwt);
-    free(pac); // done with fwd-rev pac
 
     // construct sa from bwt and occ. adds it to bwt struct
     bwt_cal_sa(bwt, 32);
@@ -258,12 +341,9 @@ void BWAIndex::Init() {
     // make the anns
     // FIXME: Do we really need this?
     bns->anns = (bntann1_t*)calloc(ids_.size(), sizeof(bntann1_t));
-    size_t offset = 0, k = 0;
-    for (auto e: ids_) {
-        std::string name = std::to_string(g_.int_id(e));
-        std::string seq = g_.EdgeNucls(e).str();
-        seqlib_add_to_anns(name, seq, &bns->anns[k++], offset);
-        offset += seq.length();
+    for (size_t i = 0; i < ids_.size(); ++i) {
+        std::string name = std::to_string(g_.int_id(ids_[i]));
+        seqlib_add_to_anns(name, g_.EdgeNucls(ids_[i]).size(), &bns->anns[i], offsets[i]);
     }
 
     // ambs is "holes", like N bases
@@ -273,6 +353,9 @@ void BWAIndex::Init() {
     idx_->bwt = bwt;
     idx_->bns = bns;
     idx_->pac = fwd_pac;
+
+    if (!cache_dir_.empty())
+        StoreIndex(fingerprint);
 }
 
 #if 0
@@ -358,13 +441,18 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const me
 }
 
 
-omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::AlignSequence(const Sequence &sequence) const {
+omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::AlignSequence(const Sequence &sequence,
+                                                                       std::string &seq, void *buf) const {
     omnigraph::MappingPath<debruijn_graph::EdgeId> res;
     VERIFY(idx_);
 
-    std::string seq = sequence.str();
-    mem_alnreg_v ar = mem_align1(memopt_.get(), idx_->bwt, idx_->bns, idx_->pac,
-                                 int(seq.length()), seq.data());
+    // bwa works with 2-bit encoded queries, so there is no need to go through nucleotide string
+    seq.resize(sequence.size());
+    for (size_t i = 0; i < sequence.size(); ++i)
+        seq[i] = char(sequence[i]);
+
+    mem_alnreg_v ar = mem_align1_buf(memopt_.get(), idx_->bwt, idx_->bns, idx_->pac,
+                                     int(seq.length()), &seq[0], buf);
     res = GetMappingPath(ar, seq);
 
     free(ar.a);
@@ -372,4 +460,26 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::AlignSequence(const Seq
     return res;
 }
 
+omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::AlignSequence(const Sequence &sequence) const {
+    std::string seq;
+    return AlignSequence(sequence, seq, nullptr);
+}
+
+std::vector<omnigraph::MappingPath<debruijn_graph::EdgeId>> BWAIndex::AlignSequences(const std::vector<Sequence> &sequences) const {
+    std::vector<omnigraph::MappingPath<debruijn_graph::EdgeId>> res(sequences.size());
+
+    // Called from within a parallel region this is executed by the calling thread only
+    #pragma omp parallel
+    {
+        std::unique_ptr<void, void(*)(void*)> buf(mem_buf_init(), mem_buf_destroy);
+        std::string seq;
+
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < sequences.size(); ++i)
+            res[i] = AlignSequence(sequences[i], seq, buf.get());
+    }
+
+    return res;
+}
+
 }
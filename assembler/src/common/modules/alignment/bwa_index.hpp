@@ -34,12 +34,29 @@ class BWAIndex {
 
     // bwaidx / memopt are incomplete below, therefore we need to outline ctor
     // and dtor.
-    BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode = AlignmentMode::Default, size_t length_cutoff = 0);
+    // If cache_dir is not empty, the index is saved there and reused (mmapped)
+    // by the next index of the same graph. Cache files are never removed here,
+    // the owner of cache_dir has to clean it up.
+    BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode = AlignmentMode::Default, size_t length_cutoff = 0,
+             const std::string &cache_dir = "");
     ~BWAIndex();
 
     omnigraph::MappingPath<debruijn_graph::EdgeId> AlignSequence(const Sequence &sequence) const;
+    // Aligns the whole batch reusing the SMEM buffer of every worker thread
+    std::vector<omnigraph::MappingPath<debruijn_graph::EdgeId>> AlignSequences(const std::vector<Sequence> &sequences) const;
   private:
+    struct MappedFile {
+        void *addr;
+        size_t size;
+        ~MappedFile();
+    };
+
     void Init();
+    std::string IndexFileName(uint64_t fingerprint) const;
+    bool LoadIndex(uint64_t fingerprint);
+    void StoreIndex(uint64_t fingerprint);
+    omnigraph::MappingPath<debruijn_graph::EdgeId> AlignSequence(const Sequence &sequence,
+                                                                 std::string &seq, void *buf) const;
     omnigraph::MappingPath<debruijn_graph::EdgeId> GetMappingPath(const mem_alnreg_v&, const std::string &) const;
     omnigraph::MappingPath<debruijn_graph::EdgeId> GetShortMappingPath(const mem_alnreg_v&, const std::string &) const;
 
@@ -48,6 +65,9 @@ class BWAIndex {
     // Store the options in memory
     std::unique_ptr<mem_opt_t, void(*)(void*)> memopt_;
 
+    // Index file the structures below point into, if it was loaded from cache
+    std::unique_ptr<MappedFile> mapping_;
+
     // hold the full index structure
     std::unique_ptr<bwaidx_t, void(*)(bwaidx_t*)> idx_;
 
@@ -56,6 +76,8 @@ class BWAIndex {
     AlignmentMode mode_;
 
     size_t length_cutoff_;
+
+    std::string cache_dir_;
 };
 
 }
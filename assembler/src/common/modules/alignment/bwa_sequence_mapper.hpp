@@ -19,14 +19,19 @@ class BWAReadMapper: public debruijn_graph::AbstractSequenceMapper<Graph> {
 public:
     explicit BWAReadMapper(const Graph& g,
                            BWAIndex::AlignmentMode mode = BWAIndex::AlignmentMode::Default,
-                           size_t length_cutoff = 0)
+                           size_t length_cutoff = 0,
+                           const std::string &cache_dir = "")
             : debruijn_graph::AbstractSequenceMapper<Graph>(g),
-            index_(g, mode, length_cutoff) {}
+            index_(g, mode, length_cutoff, cache_dir) {}
 
     omnigraph::MappingPath<EdgeId> MapSequence(const Sequence &sequence) const {
         return index_.AlignSequence(sequence);
     }
 
+    std::vector<omnigraph::MappingPath<EdgeId>> MapSequences(const std::vector<Sequence> &sequences) const override {
+        return index_.AlignSequences(sequences);
+    }
+
     BWAIndex index_;
 };
 
@@ -29,6 +29,7 @@ public:
     typedef typename InnerIndex::KMer KMer;
     typedef typename InnerIndex::KMerIdx KMerIdx;
     typedef typename InnerIndex::KmerPos Value;
+    typedef typename InnerIndex::KeyWithHash KeyWithHash;
 
 private:
     InnerIndex inner_index_;
@@ -75,9 +76,24 @@ public:
         return inner_index_.contains(inner_index_.ConstructKWH(kmer));
     }
 
+    KeyWithHash ConstructKWH(const KMer& kmer) const {
+        return inner_index_.ConstructKWH(kmer);
+    }
+
+    void prefetch_idx(const KeyWithHash& kwh) const {
+        inner_index_.prefetch_idx(kwh);
+    }
+
+    void prefetch(const KeyWithHash& kwh) const {
+        inner_index_.prefetch(kwh);
+    }
+
     const pair<EdgeId, size_t> get(const KMer& kmer) const {
+        return get(inner_index_.ConstructKWH(kmer));
+    }
+
+    const pair<EdgeId, size_t> get(const KeyWithHash& kwh) const {
         VERIFY(this->IsAttached());
-        auto kwh = inner_index_.ConstructKWH(kmer);
         if (!inner_index_.contains(kwh)) {
             return make_pair(EdgeId(), -1u);
         } else {
@@ -12,6 +12,10 @@
 #include <htrie/hat-trie.h>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <cstring>
+#include <memory>
+#include <vector>
+
 namespace debruijn_graph {
 class KMerMap {
     typedef RtSeq Kmer;
@@ -146,6 +150,83 @@ class KMerMap {
     hattrie_t *mapping_;
 };
 
+// Immutable copy of a KMerMap: open addressing table with a blocked Bloom
+// prefilter, so that most k-mers without substitution are rejected after
+// reading a single 64-bit word
+class FrozenKMerMap {
+    typedef RtSeq Kmer;
+    typedef RtSeq Seq;
+    typedef typename Seq::DataType RawSeqData;
+
+    enum : uint32_t { EMPTY = uint32_t(-1) };
+
+    static uint64_t FilterMask(size_t hash) {
+        return (1ull << ((hash >> 40) & 63)) | (1ull << ((hash >> 46) & 63));
+    }
+
+    static size_t RoundUpPow2(size_t n) {
+        size_t res = 1;
+        while (res < n)
+            res <<= 1;
+        return res;
+    }
+
+    const RawSeqData *key(size_t idx) const {
+        return keys_.data() + idx * rawcnt_;
+    }
+
+  public:
+    FrozenKMerMap(const KMerMap &map, unsigned k)
+            : rawcnt_((unsigned)Seq::GetDataSize(k)) {
+        VERIFY_MSG(map.size() < EMPTY, "Too many k-mers for frozen k-mer map");
+        slots_.resize(RoundUpPow2(2 * map.size() + 1), uint32_t(EMPTY));
+        // ~16 bits per k-mer
+        filter_.resize(RoundUpPow2(map.size() / 4 + 1), 0);
+        keys_.reserve(map.size() * rawcnt_);
+        values_.reserve(map.size() * rawcnt_);
+
+        size_t slot_mask = slots_.size() - 1, filter_mask = filter_.size() - 1;
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            const auto &entry = *it;
+            size_t hash = entry.first.GetHash();
+            filter_[hash & filter_mask] |= FilterMask(hash);
+
+            size_t slot = hash & slot_mask;
+            while (slots_[slot] != EMPTY)
+                slot = (slot + 1) & slot_mask;
+            slots_[slot] = uint32_t(keys_.size() / rawcnt_);
+            keys_.insert(keys_.end(), entry.first.data(), entry.first.data() + rawcnt_);
+            values_.insert(values_.end(), entry.second.data(), entry.second.data() + rawcnt_);
+        }
+    }
+
+    const RawSeqData *find(const Kmer &kmer) const {
+        size_t hash = kmer.GetHash();
+        uint64_t mask = FilterMask(hash);
+        if ((filter_[hash & (filter_.size() - 1)] & mask) != mask)
+            return nullptr;
+
+        size_t slot_mask = slots_.size() - 1;
+        for (size_t slot = hash & slot_mask; slots_[slot] != EMPTY; slot = (slot + 1) & slot_mask) {
+            size_t idx = slots_[slot];
+            if (memcmp(key(idx), kmer.data(), rawcnt_ * sizeof(RawSeqData)) == 0)
+                return values_.data() + idx * rawcnt_;
+        }
+        return nullptr;
+    }
+
+    size_t size() const {
+        return keys_.size() / rawcnt_;
+    }
+
+  private:
+    unsigned rawcnt_;
+    std::vector<uint32_t> slots_;
+    std::vector<uint64_t> filter_;
+    std::vector<RawSeqData> keys_;
+    std::vector<RawSeqData> values_;
+};
+
 }
 
 #endif // __KMER_MAP_HPP__
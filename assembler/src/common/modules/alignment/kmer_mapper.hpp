@@ -27,6 +27,8 @@ class KmerMapper : public omnigraph::GraphActionHandler<Graph> {
 
     unsigned k_;
     KMerMap mapping_;
+    // Read-only normalized snapshot used for lookups while the mapping is unchanged
+    std::unique_ptr<FrozenKMerMap> frozen_;
     bool verification_on_;
     bool normalized_;
 
@@ -78,6 +80,24 @@ public:
         normalized_ = true;
     }
 
+    // Normalizes the mapping and switches lookups to an immutable snapshot of it.
+    // Any subsequent modification drops the snapshot.
+    void Freeze() {
+        if (frozen_)
+            return;
+
+        Normalize();
+        frozen_.reset(new FrozenKMerMap(mapping_, k_));
+    }
+
+    void Thaw() {
+        frozen_.reset();
+    }
+
+    bool frozen() const {
+        return bool(frozen_);
+    }
+
     unsigned k() const {
         return k_;
     }
@@ -92,6 +112,7 @@ public:
 //    }
 
     void Normalize(const Kmer &kmer) {
+        Thaw();
         mapping_.set(kmer, Substitute(kmer));
     }
 
@@ -125,12 +146,15 @@ public:
             if (mapping_.count(new_kmer)) {
                 // Special case of remapping back.
                 // Not sure that we actually need it
-                if (Substitute(new_kmer) == old_kmer)
+                if (Substitute(new_kmer) == old_kmer) {
+                    Thaw();
                     mapping_.erase(new_kmer);
+                }
                 else
                     continue;
             }
 
+            Thaw();
             mapping_.set(old_kmer, new_kmer);
             normalized_ = false;
         }
@@ -143,6 +167,12 @@ public:
 
     Kmer Substitute(const Kmer &kmer) const {
         VERIFY(this->IsAttached());
+        if (frozen_) {
+            // Snapshot is normalized, so a single lookup is enough
+            const auto *rawval = frozen_->find(kmer);
+            return rawval ? Seq(k_, rawval) : kmer;
+        }
+
         Kmer answer = kmer;
         const auto *rawval = mapping_.find(answer);
         while (rawval != nullptr) {
@@ -157,6 +187,9 @@ public:
     }
 
     bool CanSubstitute(const Kmer &kmer) const {
+        if (frozen_)
+            return frozen_->find(kmer) != nullptr;
+
         const auto *rawval = mapping_.find(kmer);
         return rawval != nullptr;
     }
@@ -202,6 +235,7 @@ public:
     }
 
     void clear() {
+        Thaw();
         normalized_ = false;
         return mapping_.clear();
     }
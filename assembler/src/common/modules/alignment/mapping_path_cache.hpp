@@ -0,0 +1,158 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "assembly_graph/core/action_handlers.hpp"
+#include "assembly_graph/paths/mapping_path.hpp"
+#include "utils/filesystem/temporary.hpp"
+#include "utils/verify.hpp"
+
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+namespace debruijn_graph {
+
+// Mapping paths of all reads of a library recorded on the first pass over it,
+// so later passes could replay them instead of mapping the reads again. There
+// is one file per read stream, every path is stored as a sequence of varints.
+// Any edge addition or removal in the graph invalidates the cache.
+template<class Graph>
+class MappingPathCache : public omnigraph::GraphActionHandler<Graph> {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef omnigraph::MappingPath<EdgeId> PathT;
+
+    static void WriteVarint(std::ostream &os, uint64_t v) {
+        while (v >= 0x80) {
+            os.put(char(v | 0x80));
+            v >>= 7;
+        }
+        os.put(char(v));
+    }
+
+    static uint64_t ReadVarint(std::istream &is) {
+        uint64_t v = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            int c = is.get();
+            VERIFY_MSG(c != EOF, "Mapping path cache is truncated");
+            v |= uint64_t(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return v;
+        }
+    }
+
+  public:
+    class Writer {
+      public:
+        explicit Writer(const std::string &fname)
+                : os_(fname, std::ios::binary) {
+            VERIFY_MSG(os_.good(), "Cannot create mapping path cache " << fname);
+        }
+
+        void Write(const PathT &path) {
+            WriteVarint(os_, path.size());
+            for (size_t i = 0; i < path.size(); ++i) {
+                auto mapping = path[i];
+                const MappingRange &range = mapping.second;
+                WriteVarint(os_, mapping.first.int_id());
+                WriteVarint(os_, range.initial_range.start_pos);
+                WriteVarint(os_, range.initial_range.end_pos);
+                WriteVarint(os_, range.mapped_range.start_pos);
+                WriteVarint(os_, range.mapped_range.end_pos);
+            }
+        }
+
+      private:
+        std::ofstream os_;
+    };
+
+    class Reader {
+      public:
+        Reader(const MappingPathCache &cache, const std::string &fname)
+                : cache_(cache), is_(fname, std::ios::binary) {
+            VERIFY_MSG(is_.good(), "Cannot open mapping path cache " << fname);
+        }
+
+        PathT Read() {
+            PathT path;
+            size_t size = ReadVarint(is_);
+            for (size_t i = 0; i < size; ++i) {
+                EdgeId e = cache_.edge(ReadVarint(is_));
+                size_t i_start = ReadVarint(is_), i_end = ReadVarint(is_);
+                size_t m_start = ReadVarint(is_), m_end = ReadVarint(is_);
+                path.push_back(e, MappingRange(i_start, i_end, m_start, m_end));
+            }
+            return path;
+        }
+
+      private:
+        const MappingPathCache &cache_;
+        std::ifstream is_;
+    };
+
+    MappingPathCache(const Graph &g, fs::TmpDir workdir)
+            : omnigraph::GraphActionHandler<Graph>(g, "MappingPathCache"),
+              workdir_(workdir), filled_(false), valid_(true) {}
+
+    // Whether all paths were recorded and the graph did not change since then
+    bool ready() const {
+        return filled_ && valid_;
+    }
+
+    size_t streams() const {
+        return files_.size();
+    }
+
+    // Drops all recorded paths and prepares one file per read stream
+    void Reset(size_t nstreams) {
+        files_.clear();
+        edges_.clear();
+        for (size_t i = 0; i < nstreams; ++i)
+            files_.push_back(workdir_->tmp_file("mapping_paths"));
+        filled_ = false;
+        valid_ = true;
+    }
+
+    Writer writer(size_t stream) const {
+        return Writer(*files_[stream]);
+    }
+
+    Reader reader(size_t stream) const {
+        VERIFY(ready());
+        return Reader(*this, *files_[stream]);
+    }
+
+    // Should be called once all streams were recorded
+    void Finish() {
+        for (auto it = this->g().ConstEdgeBegin(); !it.IsEnd(); ++it)
+            edges_.emplace((*it).int_id(), *it);
+        filled_ = true;
+    }
+
+    void HandleAdd(EdgeId) override {
+        valid_ = false;
+    }
+
+    void HandleDelete(EdgeId) override {
+        valid_ = false;
+    }
+
+  private:
+    EdgeId edge(uint64_t id) const {
+        auto it = edges_.find(id);
+        VERIFY(it != edges_.end());
+        return it->second;
+    }
+
+    fs::TmpDir workdir_;
+    std::vector<fs::TmpFile> files_;
+    std::unordered_map<uint64_t, EdgeId> edges_;
+    bool filled_;
+    bool valid_;
+};
+
+}
@@ -0,0 +1,131 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace pacbio {
+
+// Concurrent cache of bounded single-source distances. All distances found by
+// one run from a start vertex are stored together, so every later query from
+// that vertex is answered without another run. The cache is split into shards
+// by start vertex, each guarded by its own lock and evicting start vertices in
+// CLOCK order once the total number of stored distances exceeds its capacity.
+template<class VertexId>
+class DistanceCache {
+  public:
+    typedef std::vector<std::pair<VertexId, size_t>> Distances;
+
+  private:
+    struct Entry {
+        VertexId start;
+        Distances distances; // sorted by vertex
+        bool referenced;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<VertexId, size_t> index; // start vertex -> slot
+        std::vector<Entry> slots;
+        size_t hand = 0;
+        size_t stored = 0;
+    };
+
+    static size_t Find(const Distances &distances, VertexId v) {
+        auto it = std::lower_bound(distances.begin(), distances.end(), v,
+                                   [](const std::pair<VertexId, size_t> &d, VertexId v) { return d.first < v; });
+        return (it != distances.end() && it->first == v) ? it->second : size_t(-1);
+    }
+
+    Shard &shard(VertexId v) {
+        return shards_[std::hash<VertexId>()(v) % shards_.size()];
+    }
+
+    // Frees slots in CLOCK order until the new entry fits into the shard
+    void Evict(Shard &shard, size_t required) {
+        while (!shard.slots.empty() && shard.stored + required > shard_capacity_) {
+            Entry &entry = shard.slots[shard.hand];
+            if (entry.referenced) {
+                entry.referenced = false;
+                shard.hand = (shard.hand + 1) % shard.slots.size();
+                continue;
+            }
+
+            shard.stored -= entry.distances.size();
+            shard.index.erase(entry.start);
+            if (shard.hand != shard.slots.size() - 1) {
+                entry = std::move(shard.slots.back());
+                shard.index[entry.start] = shard.hand;
+            }
+            shard.slots.pop_back();
+            if (shard.hand >= shard.slots.size())
+                shard.hand = 0;
+        }
+    }
+
+  public:
+    DistanceCache(size_t capacity, size_t shards = 256)
+            : shards_(shards), shard_capacity_(capacity / shards + 1),
+              hits_(0), misses_(0) {
+        VERIFY(shards > 0);
+    }
+
+    // Returns the distance from start to end, or size_t(-1) if end was not reached.
+    // All distances from start are counted by calc(start) on a cache miss.
+    size_t Get(VertexId start, VertexId end,
+               const std::function<Distances(VertexId)> &calc,
+               bool update_cache = true) {
+        Shard &s = shard(start);
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            auto it = s.index.find(start);
+            if (it != s.index.end()) {
+                Entry &entry = s.slots[it->second];
+                entry.referenced = true;
+                hits_ += 1;
+                return Find(entry.distances, end);
+            }
+        }
+
+        misses_ += 1;
+        Distances distances = calc(start);
+        std::sort(distances.begin(), distances.end());
+        size_t result = Find(distances, end);
+        if (!update_cache)
+            return result;
+
+        std::lock_guard<std::mutex> guard(s.lock);
+        // Somebody else might have counted the same start vertex meanwhile
+        if (s.index.count(start) || distances.size() > shard_capacity_)
+            return result;
+
+        Evict(s, distances.size());
+        s.stored += distances.size();
+        s.index[start] = s.slots.size();
+        s.slots.push_back({start, std::move(distances), false});
+
+        return result;
+    }
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+  private:
+    std::vector<Shard> shards_;
+    size_t shard_capacity_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+};
+
+}
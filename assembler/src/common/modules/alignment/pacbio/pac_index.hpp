@@ -23,6 +23,7 @@
 #include "sequence/sequence_tools.hpp"
 
 #include "pacbio_read_structures.hpp"
+#include "distance_cache.hpp"
 
 #include <algorithm>
 #include <vector>
@@ -56,7 +57,9 @@ private:
 
     static const int LONG_ALIGNMENT_OVERLAP = 300;
     static const size_t SHORT_SPURIOUS_LENGTH = 500;
-    mutable std::map<std::pair<VertexId, VertexId>, size_t> distance_cashed_;
+    // Upper bound on the number of vertex distances kept in the cache
+    static const size_t MAX_CACHED_DISTANCES = 1 << 24;
+    mutable DistanceCache<VertexId> distance_cache_;
     size_t read_count_;
     debruijn_graph::config::pacbio_processor pb_config_;
 
@@ -65,15 +68,23 @@ private:
 public:
 
     PacBioMappingIndex(const Graph &g,
-                       debruijn_graph::config::pacbio_processor pb_config, alignment::BWAIndex::AlignmentMode mode)
+                       debruijn_graph::config::pacbio_processor pb_config, alignment::BWAIndex::AlignmentMode mode,
+                       const std::string &bwa_cache_dir = "")
             : g_(g),
+              distance_cache_(MAX_CACHED_DISTANCES),
               pb_config_(pb_config),
-              bwa_mapper_(g, mode, pb_config.bwa_length_cutoff) {
+              bwa_mapper_(g, mode, pb_config.bwa_length_cutoff, bwa_cache_dir) {
         DEBUG("PB Mapping Index construction started");
         DEBUG("Index constructed");
         read_count_ = 0;
     }
 
+    ~PacBioMappingIndex() {
+        size_t hits = distance_cache_.hits(), lookups = hits + distance_cache_.misses();
+        if (lookups)
+            INFO("Distance cache: " << lookups << " lookups, " << (100.0 * double(hits) / double(lookups)) << "% hits");
+    }
+
     bool similar_in_graph(const MappingInstance &a, const MappingInstance &b,
                           int shift = 0) const {
         if (b.read_position + shift < a.read_position) {
@@ -459,37 +470,20 @@ public:
         return std::make_pair(path_min_len, path_max_len);
     }
 
+    typename DistanceCache<VertexId>::Distances CountDistances(VertexId start_v) const {
+        omnigraph::DijkstraHelper<debruijn_graph::Graph>::BoundedDijkstra dijkstra(
+                omnigraph::DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_,
+                                                                                        pb_config_.max_path_in_dijkstra,
+                                                                                        pb_config_.max_vertex_in_dijkstra));
+        dijkstra.Run(start_v);
+        return dijkstra.GetDistances();
+    }
+
     size_t GetDistance(VertexId start_v, VertexId end_v,
                        bool update_cache = true) const {
-        size_t result = size_t(-1);
-        pair<VertexId, VertexId> vertex_pair = make_pair(start_v, end_v);
-        bool not_found;
-        auto distance_it = distance_cashed_.begin();
-        //FIXME should permit multiple readers
-#pragma omp critical(pac_index)
-        {
-            distance_it = distance_cashed_.find(vertex_pair);
-            not_found = (distance_it == distance_cashed_.end());
-        }
-        if (not_found) {
-            omnigraph::DijkstraHelper<debruijn_graph::Graph>::BoundedDijkstra dijkstra(
-                    omnigraph::DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_,
-                                                                                            pb_config_.max_path_in_dijkstra,
-                                                                                            pb_config_.max_vertex_in_dijkstra));
-            dijkstra.Run(start_v);
-            if (dijkstra.DistanceCounted(end_v)) {
-                result = dijkstra.GetDistance(end_v);
-            }
-            if (update_cache) {
-#pragma omp critical(pac_index)
-                distance_cashed_.insert({vertex_pair, result});
-            }
-        } else {
-            TRACE("taking from cashed");
-            result = distance_it->second;
-        }
-
-        return result;
+        return distance_cache_.Get(start_v, end_v,
+                                   [this](VertexId v) { return CountDistances(v); },
+                                   update_cache);
     }
 
     bool IsConsistent(const KmerCluster<Graph> &a,
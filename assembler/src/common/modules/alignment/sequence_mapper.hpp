@@ -50,6 +50,15 @@ public:
     virtual MappingPath<EdgeId> MapSequence(const Sequence &sequence) const = 0;
 
     virtual MappingPath<EdgeId> MapRead(const io::SingleRead &read) const = 0;
+
+    // Mappers with per-call setup costs might process the whole batch at once
+    virtual std::vector<MappingPath<EdgeId>> MapSequences(const std::vector<Sequence> &sequences) const {
+        std::vector<MappingPath<EdgeId>> res;
+        res.reserve(sequences.size());
+        for (const auto &s : sequences)
+            res.push_back(MapSequence(s));
+        return res;
+    }
 };
 
 template<class Graph>
@@ -286,14 +295,20 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
   typedef typename Graph::EdgeId EdgeId;
   typedef typename Graph::VertexId VertexId;
   typedef typename Index::KMer Kmer;
+  typedef typename Index::KeyWithHash KeyWithHash;
   typedef KmerMapper<Graph> KmerSubs;
   const KmerSubs& kmer_mapper_;
   size_t k_;
   bool optimization_on_;
 
-  bool FindKmer(const Kmer &kmer, size_t kmer_pos, std::vector<EdgeId> &passed,
+  // K-mers following a missed one are most likely looked up as well (e.g. around
+  // sequencing errors), so this many of them are hashed and prefetched in advance
+  static const size_t LOOKAHEAD = 8;
+
+  template<class Key>
+  bool FindKmer(const Key &key, size_t kmer_pos, std::vector<EdgeId> &passed,
                 RangeMappings& range_mappings) const {
-    std::pair<EdgeId, size_t> position = index_.get(kmer);
+    std::pair<EdgeId, size_t> position = index_.get(key);
     if (position.second == -1u)
         return false;
     
@@ -344,7 +359,8 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
   }
 
   bool ProcessKmer(const Kmer &kmer, size_t kmer_pos, std::vector<EdgeId> &passed_edges,
-                   RangeMappings& range_mapping, bool try_thread) const {
+                   RangeMappings& range_mapping, bool try_thread,
+                   const KeyWithHash *prefetched = nullptr) const {
     if (try_thread) {
         if (!TryThread(kmer, kmer_pos, passed_edges, range_mapping)) {
             FindKmer(kmer_mapper_.Substitute(kmer), kmer_pos, passed_edges, range_mapping);
@@ -359,9 +375,25 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
         return false;
     }
 
+    if (prefetched)
+        return FindKmer(*prefetched, kmer_pos, passed_edges, range_mapping);
     return FindKmer(kmer, kmer_pos, passed_edges, range_mapping);
   }
 
+  void Prefetch(const Sequence &sequence, Kmer kmer, size_t kmer_pos, size_t kmers_count,
+                std::vector<KeyWithHash> &ahead) const {
+    ahead.clear();
+    for (size_t i = kmer_pos + 1; i < std::min(kmers_count, kmer_pos + 1 + LOOKAHEAD); ++i) {
+      kmer <<= sequence[i + k_ - 1];
+      ahead.push_back(index_.ConstructKWH(kmer));
+      index_.prefetch_idx(ahead.back());
+    }
+
+    // The index lookups are now served from cache, so the values can be prefetched
+    for (const auto &kwh : ahead)
+      index_.prefetch(kwh);
+  }
+
  public:
   BasicSequenceMapper(const Graph& g,
                             const Index& index,
@@ -379,14 +411,29 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
       return MappingPath<EdgeId>();
     }
 
+    size_t kmers_count = sequence.size() - k_ + 1;
     Kmer kmer = sequence.start<Kmer>(k_);
     bool try_thread = false;
-    try_thread = ProcessKmer(kmer, 0, passed_edges,
-                             range_mapping, try_thread);
-    for (size_t i = k_; i < sequence.size(); ++i) {
-      kmer <<= sequence[i];
-      try_thread = ProcessKmer(kmer, i - k_ + 1, passed_edges,
-                               range_mapping, try_thread);
+    // Reused across the reads mapped by the thread
+    static thread_local std::vector<KeyWithHash> ahead;
+    ahead.clear();
+    size_t ahead_pos = 0;
+    for (size_t pos = 0; pos < kmers_count; ++pos) {
+      if (pos > 0)
+        kmer <<= sequence[pos + k_ - 1];
+
+      const KeyWithHash *prefetched = nullptr;
+      if (pos >= ahead_pos && pos < ahead_pos + ahead.size())
+        prefetched = &ahead[pos - ahead_pos];
+
+      bool lookup = !try_thread;
+      try_thread = ProcessKmer(kmer, pos, passed_edges,
+                               range_mapping, try_thread, prefetched);
+
+      if (lookup && !try_thread && pos + 1 >= ahead_pos + ahead.size()) {
+        Prefetch(sequence, kmer, pos, kmers_count, ahead);
+        ahead_pos = pos + 1;
+      }
     }
 
     return MappingPath<EdgeId>(passed_edges, range_mapping);
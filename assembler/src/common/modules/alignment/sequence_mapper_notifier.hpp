@@ -9,6 +9,7 @@
 #define SEQUENCE_MAPPER_NOTIFIER_HPP_
 
 #include "sequence_mapper.hpp"
+#include "mapping_path_cache.hpp"
 #include "io/reads/paired_read.hpp"
 #include "io/reads/read_stream_vector.hpp"
 #include "pipeline/graph_pack.hpp"
@@ -39,13 +40,25 @@ public:
 
 class SequenceMapperNotifier {
     static constexpr size_t BUFFER_SIZE = 200000;
+    static constexpr size_t MIN_FLUSH_SIZE = 10000;
+    // Free memory is re-sampled only once per this many reads of a thread
+    static constexpr size_t MEMORY_CHECK_PERIOD = 1024;
+    // Reads of a stream are mapped in batches of this size
+    static constexpr size_t MAPPING_BATCH_SIZE = 1024;
 public:
     typedef SequenceMapper<conj_graph_pack::graph_t> SequenceMapperT;
+    typedef MappingPathCache<conj_graph_pack::graph_t> MappingPathCacheT;
 
     typedef std::vector<SequenceMapperListener*> ListenersContainer;
 
     SequenceMapperNotifier(const conj_graph_pack& gp, size_t lib_count)
-            : gp_(gp), listeners_(lib_count) { }
+            : gp_(gp), listeners_(lib_count), cache_(nullptr) { }
+
+    // Paths are recorded to the cache if it is empty and replayed from it otherwise.
+    // The same cache should be used only with the same streams of a single library.
+    void SetMappingPathCache(MappingPathCacheT &cache) {
+        cache_ = &cache;
+    }
 
     void Subscribe(size_t lib_index, SequenceMapperListener* listener) {
         VERIFY(lib_index < listeners_.size());
@@ -58,40 +71,69 @@ public:
         if (threads_count == 0)
             threads_count = streams.size();
 
+        bool replay = cache_ && cache_->ready();
+        if (replay) {
+            VERIFY_MSG(cache_->streams() == streams.size(), "Mapping path cache was recorded for other streams");
+            INFO("Using cached mapping paths");
+        } else if (cache_) {
+            cache_->Reset(streams.size());
+        }
+
         streams.reset();
         NotifyStartProcessLibrary(lib_index, threads_count);
         size_t counter = 0, n = 15;
-        size_t fmem = utils::get_free_memory();
+        utils::MemoryPressureMonitor memory_pressure;
 
         #pragma omp parallel for num_threads(threads_count) shared(counter)
         for (size_t i = 0; i < streams.size(); ++i) {
             size_t size = 0;
             ReadType r;
+            std::vector<ReadType> batch;
+            batch.reserve(MAPPING_BATCH_SIZE);
             auto& stream = streams[i];
+            StreamMapper stream_mapper(mapper);
+            if (replay)
+                stream_mapper.Replay(cache_->reader(i));
+            else if (cache_)
+                stream_mapper.Record(cache_->writer(i));
+
             while (!stream.eof()) {
-                if (size == BUFFER_SIZE || 
-                    // Stop filling buffer if the amount of available is smaller
-                    // than half of free memory.
-                    (10 * utils::get_free_memory() / 4 < fmem && size > 10000)) {
-                    #pragma omp critical
-                    {
-                        counter += size;
-                        if (counter >> n) {
-                            INFO("Processed " << counter << " reads");
-                            n += 1;
+                batch.clear();
+                while (batch.size() < MAPPING_BATCH_SIZE && !stream.eof()) {
+                    stream >> r;
+                    batch.push_back(r);
+                }
+                std::vector<MappingPath<EdgeId>> paths = MapReads(batch, stream_mapper);
+
+                const MappingPath<EdgeId>* read_paths = paths.data();
+                for (const ReadType& read : batch) {
+                    if (size == BUFFER_SIZE ||
+                        // Stop filling buffer if the amount of available memory is smaller
+                        // than 40% of the initially free one.
+                        (size >= MIN_FLUSH_SIZE && size % MEMORY_CHECK_PERIOD == 0 &&
+                         memory_pressure.high())) {
+                        #pragma omp critical
+                        {
+                            counter += size;
+                            if (counter >> n) {
+                                INFO("Processed " << counter << " reads");
+                                n += 1;
+                            }
+                            size = 0;
+                            NotifyMergeBuffer(lib_index, i);
                         }
-                        size = 0;
-                        NotifyMergeBuffer(lib_index, i);
                     }
+                    ++size;
+                    read_paths = NotifyProcessRead(read, read_paths, lib_index, i);
                 }
-                stream >> r;
-                ++size;
-                NotifyProcessRead(r, mapper, lib_index, i);
             }
             #pragma omp atomic
             counter += size;
         }
 
+        if (cache_ && !replay)
+            cache_->Finish();
+
         for (size_t i = 0; i < threads_count; ++i)
             NotifyMergeBuffer(lib_index, i);
 
@@ -100,8 +142,97 @@ public:
     }
 
 private:
+    // Maps reads of a single stream, recording or replaying their paths
+    class StreamMapper {
+      public:
+        explicit StreamMapper(const SequenceMapperT& mapper)
+                : mapper_(mapper) {}
+
+        void Record(MappingPathCacheT::Writer writer) {
+            writer_.reset(new MappingPathCacheT::Writer(std::move(writer)));
+        }
+
+        void Replay(MappingPathCacheT::Reader reader) {
+            reader_.reset(new MappingPathCacheT::Reader(std::move(reader)));
+        }
+
+        MappingPath<EdgeId> MapRead(const io::SingleRead& r) {
+            if (reader_)
+                return reader_->Read();
+            return Recorded(mapper_.MapRead(r));
+        }
+
+        std::vector<MappingPath<EdgeId>> MapSequences(const std::vector<Sequence>& sequences) {
+            std::vector<MappingPath<EdgeId>> paths;
+            if (reader_) {
+                paths.reserve(sequences.size());
+                for (size_t i = 0; i < sequences.size(); ++i)
+                    paths.push_back(reader_->Read());
+                return paths;
+            }
+
+            paths = mapper_.MapSequences(sequences);
+            if (writer_) {
+                for (const auto& path : paths)
+                    writer_->Write(path);
+            }
+            return paths;
+        }
+
+      private:
+        MappingPath<EdgeId> Recorded(MappingPath<EdgeId> path) {
+            if (writer_)
+                writer_->Write(path);
+            return path;
+        }
+
+        const SequenceMapperT& mapper_;
+        std::unique_ptr<MappingPathCacheT::Writer> writer_;
+        std::unique_ptr<MappingPathCacheT::Reader> reader_;
+    };
+
+    // Returns mapping paths of all reads of the batch in order, one per every single read
+    std::vector<MappingPath<EdgeId>> MapReads(const std::vector<io::PairedReadSeq>& batch, StreamMapper& mapper) const {
+        std::vector<Sequence> sequences;
+        sequences.reserve(2 * batch.size());
+        for (const auto& r : batch) {
+            sequences.push_back(r.first().sequence());
+            sequences.push_back(r.second().sequence());
+        }
+        return mapper.MapSequences(sequences);
+    }
+
+    std::vector<MappingPath<EdgeId>> MapReads(const std::vector<io::SingleReadSeq>& batch, StreamMapper& mapper) const {
+        std::vector<Sequence> sequences;
+        sequences.reserve(batch.size());
+        for (const auto& r : batch)
+            sequences.push_back(r.sequence());
+        return mapper.MapSequences(sequences);
+    }
+
+    // Reads with ambiguous nucleotides are split by MapRead, so they are mapped one by one
+    std::vector<MappingPath<EdgeId>> MapReads(const std::vector<io::PairedRead>& batch, StreamMapper& mapper) const {
+        std::vector<MappingPath<EdgeId>> paths;
+        paths.reserve(2 * batch.size());
+        for (const auto& r : batch) {
+            paths.push_back(mapper.MapRead(r.first()));
+            paths.push_back(mapper.MapRead(r.second()));
+        }
+        return paths;
+    }
+
+    std::vector<MappingPath<EdgeId>> MapReads(const std::vector<io::SingleRead>& batch, StreamMapper& mapper) const {
+        std::vector<MappingPath<EdgeId>> paths;
+        paths.reserve(batch.size());
+        for (const auto& r : batch)
+            paths.push_back(mapper.MapRead(r));
+        return paths;
+    }
+
+    // Notifies about the read given its paths and returns the paths of the next read
     template<class ReadType>
-    void NotifyProcessRead(const ReadType& r, const SequenceMapperT& mapper, size_t ilib, size_t ithread) const;
+    const MappingPath<EdgeId>* NotifyProcessRead(const ReadType& r, const MappingPath<EdgeId>* paths,
+                                                 size_t ilib, size_t ithread) const;
 
     void NotifyStartProcessLibrary(size_t ilib, size_t thread_count) const {
         for (const auto& listener : listeners_[ilib])
@@ -120,58 +251,57 @@ private:
     const conj_graph_pack& gp_;
 
     std::vector<std::vector<SequenceMapperListener*> > listeners_;  //first vector's size = count libs
+    MappingPathCacheT* cache_;
 };
 
 template<>
-inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r,
-                                                      const SequenceMapperT& mapper,
-                                                      size_t ilib,
-                                                      size_t ithread) const {
-
-    const Sequence& read1 = r.first().sequence();
-    const Sequence& read2 = r.second().sequence();
-    MappingPath<EdgeId> path1 = mapper.MapSequence(read1);
-    MappingPath<EdgeId> path2 = mapper.MapSequence(read2);
+inline const MappingPath<EdgeId>* SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r,
+                                                                           const MappingPath<EdgeId>* paths,
+                                                                           size_t ilib,
+                                                                           size_t ithread) const {
+    const MappingPath<EdgeId>& path1 = paths[0];
+    const MappingPath<EdgeId>& path2 = paths[1];
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
         listener->ProcessSingleRead(ithread, r.second(), path2);
     }
+    return paths + 2;
 }
 
 template<>
-inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
-                                                      const SequenceMapperT& mapper,
-                                                      size_t ilib,
-                                                      size_t ithread) const {
-    MappingPath<EdgeId> path1 = mapper.MapRead(r.first());
-    MappingPath<EdgeId> path2 = mapper.MapRead(r.second());
+inline const MappingPath<EdgeId>* SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
+                                                                           const MappingPath<EdgeId>* paths,
+                                                                           size_t ilib,
+                                                                           size_t ithread) const {
+    const MappingPath<EdgeId>& path1 = paths[0];
+    const MappingPath<EdgeId>& path2 = paths[1];
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
         listener->ProcessSingleRead(ithread, r.second(), path2);
     }
+    return paths + 2;
 }
 
 template<>
-inline void SequenceMapperNotifier::NotifyProcessRead(const io::SingleReadSeq& r,
-                                                      const SequenceMapperT& mapper,
-                                                      size_t ilib,
-                                                      size_t ithread) const {
-    const Sequence& read = r.sequence();
-    MappingPath<EdgeId> path = mapper.MapSequence(read);
+inline const MappingPath<EdgeId>* SequenceMapperNotifier::NotifyProcessRead(const io::SingleReadSeq& r,
+                                                                           const MappingPath<EdgeId>* paths,
+                                                                           size_t ilib,
+                                                                           size_t ithread) const {
     for (const auto& listener : listeners_[ilib])
-        listener->ProcessSingleRead(ithread, r, path);
+        listener->ProcessSingleRead(ithread, r, *paths);
+    return paths + 1;
 }
 
 template<>
-inline void SequenceMapperNotifier::NotifyProcessRead(const io::SingleRead& r,
-                                                      const SequenceMapperT& mapper,
-                                                      size_t ilib,
-                                                      size_t ithread) const {
-    MappingPath<EdgeId> path = mapper.MapRead(r);
+inline const MappingPath<EdgeId>* SequenceMapperNotifier::NotifyProcessRead(const io::SingleRead& r,
+                                                                           const MappingPath<EdgeId>* paths,
+                                                                           size_t ilib,
+                                                                           size_t ithread) const {
     for (const auto& listener : listeners_[ilib])
-        listener->ProcessSingleRead(ithread, r, path);
+        listener->ProcessSingleRead(ithread, r, *paths);
+    return paths + 1;
 }
 
 } /*debruijn_graph*/
@@ -19,6 +19,7 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <queue>
 #include "weight_counter.hpp"
 #include "pe_utils.hpp"
 
@@ -19,7 +19,9 @@
 #include "path_filter.hpp"
 #include "overlap_analysis.hpp"
 #include "assembly_graph/graph_support/scaff_supplementary.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include <cmath>
+#include <functional>
 
 namespace path_extend {
 
@@ -685,24 +687,68 @@ private:
     DECL_LOGGER("CompositeGapAnalyzer");
 };
 
+//Cycles found while growing a seed and the edges known cycles were looked up for
+struct CycleHistory {
+    vector<BidirectionalPath> cycles;
+    set<EdgeId> looked_up;
+};
+
 //Detects a cycle as a minsuffix > IS present earlier in the path. Overlap is allowed.
 class InsertSizeLoopDetector {
 protected:
     GraphCoverageMap visited_cycles_coverage_map_;
-    PathContainer path_storage_;
+    vector<std::unique_ptr<BidirectionalPath>> visited_cycles_;
+    //Not committed yet, see CompositeExtender
+    CycleHistory history_;
     size_t min_cycle_len_;
 
+    bool EndsWithCycle(const BidirectionalPath& path, const BidirectionalPath& cycle) const {
+        DEBUG("checking  cycle ");
+        int pos = path.FindLast(cycle);
+        if (pos == -1)
+            return false;
+
+        int start_cycle_pos = pos + (int) cycle.Size();
+        bool only_cycles_in_tail = true;
+        int last_cycle_pos = start_cycle_pos;
+        DEBUG("start_cycle pos "<< last_cycle_pos);
+        for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle.Size(); i += (int) cycle.Size()) {
+            if (!path.CompareFrom(i, cycle)) {
+                only_cycles_in_tail = false;
+                break;
+            } else {
+                last_cycle_pos = i + (int) cycle.Size();
+                DEBUG("last cycle pos changed " << last_cycle_pos);
+            }
+        }
+        DEBUG("last_cycle_pos " << last_cycle_pos);
+        only_cycles_in_tail = only_cycles_in_tail && cycle.CompareFrom(0, path.SubPath(last_cycle_pos));
+        if (only_cycles_in_tail) {
+// seems that most of this is useless, checking
+            VERIFY (last_cycle_pos == start_cycle_pos);
+            DEBUG("find cycle " << last_cycle_pos);
+            DEBUG("path");
+            path.PrintDEBUG();
+            DEBUG("last subpath");
+            path.SubPath(last_cycle_pos).PrintDEBUG();
+            DEBUG("cycle");
+            cycle.PrintDEBUG();
+            DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
+            VERIFY(last_cycle_pos <= (int)path.Size());
+            DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle.Size());
+            VERIFY(last_cycle_pos + (int)cycle.Size() >= (int)path.Size());
+
+            return true;
+        }
+        return false;
+    }
+
 public:
     InsertSizeLoopDetector(const Graph& g, size_t is):
-        visited_cycles_coverage_map_(g),
-        path_storage_(),
+        visited_cycles_coverage_map_(g, 0),
         min_cycle_len_(is) {
     }
 
-    ~InsertSizeLoopDetector() {
-        path_storage_.DeleteAllPaths();
-    }
-
     bool CheckCycledNonIS(const BidirectionalPath& path) const {
         if (path.Size() <= 2) {
             return false;
@@ -765,45 +811,14 @@ public:
     //seems that it is outofdate
     bool InExistingLoop(const BidirectionalPath& path) {
         DEBUG("Checking existing loops");
-        auto visited_cycles = visited_cycles_coverage_map_.GetEdgePaths(path.Back());
-        for (auto cycle : *visited_cycles) {
-            DEBUG("checking  cycle ");
-            int pos = path.FindLast(*cycle);
-            if (pos == -1)
-                continue;
-
-            int start_cycle_pos = pos + (int) cycle->Size();
-            bool only_cycles_in_tail = true;
-            int last_cycle_pos = start_cycle_pos;
-            DEBUG("start_cycle pos "<< last_cycle_pos);
-            for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle->Size(); i += (int) cycle->Size()) {
-                if (!path.CompareFrom(i, *cycle)) {
-                    only_cycles_in_tail = false;
-                    break;
-                } else {
-                    last_cycle_pos = i + (int) cycle->Size();
-                    DEBUG("last cycle pos changed " << last_cycle_pos);
-                }
-            }
-            DEBUG("last_cycle_pos " << last_cycle_pos);
-            only_cycles_in_tail = only_cycles_in_tail && cycle->CompareFrom(0, path.SubPath(last_cycle_pos));
-            if (only_cycles_in_tail) {
-// seems that most of this is useless, checking
-                VERIFY (last_cycle_pos == start_cycle_pos);
-                DEBUG("find cycle " << last_cycle_pos);
-                DEBUG("path");
-                path.PrintDEBUG();
-                DEBUG("last subpath");
-                path.SubPath(last_cycle_pos).PrintDEBUG();
-                DEBUG("cycle");
-                cycle->PrintDEBUG();
-                DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
-                VERIFY(last_cycle_pos <= (int)path.Size());
-                DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle->Size());
-                VERIFY(last_cycle_pos + (int)cycle->Size() >= (int)path.Size());
-
+        history_.looked_up.insert(path.Back());
+        for (auto cycle : *visited_cycles_coverage_map_.GetEdgePaths(path.Back())) {
+            if (EndsWithCycle(path, *cycle))
+                return true;
+        }
+        for (const auto &cycle : history_.cycles) {
+            if (cycle.Contains(path.Back()) && EndsWithCycle(path, cycle))
                 return true;
-            }
         }
         return false;
     }
@@ -813,12 +828,24 @@ public:
             DEBUG("Wrong position in IS cycle");
             return;
         }
-        BidirectionalPath * p = new BidirectionalPath(path.SubPath(pos));
-        BidirectionalPath * cp = new BidirectionalPath(p->Conjugate());
-        visited_cycles_coverage_map_.Subscribe(p);
-        visited_cycles_coverage_map_.Subscribe(cp);
+        history_.cycles.push_back(path.SubPath(pos));
+        history_.cycles.push_back(history_.cycles.back().Conjugate());
         DEBUG("add cycle");
-        p->PrintDEBUG();
+        history_.cycles[history_.cycles.size() - 2].PrintDEBUG();
+    }
+
+    //Returns the cycles found since the last call, they are not taken into account anymore
+    CycleHistory TakeHistory() {
+        CycleHistory history = std::move(history_);
+        history_ = CycleHistory();
+        return history;
+    }
+
+    void Commit(const CycleHistory &history) {
+        for (const auto &cycle : history.cycles) {
+            visited_cycles_.emplace_back(new BidirectionalPath(cycle));
+            visited_cycles_coverage_map_.Subscribe(visited_cycles_.back().get());
+        }
     }
 };
 
@@ -831,21 +858,45 @@ public:
 
     virtual bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage = nullptr) = 0;
 
+    //Cycles found while growing the seeds are kept for the following seeds. Seeds can be
+    //grown speculatively on copies of the extenders, so they are committed separately.
+    virtual CycleHistory TakeCycleHistory() {
+        return CycleHistory();
+    }
+
+    virtual void CommitCycleHistory(const CycleHistory &/*history*/) { }
+
 protected:
     const Graph &g_;
     DECL_LOGGER("PathExtender")
 };
 
+//Seeds are grown in windows. All seeds of a window are first grown speculatively in parallel,
+//each thread has its own copy of the extenders working with the state committed before the
+//window. Then the seeds are committed in order. A seed whose growth depended on the state
+//changed by an earlier seed of the window is grown again, so the result is the same as of
+//growing the seeds one by one.
 class CompositeExtender {
 public:
+    //Makes extenders working with the given coverage map and used unique edges
+    typedef std::function<vector<shared_ptr<PathExtender>>(const GraphCoverageMap&, UsedUniqueStorage&,
+                                                           bool /*verbose*/)> ExtendersFactory;
 
     CompositeExtender(const Graph &g, GraphCoverageMap& cov_map,
                       UsedUniqueStorage &unique,
-                      const vector<shared_ptr<PathExtender>> &pes)
+                      const ExtendersFactory &make_extenders,
+                      size_t threads = 1)
             : g_(g),
               cover_map_(cov_map),
-              used_storage_(unique),
-              extenders_(pes) {}
+              used_storage_(unique) {
+        VERIFY(threads > 0);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back(new Worker(g, unique));
+            workers_.back()->extenders = make_extenders(workers_.back()->cover_map,
+                                                        workers_.back()->used_storage,
+                                                        /*verbose*/ i == 0);
+        }
+    }
 
     void GrowAll(PathContainer& paths, PathContainer& result) {
         result.clear();
@@ -853,74 +904,180 @@ public:
         result.FilterEmptyPaths();
     }
 
-    void GrowPath(BidirectionalPath& path, PathContainer* paths_storage) {
-        while (MakeGrowStep(path, paths_storage)) { }
-    }
+private:
+    static const size_t SEEDS_PER_THREAD = 4;
 
+    struct Worker {
+        //Paths of the seed being grown
+        GraphCoverageMap cover_map;
+        UsedUniqueStorage used_storage;
+        vector<shared_ptr<PathExtender>> extenders;
+
+        Worker(const Graph &g, const UsedUniqueStorage &committed)
+                : cover_map(g, 0),
+                  used_storage(&committed) { }
+    };
+
+    struct SeedGrowth {
+        //The grown seed and its conjugate, followed by the paths added by the extenders; empty if skipped
+        PathContainer paths;
+        set<EdgeId> used;
+        //Unique edges looked up in the committed storage
+        set<EdgeId> checked;
+        //Per extender
+        vector<CycleHistory> cycles;
+    };
 
-private:
     const Graph &g_;
     GraphCoverageMap &cover_map_;
     UsedUniqueStorage &used_storage_;
-    vector<shared_ptr<PathExtender>> extenders_;
+    vector<std::unique_ptr<Worker>> workers_;
 
-    bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage) {
+    bool MakeGrowStep(Worker &worker, BidirectionalPath& path, PathContainer* paths_storage) {
         DEBUG("make grow step composite extender");
 
+        const auto &extenders = worker.extenders;
         size_t current = 0;
-        while (current < extenders_.size()) {
-            DEBUG("step " << current << " of total " << extenders_.size());
-            if (extenders_[current]->MakeGrowStep(path, paths_storage)) {
+        while (current < extenders.size()) {
+            DEBUG("step " << current << " of total " << extenders.size());
+            if (extenders[current]->MakeGrowStep(path, paths_storage)) {
                 return true;
             }
            ++current;
         }
         return false;
     }
-    
-    void GrowAllPaths(PathContainer& paths, PathContainer& result) {
-        for (size_t i = 0; i < paths.size(); ++i) {
-            VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-            if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
-                INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-            }
-            //In 2015 modes do not use a seed already used in paths.
-            //FIXME what is the logic here?
-            if (used_storage_.UniqueCheckEnabled()) {
-                bool was_used = false;
-                for (size_t ind =0; ind < paths.Get(i)->Size(); ind++) {
-                    EdgeId eid = paths.Get(i)->At(ind);
-                    if (used_storage_.IsUsedAndUnique(eid)) {
-                        DEBUG("Used edge " << g_.int_id(eid));
-                        was_used = true;
-                        break;
-                    } else {
-                        used_storage_.insert(eid);
-                    }
-                }
-                if (was_used) {
-                    DEBUG("skipping already used seed");
-                    continue;
+
+    void GrowPath(Worker &worker, BidirectionalPath& path, PathContainer* paths_storage) {
+        while (MakeGrowStep(worker, path, paths_storage)) { }
+    }
+
+    SeedGrowth GrowSeed(const PathContainer& paths, size_t i, Worker &worker) {
+        SeedGrowth growth;
+        bool was_used = false;
+        //In 2015 modes do not use a seed already used in paths.
+        //FIXME what is the logic here?
+        if (worker.used_storage.UniqueCheckEnabled()) {
+            for (size_t ind =0; ind < paths.Get(i)->Size(); ind++) {
+                EdgeId eid = paths.Get(i)->At(ind);
+                if (worker.used_storage.IsUsedAndUnique(eid)) {
+                    DEBUG("Used edge " << g_.int_id(eid));
+                    was_used = true;
+                    break;
+                } else {
+                    worker.used_storage.insert(eid);
                 }
             }
+            if (was_used) {
+                DEBUG("skipping already used seed");
+            }
+        }
 
-            if (!cover_map_.IsCovered(*paths.Get(i))) {
-                AddPath(result, *paths.Get(i), cover_map_);
-                BidirectionalPath * path = new BidirectionalPath(*paths.Get(i));
-                BidirectionalPath * conjugatePath = new BidirectionalPath(*paths.GetConjugate(i));
-                SubscribeCoverageMap(path, cover_map_);
-                SubscribeCoverageMap(conjugatePath, cover_map_);
+        if (!was_used && !cover_map_.IsCovered(*paths.Get(i))) {
+            BidirectionalPath * path = new BidirectionalPath(*paths.Get(i));
+            BidirectionalPath * conjugatePath = new BidirectionalPath(*paths.GetConjugate(i));
+            SubscribeCoverageMap(path, worker.cover_map);
+            SubscribeCoverageMap(conjugatePath, worker.cover_map);
+            growth.paths.AddPair(path, conjugatePath);
+            size_t count_trying = 0;
+            size_t current_path_len = 0;
+            do {
+                current_path_len = path->Length();
+                count_trying++;
+                GrowPath(worker, *path, &growth.paths);
+                GrowPath(worker, *conjugatePath, &growth.paths);
+            } while (count_trying < 10 && (path->Length() != current_path_len));
+            worker.cover_map.Forget(path);
+            worker.cover_map.Forget(conjugatePath);
+        }
+
+        worker.used_storage.Take(growth.used, growth.checked);
+        for (const auto &extender : worker.extenders)
+            growth.cycles.push_back(extender->TakeCycleHistory());
+        return growth;
+    }
+
+    static bool Intersect(const set<EdgeId> &a, const set<EdgeId> &b) {
+        for (EdgeId e : a) {
+            if (b.count(e))
+                return true;
+        }
+        return false;
+    }
+
+    bool DependsOn(const PathContainer& paths, size_t i, const SeedGrowth &growth,
+                   const set<EdgeId> &used, const set<EdgeId> &cycled) const {
+        if (growth.paths.size() > 0 && cover_map_.IsCovered(*paths.Get(i)))
+            return true;
+        if (Intersect(growth.checked, used))
+            return true;
+        for (const auto &history : growth.cycles) {
+            if (Intersect(history.looked_up, cycled))
+                return true;
+        }
+        return false;
+    }
+
+    void Commit(const PathContainer& paths, size_t i, const SeedGrowth &growth, PathContainer& result) {
+        if (growth.paths.size() > 0) {
+            //Paths are created in the same order as by the sequential growth,
+            //since path sets are ordered by path ids
+            AddPath(result, *paths.Get(i), cover_map_);
+            for (size_t j = 0; j < growth.paths.size(); ++j) {
+                BidirectionalPath * path = new BidirectionalPath(*growth.paths.Get(j));
+                BidirectionalPath * conjugatePath = new BidirectionalPath(*growth.paths.GetConjugate(j));
+                //Paths added by the extenders are not followed by the coverage map
+                if (j == 0) {
+                    SubscribeCoverageMap(path, cover_map_);
+                    SubscribeCoverageMap(conjugatePath, cover_map_);
+                }
                 result.AddPair(path, conjugatePath);
-                size_t count_trying = 0;
-                size_t current_path_len = 0;
-                do {
-                    current_path_len = path->Length();
-                    count_trying++;
-                    GrowPath(*path, &result);
-                    GrowPath(*conjugatePath, &result);
-                } while (count_trying < 10 && (path->Length() != current_path_len));
-                DEBUG("result path " << path->GetId());
-                path->PrintDEBUG();
+            }
+            DEBUG("result path " << result.Get(result.size() - growth.paths.size())->GetId());
+            result.Get(result.size() - growth.paths.size())->PrintDEBUG();
+        }
+
+        used_storage_.Commit(growth.used);
+        for (const auto &worker : workers_) {
+            for (size_t j = 0; j < worker->extenders.size(); ++j)
+                worker->extenders[j]->CommitCycleHistory(growth.cycles[j]);
+        }
+    }
+
+    void GrowAllPaths(PathContainer& paths, PathContainer& result) {
+        size_t threads = workers_.size();
+        size_t window = threads == 1 ? 1 : threads * SEEDS_PER_THREAD;
+        for (size_t start = 0; start < paths.size(); start += window) {
+            size_t end = std::min(paths.size(), start + window);
+
+            vector<SeedGrowth> growths(end - start);
+            #pragma omp parallel for schedule(dynamic) num_threads(threads) if(threads > 1)
+            for (size_t i = start; i < end; ++i)
+                growths[i - start] = GrowSeed(paths, i, *workers_[omp_get_thread_num()]);
+
+            //Changed by the seeds of the window committed so far
+            set<EdgeId> used;
+            set<EdgeId> cycled;
+            for (size_t i = start; i < end; ++i) {
+                VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
+                if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
+                    INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
+                }
+
+                SeedGrowth regrown;
+                const SeedGrowth *growth = &growths[i - start];
+                if (DependsOn(paths, i, *growth, used, cycled)) {
+                    DEBUG("Growing seed " << i << " again");
+                    regrown = GrowSeed(paths, i, *workers_.front());
+                    growth = &regrown;
+                }
+                Commit(paths, i, *growth, result);
+
+                utils::insert_all(used, growth->used);
+                for (const auto &history : growth->cycles) {
+                    for (const auto &cycle : history.cycles)
+                        cycled.insert(cycle.begin(), cycle.end());
+                }
             }
         }
     }
@@ -962,6 +1119,14 @@ protected:
         return false;
     }
 
+    CycleHistory TakeCycleHistory() override {
+        return is_detector_.TakeHistory();
+    }
+
+    void CommitCycleHistory(const CycleHistory &history) override {
+        is_detector_.Commit(history);
+    }
+
     bool DetectCycleScaffolding(BidirectionalPath& path, EdgeId e) {
         BidirectionalPath temp_path(path);
         temp_path.PushBack(e);
@@ -88,7 +88,7 @@ class OverlapRemover {
         return overlap;
     }
 
-    void MarkStartOverlaps(const BidirectionalPath &path, bool end_start_only, bool retain_one_copy) {
+    set<size_t> FindStartOverlaps(const BidirectionalPath &path, bool end_start_only, bool retain_one_copy) const {
         set<size_t> overlap_poss;
         for (PathPtr candidate : helper_.FindCandidatePaths(path)) {
             size_t overlap = AnalyzeOverlaps(path, *candidate,
@@ -97,12 +97,43 @@ class OverlapRemover {
                 overlap_poss.insert(overlap);
             }
         }
+        return overlap_poss;
+    }
+
+    void MarkStartOverlaps(const BidirectionalPath &path, bool end_start_only, bool retain_one_copy) {
+        set<size_t> overlap_poss = FindStartOverlaps(path, end_start_only, retain_one_copy);
         if (!overlap_poss.empty()) {
             utils::insert_all(splits_[&path], overlap_poss);
         }
     }
 
+    //Without retaining one copy paths are analyzed independently of already marked splits
+    void ParallelMarkOverlaps(bool end_start_only) {
+        vector<PathPtr> to_check;
+        for (auto path_pair: paths_) {
+            if (path_pair.first->Size() == 0)
+                continue;
+            to_check.push_back(path_pair.first);
+            to_check.push_back(path_pair.second);
+        }
+
+        vector<set<size_t>> overlaps(to_check.size());
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < to_check.size(); ++i)
+            overlaps[i] = FindStartOverlaps(*to_check[i], end_start_only, /*retain one copy*/false);
+
+        for (size_t i = 0; i < to_check.size(); ++i) {
+            if (!overlaps[i].empty())
+                utils::insert_all(splits_[to_check[i]], overlaps[i]);
+        }
+    }
+
     void InnerMarkOverlaps(bool end_start_only, bool retain_one_copy) {
+        if (!retain_one_copy) {
+            ParallelMarkOverlaps(end_start_only);
+            return;
+        }
+
         for (auto path_pair: paths_) {
             //TODO think if this "optimization" is necessary
             if (path_pair.first->Size() == 0)
@@ -210,18 +241,20 @@ class PathDeduplicator {
     const bool equal_only_;
     const OverlapFindingHelper helper_;
 
-    bool IsRedundant(PathPtr path) const {
+    //Returns all paths the path is redundant with respect to
+    vector<PathPtr> FindCoveringPaths(PathPtr path) const {
         TRACE("Checking if path redundant " << path->GetId());
+        vector<PathPtr> answer;
         for (auto candidate : helper_.FindCandidatePaths(*path)) {
             TRACE("Considering candidate " << candidate->GetId());
 //                VERIFY(candidate != path && candidate != path->GetConjPath());
             if (candidate == path || candidate == path->GetConjPath())
                 continue;
             if (equal_only_ ? helper_.IsEqual(*path, *candidate) : helper_.IsSubpath(*path, *candidate)) {
-                return true;
+                answer.push_back(candidate);
             }
         }
-        return false;
+        return answer;
     }
 
 public:
@@ -238,9 +271,24 @@ public:
 
     //TODO use path container filtering?
     void Deduplicate() {
-        for (auto path_pair : paths_) {
-            auto path = path_pair.first;
-            if (IsRedundant(path)) {
+        vector<BidirectionalPath*> paths;
+        for (auto path_pair : paths_)
+            paths.push_back(path_pair.first);
+
+        //Covering paths are searched in parallel over the initial state. Clearing is
+        //order-dependent, so a path is then cleared only if some of its covering
+        //paths has survived so far, exactly as the sequential pass would do.
+        vector<vector<PathPtr>> covering(paths.size());
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < paths.size(); ++i)
+            covering[i] = FindCoveringPaths(paths[i]);
+
+        for (size_t i = 0; i < paths.size(); ++i) {
+            auto path = paths[i];
+            if (path->Empty())
+                continue;
+            if (std::any_of(covering[i].begin(), covering[i].end(),
+                            [](PathPtr p) { return !p->Empty(); })) {
                 TRACE("Clearing path " << path->str());
                 path->Clear();
             }
@@ -95,6 +95,11 @@ public:
         edge_coverage_.reserve(EdgeCount());
     }
 
+    //For a few paths, memory is not reserved for all the edges
+    GraphCoverageMap(const Graph& g, size_t expected_edges) : g_(g) {
+        edge_coverage_.reserve(expected_edges);
+    }
+
     GraphCoverageMap(const Graph& g, const PathContainer& paths, bool subscribe = false) :
             GraphCoverageMap(g) {
         AddPaths(paths, subscribe);
@@ -117,6 +122,21 @@ public:
         ProcessPath(path, true);
     }
 
+    //Drops all entries of the path, it must not be changed afterwards
+    void Forget(BidirectionalPath * path) {
+        for (size_t i = 0; i < path->Size(); ++i) {
+            auto iter = edge_coverage_.find(path->At(i));
+            VERIFY(iter != edge_coverage_.end());
+            auto entry = iter->second->find(path);
+            VERIFY(entry != iter->second->end());
+            iter->second->erase(entry);
+            if (iter->second->empty()) {
+                delete iter->second;
+                edge_coverage_.erase(iter);
+            }
+        }
+    }
+
     //Inherited from PathListener
     void FrontEdgeAdded(EdgeId e, BidirectionalPath * path, const Gap&) override {
         EdgeAdded(e, path);
@@ -51,6 +51,9 @@ class ExtendersGenerator {
 
     const PELaunchSupport &support_;
 
+    //Copies of the extenders are made for every thread, only one of them is reported
+    const bool verbose_;
+
 public:
     ExtendersGenerator(const config::dataset &dataset_info,
                        const PathExtendParamsContainer &params,
@@ -58,14 +61,16 @@ public:
                        const GraphCoverageMap &cover_map,
                        const UniqueData &unique_data,
                        UsedUniqueStorage &used_unique_storage,
-                       const PELaunchSupport& support) :
+                       const PELaunchSupport& support,
+                       bool verbose = true) :
         dataset_info_(dataset_info),
         params_(params),
         gp_(gp),
         cover_map_(cover_map),
         unique_data_(unique_data),
         used_unique_storage_(used_unique_storage),
-        support_(support) { }
+        support_(support),
+        verbose_(verbose) { }
 
     Extenders MakePBScaffoldingExtenders() const;
 
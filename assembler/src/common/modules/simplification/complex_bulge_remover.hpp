@@ -815,6 +815,30 @@ class ComponentProjector {
 
 public:
 
+    //Checks in advance that SplitComponent will not fail, the graph is not modified
+    static bool CanSplit(const Graph& g, const LocalizedComponent<Graph>& component) {
+        set<size_t> level_heights(component.avg_distances());
+        GraphComponent<Graph> gc = component.AsGraphComponent();
+        for (auto it = gc.e_begin(); it != gc.e_end(); ++it) {
+            size_t start_dist = component.avg_distance(g.EdgeStart(*it));
+            size_t end_dist = component.avg_distance(g.EdgeEnd(*it));
+            size_t offset = start_dist;
+            size_t length = g.length(*it);
+            for (auto split_it = level_heights.lower_bound(start_dist);
+                    split_it != level_heights.upper_bound(end_dist); ++split_it) {
+                size_t curr = *split_it;
+                if (curr == start_dist || curr == end_dist)
+                    continue;
+                size_t pos = curr - offset;
+                if (pos >= length)
+                    return false;
+                length -= pos;
+                offset = curr;
+            }
+        }
+        return true;
+    }
+
     bool ProjectComponent() {
         if (!SplitComponent()) {
             DEBUG("Component can't be split");
@@ -1046,6 +1070,10 @@ public:
         return comp_;
     }
 
+    const map<VertexId, Range>& dominated() const {
+        return dominated_;
+    }
+
 private:
     DECL_LOGGER("LocalizedComponentFinder");
 };
@@ -1085,127 +1113,160 @@ private:
     DECL_LOGGER("CBRCandidateFinder");
 };
 
+//Vertices of the component in the order of height (start vertex excluded)
+//and the edges of its skeleton tree
 template<class Graph>
-class ComplexBulgeRemover : public PersistentProcessingAlgorithm<Graph, typename Graph::VertexId> {
+struct ComplexBulge {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
-    typedef PersistentProcessingAlgorithm<Graph, VertexId> base;
+
+    vector<pair<VertexId, Range>> vertices;
+    set<EdgeId> tree_edges;
+    size_t candidate_cnt;
+};
+
+template<class Graph>
+class ComplexBulgeRemover : public RoundProcessingAlgorithm<Graph, typename Graph::VertexId,
+                                                            ComplexBulge<Graph>> {
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef RoundProcessingAlgorithm<Graph, VertexId, ComplexBulge<Graph>> base;
 
     size_t max_length_;
     size_t length_diff_;
     string pics_folder_;
 
-    bool ProcessComponent(LocalizedComponent<Graph>& component,
-            size_t candidate_cnt) {
-        DEBUG("Processing component");
-        ComponentColoring<Graph> coloring(component);
-        SkeletonTreeFinder<Graph> tree_finder(component, coloring);
-        DEBUG("Looking for a tree");
-        if (tree_finder.FindTree()) {
-            DEBUG("Tree found");
-            SkeletonTree<Graph> tree(component, tree_finder.GetTreeEdges());
-
-            if (!pics_folder_.empty()) {
-                PrintComponent(component, tree,
-                        pics_folder_ + "success/"
-                                + std::to_string(this->g().int_id(component.start_vertex()))
-                                + "_" + std::to_string(candidate_cnt) + ".dot");
-            }
+    bool ProjectComponent(LocalizedComponent<Graph>& component,
+                          const ComponentColoring<Graph>& coloring,
+                          const SkeletonTree<Graph>& tree,
+                          size_t candidate_cnt) {
+        if (!pics_folder_.empty()) {
+            PrintComponent(component, tree,
+                    pics_folder_ + "success/"
+                            + std::to_string(this->g().int_id(component.start_vertex()))
+                            + "_" + std::to_string(candidate_cnt) + ".dot");
+        }
 
-            ComponentProjector<Graph> projector(this->g(), component, coloring, tree);
-            if (!projector.ProjectComponent()) {
-                //todo think of stopping the whole process
-                DEBUG("Component can't be projected");
-                return false;
-            }
-            DEBUG("Successfully processed component candidate " << candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
-            return true;
-        } else {
-            DEBUG("Failed to find skeleton tree for candidate " << candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
-            if (!pics_folder_.empty()) {
-                //todo check if we rewrite all of the previous pics!
-                PrintComponent(component,
-                        pics_folder_ + "fail/"
-                                + std::to_string(this->g().int_id(component.start_vertex())) //+ "_" + std::to_string(candidate_cnt)
-                                + ".dot");
-            }
+        ComponentProjector<Graph> projector(this->g(), component, coloring, tree);
+        if (!projector.ProjectComponent()) {
+            //todo think of stopping the whole process
+            DEBUG("Component can't be projected");
             return false;
         }
+        DEBUG("Successfully processed component candidate " << candidate_cnt << " start_v " << this->g().str(component.start_vertex()));
+        return true;
+    }
+
+    //todo shrink this set if needed
+    set<VertexId> Neighbours(VertexId v) const {
+        set<VertexId> answer;
+        for (EdgeId e : this->g().IncidentEdges(v)) {
+            answer.insert(this->g().EdgeStart(e));
+            answer.insert(this->g().EdgeEnd(e));
+        }
+        return answer;
     }
 
-    bool InnerProcess(VertexId v, std::vector<VertexId>& vertices_to_post_process) {
+    void PostProcess(const std::vector<VertexId>& vertices_to_post_process) {
+        for (VertexId p_p : vertices_to_post_process) {
+            //Neighbours(p_p) includes p_p
+            for (VertexId n : Neighbours(p_p)) {
+                this->ReturnForConsideration(n);
+            }
+            this->g().CompressVertex(p_p);
+        }
+    }
+
+    //a bit of hacking:
+    //reverting changes resulting from potentially attempted, but failed split
+    void Revert(SmartSetIterator<Graph, VertexId>& added_vertices) {
+        Compressor<Graph> compressor(this->g());
+        for (; !added_vertices.IsEnd(); ++added_vertices) {
+            compressor.CompressVertex(*added_vertices);
+        }
+    }
+
+protected:
+    //Looks for the candidates in the same way as the original sequential
+    //processing, the skeleton tree of the first one that can be projected is stored
+    bool Analyze(VertexId v, ComplexBulge<Graph>& bulge,
+                 std::vector<VertexId>& footprint) const override {
+        const Graph& g = this->g();
         size_t candidate_cnt = 0;
-        LocalizedComponentFinder<Graph> comp_finder(this->g(), max_length_,
-                                                    length_diff_, v);
+        LocalizedComponentFinder<Graph> comp_finder(g, max_length_, length_diff_, v);
         while (comp_finder.ProceedFurther()) {
             candidate_cnt++;
-            DEBUG("Found component candidate " << candidate_cnt << " start_v " << this->g().str(v));
             LocalizedComponent<Graph> component = comp_finder.component();
-            if (ProcessComponent(component, candidate_cnt)) {
-                GraphComponent<Graph> gc = component.AsGraphComponent();
-                std::copy(gc.v_begin(), gc.v_end(), std::back_inserter(vertices_to_post_process));
-                return true;
+            ComponentColoring<Graph> coloring(component);
+            SkeletonTreeFinder<Graph> tree_finder(component, coloring);
+            if (!tree_finder.FindTree())
+                continue;
+            if (!ComponentProjector<Graph>::CanSplit(g, component)) {
+                DEBUG("Component candidate " << candidate_cnt << " start_v " << g.str(v) << " can't be split");
+                continue;
             }
+
+            DEBUG("Found component candidate " << candidate_cnt << " start_v " << g.str(v));
+            for (const auto& h_v : component.height_2_vertices()) {
+                if (h_v.second != v)
+                    bulge.vertices.push_back({h_v.second, component.distance_range(h_v.second)});
+            }
+            bulge.tree_edges = tree_finder.GetTreeEdges();
+            bulge.candidate_cnt = candidate_cnt;
+
+            //the search only looked at the dominated vertices and their neighbourhood
+            footprint.push_back(v);
+            for (const auto& d : comp_finder.dominated()) {
+                for (EdgeId e : g.IncidentEdges(d.first)) {
+                    footprint.push_back(g.EdgeStart(e));
+                    footprint.push_back(g.EdgeEnd(e));
+                }
+                footprint.push_back(d.first);
+            }
+            return true;
         }
         return false;
     }
 
-    //todo shrink this set if needed
-    set<VertexId> Neighbours(VertexId v) const {
-        set<VertexId> answer;
-        for (EdgeId e : this->g().IncidentEdges(v)) {
-            answer.insert(this->g().EdgeStart(e));
-            answer.insert(this->g().EdgeEnd(e));
+    bool Apply(VertexId v, const ComplexBulge<Graph>& bulge) override {
+        DEBUG("Processing vertex " << this->g().str(v));
+        LocalizedComponent<Graph> component(this->g(), v);
+        for (const auto& v_r : bulge.vertices)
+            component.AddVertex(v_r.first, v_r.second);
+        ComponentColoring<Graph> coloring(component);
+        SkeletonTree<Graph> tree(component, bulge.tree_edges);
+
+        //a bit of hacking (look further)
+        SmartSetIterator<Graph, VertexId> added_vertices(this->g(), true);
+        if (ProjectComponent(component, coloring, tree, bulge.candidate_cnt)) {
+            GraphComponent<Graph> gc = component.AsGraphComponent();
+            PostProcess(std::vector<VertexId>(gc.v_begin(), gc.v_end()));
+            return true;
         }
-        return answer;
+        //not expected, since the projection was checked during the analysis
+        //of the same neighbourhood, next round will analyse it again
+        Revert(added_vertices);
+        this->ReturnForConsideration(v);
+        return false;
     }
 
 public:
 
-    //track_changes=false leads to every iteration run from scratch
+    //candidates are searched in parallel, every iteration runs from scratch
     ComplexBulgeRemover(Graph& g, size_t max_length, size_t length_diff,
-                        size_t chunk_cnt, const string& pics_folder = "") :
-            base(g, std::make_shared<omnigraph::ParallelInterestingElementFinder<Graph, VertexId>>(
-                CandidateFinder<Graph>(g, max_length, length_diff), chunk_cnt), 
-                false, std::less<VertexId>(), /*track changes*/false),
-            max_length_(max_length), 
-            length_diff_(length_diff), 
+                        const string& pics_folder = "") :
+            base(g),
+            max_length_(max_length),
+            length_diff_(length_diff),
             pics_folder_(pics_folder) {
         if (!pics_folder_.empty()) {
 //            remove_dir(pics_folder_);
             make_dir(pics_folder_);
             make_dir(pics_folder_ + "success/");
-            make_dir(pics_folder_ + "fail/");
         }
 
     }
 
-    bool Process(VertexId v) override {
-        DEBUG("Processing vertex " << this->g().str(v));
-        vector<VertexId> vertices_to_post_process;
-        //a bit of hacking (look further)
-        SmartSetIterator<Graph, VertexId> added_vertices(this->g(), true);
-
-        if (InnerProcess(v, vertices_to_post_process)) {
-            for (VertexId p_p : vertices_to_post_process) {
-                //Neighbours(p_p) includes p_p
-                for (VertexId n : Neighbours(p_p)) {
-                    this->ReturnForConsideration(n);
-                }
-                this->g().CompressVertex(p_p);
-            }
-            return true;
-        } else {
-            //a bit of hacking:
-            //reverting changes resulting from potentially attempted, but failed split
-            Compressor<Graph> compressor(this->g());
-            for (; !added_vertices.IsEnd(); ++added_vertices) {
-                compressor.CompressVertex(*added_vertices);
-            }
-            return false;
-        }
-    }
-
 private:
     DECL_LOGGER("ComplexBulgeRemover");
 };
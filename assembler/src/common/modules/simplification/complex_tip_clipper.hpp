@@ -121,56 +121,70 @@ private:
 };
 
 template<class Graph>
-class ComplexTipClipper : public PersistentProcessingAlgorithm<Graph, typename Graph::VertexId> {
+class ComplexTipClipper : public RoundProcessingAlgorithm<Graph, typename Graph::VertexId,
+                                                          std::vector<typename Graph::EdgeId>> {
     typedef typename Graph::VertexId VertexId;
     typedef typename Graph::EdgeId EdgeId;
-    typedef PersistentProcessingAlgorithm<Graph, VertexId> base;
+    typedef RoundProcessingAlgorithm<Graph, VertexId, std::vector<EdgeId>> base;
     typedef typename ComponentRemover<Graph>::HandlerF HandlerF;
 
     string pics_folder_;
     ComplexTipFinder<Graph> finder_;
     ComponentRemover<Graph> component_remover_;
 
-public:
-    //track_changes=false leads to every iteration run from scratch
-    ComplexTipClipper(Graph& g, double relative_coverage,
-                      size_t max_edge_len, size_t max_path_len,
-                      size_t chunk_cnt,
-                      const string& pics_folder = "" ,
-                      HandlerF removal_handler = nullptr) :
-            base(g, nullptr, false, std::less<VertexId>(), /*track changes*/false),
-            pics_folder_(pics_folder),
-            finder_(g, relative_coverage, max_edge_len, max_path_len),
-            component_remover_(g, removal_handler) {
-        if (!pics_folder_.empty()) {
-            make_dir(pics_folder_);
-        }
-        this->interest_el_finder_ = std::make_shared<ParallelInterestingElementFinder<Graph, VertexId>>(
-                [&](VertexId v) {return !finder_(v).empty();}, chunk_cnt);
-    }
-
-    bool Process(VertexId v) override {
-        DEBUG("Processing vertex " << this->g().str(v));
+protected:
+    bool Analyze(VertexId v, std::vector<EdgeId> &edges,
+                 std::vector<VertexId> &footprint) const override {
         auto component = finder_(v);
         if (component.empty()) {
             DEBUG("Failed to detect complex tip starting with vertex " << this->g().str(v));
             return false;
         }
 
+        edges.assign(component.e_begin(), component.e_end());
+        //outward coverage depends on the edges incident to the component
+        footprint.push_back(v);
+        for (VertexId u : component.vertices()) {
+            for (EdgeId e : this->g().IncidentEdges(u)) {
+                footprint.push_back(this->g().EdgeStart(e));
+                footprint.push_back(this->g().EdgeEnd(e));
+            }
+        }
+        return true;
+    }
+
+    bool Apply(VertexId v, const std::vector<EdgeId> &edges) override {
+        DEBUG("Processing vertex " << this->g().str(v));
         if (!pics_folder_.empty()) {
-            visualization::visualization_utils::WriteComponentSinksSources(component,
-                                                      pics_folder_
-                                                      + std::to_string(this->g().int_id(v)) //+ "_" + std::to_string(candidate_cnt)
-                                                      + ".dot");
+            visualization::visualization_utils::WriteComponentSinksSources(
+                    GraphComponent<Graph>::FromEdges(this->g(), edges),
+                    pics_folder_
+                    + std::to_string(this->g().int_id(v)) //+ "_" + std::to_string(candidate_cnt)
+                    + ".dot");
         }
 
-        VERIFY(component.e_size() && component.v_size());
-        DEBUG("Detected tip component edge cnt: " << component.e_size());
-        component_remover_.DeleteComponent(component.e_begin(), component.e_end());
+        VERIFY(!edges.empty());
+        DEBUG("Detected tip component edge cnt: " << edges.size());
+        component_remover_.DeleteComponent(edges.begin(), edges.end());
         DEBUG("Complex tip removed");
         return true;
     }
 
+public:
+    //tips are searched in parallel, every iteration runs from scratch
+    ComplexTipClipper(Graph& g, double relative_coverage,
+                      size_t max_edge_len, size_t max_path_len,
+                      const string& pics_folder = "" ,
+                      HandlerF removal_handler = nullptr) :
+            base(g),
+            pics_folder_(pics_folder),
+            finder_(g, relative_coverage, max_edge_len, max_path_len),
+            component_remover_(g, removal_handler) {
+        if (!pics_folder_.empty()) {
+            make_dir(pics_folder_);
+        }
+    }
+
 private:
     DECL_LOGGER("ComplexTipClipper")
 };
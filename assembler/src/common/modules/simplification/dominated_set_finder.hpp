@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <queue>
+
 namespace omnigraph {
 template<class Graph>
 class DominatedSetFinder {
@@ -529,6 +529,8 @@ private:
 };
 
 //be careful unreliability_threshold_ is dependent on ec_threshold_!
+//Suspicious vertices are searched in parallel, the serial part only rechecks the candidates
+//and disconnects edges, so RoundProcessingAlgorithm would not gain much here
 template<class Graph>
 class HiddenECRemover: public PersistentProcessingAlgorithm<Graph, typename Graph::VertexId> {
     typedef typename Graph::EdgeId EdgeId;
@@ -631,6 +631,8 @@ private:
 } //namespace component_remover
 
 //currently works with conjugate graphs only (due to the assumption in the outer cycle)
+//Components are searched in parallel, but removed serially in the order of increasing coverage:
+//processing in RoundProcessingAlgorithm rounds would give up this order and change the result
 template<class Graph>
 class RelativeCoverageComponentRemover : public PersistentProcessingAlgorithm<Graph,
         typename Graph::EdgeId, CoverageComparator<Graph>> {
@@ -0,0 +1,604 @@
+//***************************************************************************
+//* Copyright (c) 2016 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "paired_info.hpp"
+
+#include <boost/iterator/iterator_facade.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace omnigraph {
+
+namespace de {
+
+/**
+ * @brief Read-only compact form of PairedIndex, for the time the index is not modified anymore.
+ * @detail All edges with paired info are remapped to dense indices of a sorted array. Neighbours
+ *         are stored in CSR arrays sorted by (edge1, edge2), so the neighbourhood of an edge lies in
+ *         consecutive memory. As in PairedIndex, a pair and its conjugate share the same histogram.
+ *         Histograms are packed into a single byte array: integral distances are delta- and
+ *         varint-encoded, integral weights and variances are varint-encoded, others are kept as floats.
+ *         Provides the same data access interface as PairedIndex, though histograms can only be
+ *         traversed forward.
+ * @param G graph type
+ * @param Traits Policy-like structure with associated types of inner and resulting points
+ */
+template<typename G, typename Traits>
+class FrozenPairedIndex {
+    typedef FrozenPairedIndex<G, Traits> self;
+
+    typedef typename Traits::Gapped InnerPoint;
+    typedef omnigraph::de::Histogram<InnerPoint> InnerHistogram;
+    typedef omnigraph::de::StrongWeakPtr<InnerHistogram> InnerHistPtr;
+
+public:
+    typedef G Graph;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef std::pair<EdgeId, EdgeId> EdgePair;
+    typedef typename Traits::Expanded Point;
+
+    typedef omnigraph::de::Histogram<Point> Histogram;
+
+private:
+    //---------------- Histogram encoding ----------------
+
+    //Each histogram is: varint size, flags, points
+    enum : uint8_t {
+        kIntegralDistances = 1,
+        kIntegralWeights = 2,
+        kIntegralVariances = 4,
+        kZeroVariances = 8
+    };
+
+    //Floats up to 2^24 are exactly representable as integers
+    static bool IsIntegral(float x) {
+        return x == std::floor(x) && std::fabs(x) < float(1 << 24);
+    }
+
+    static uint32_t ZigZag(int32_t v) {
+        return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+    }
+
+    static int32_t UnZigZag(uint32_t v) {
+        return int32_t(v >> 1) ^ -int32_t(v & 1);
+    }
+
+    static void PutVarint(std::vector<uint8_t> &buf, uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back(uint8_t(v | 0x80));
+            v >>= 7;
+        }
+        buf.push_back(uint8_t(v));
+    }
+
+    static uint64_t GetVarint(const uint8_t *&p) {
+        uint64_t v = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            uint8_t c = *p++;
+            v |= uint64_t(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return v;
+        }
+    }
+
+    static void PutField(std::vector<uint8_t> &buf, float x, bool integral) {
+        if (integral) {
+            PutVarint(buf, ZigZag(int32_t(x)));
+        } else {
+            uint8_t raw[sizeof(x)];
+            memcpy(raw, &x, sizeof(x));
+            buf.insert(buf.end(), raw, raw + sizeof(x));
+        }
+    }
+
+    static float GetField(const uint8_t *&p, bool integral) {
+        if (integral)
+            return float(UnZigZag(uint32_t(GetVarint(p))));
+        float x;
+        memcpy(&x, p, sizeof(x));
+        p += sizeof(x);
+        return x;
+    }
+
+    //Only clustered points have variance
+    static float Variance(const RawGapPoint &) { return 0; }
+    static float Variance(const GapPoint &p) { return p.var; }
+    static void SetVariance(RawGapPoint &, float) {}
+    static void SetVariance(GapPoint &p, float var) { p.var = var; }
+
+    /**
+     * @brief Sequential decoder of a packed histogram.
+     */
+    class HistReader {
+    public:
+        HistReader(const uint8_t *data = nullptr)
+                : data_(data), left_(0), flags_(0), d_(0) {
+            if (data_) {
+                left_ = GetVarint(data_);
+                flags_ = *data_++;
+            }
+        }
+
+        size_t left() const { return left_; }
+
+        InnerPoint Next() {
+            VERIFY(left_ > 0);
+            --left_;
+            InnerPoint p;
+            if (flags_ & kIntegralDistances) {
+                d_ += UnZigZag(uint32_t(GetVarint(data_)));
+                p.d = float(d_);
+            } else {
+                p.d = GetField(data_, false);
+            }
+            p.weight = GetField(data_, flags_ & kIntegralWeights);
+            if (!(flags_ & kZeroVariances))
+                SetVariance(p, GetField(data_, flags_ & kIntegralVariances));
+            return p;
+        }
+
+    private:
+        const uint8_t *data_;
+        size_t left_;
+        uint8_t flags_;
+        int32_t d_; //previous distance for delta decoding
+    };
+
+public:
+    //---------------- Data accessing types ----------------
+
+    /**
+     * @brief Proxy set representing a histogram of points between two edges.
+     * @detail Points are decoded on-the-fly and returned by value.
+     */
+    class HistProxy {
+    public:
+        /**
+         * @brief Forward iterator over a proxy set of points.
+         */
+        class Iterator: public boost::iterator_facade<Iterator, Point, boost::forward_traversal_tag, Point> {
+        public:
+            Iterator(HistReader reader, DEDistance offset)
+                    : reader_(reader), left_(reader.left()), offset_(offset) {
+                if (left_)
+                    point_ = reader_.Next();
+            }
+
+        private:
+            friend class boost::iterator_core_access;
+
+            Point dereference() const {
+                return Traits::Expand(point_, offset_);
+            }
+
+            void increment() {
+                if (--left_)
+                    point_ = reader_.Next();
+            }
+
+            bool equal(const Iterator &other) const {
+                return left_ == other.left_;
+            }
+
+            HistReader reader_;
+            size_t left_; //points left including the current one
+            InnerPoint point_;
+            DEDistance offset_; //edge length
+        };
+
+        /**
+         * @brief Returns a wrapper for a packed histogram, an empty one for nullptr.
+         */
+        HistProxy(const uint8_t *data = nullptr, DEDistance offset = 0)
+            : reader_(data), offset_(offset)
+        {}
+
+        Iterator begin() const {
+            return Iterator(reader_, offset_);
+        }
+
+        Iterator end() const {
+            return Iterator(HistReader(), offset_);
+        }
+
+        /**
+         * @brief Finds the point with the minimal distance.
+         */
+        Point min() const {
+            VERIFY(!empty());
+            return *begin();
+        }
+
+        /**
+         * @brief Finds the point with the maximal distance.
+         */
+        Point max() const {
+            VERIFY(!empty());
+            Point res;
+            for (const auto &p : *this)
+                res = p;
+            return res;
+        }
+
+        /**
+         * @brief Returns the copy of all points in a simple flat histogram.
+         */
+        Histogram Unwrap() const {
+            return Histogram(begin(), end());
+        }
+
+        size_t size() const {
+            return reader_.left();
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+    private:
+        HistReader reader_;
+        DEDistance offset_;
+    };
+
+    typedef typename HistProxy::Iterator HistIterator;
+
+    using EdgeHist = std::pair<EdgeId, HistProxy>;
+
+    /**
+     * @brief Proxy map representing neighbourhood of an edge, see PairedIndex::EdgeProxy.
+     */
+    class EdgeProxy {
+    public:
+        /**
+         * @brief Iterator over a proxy map.
+         * @detail For a half proxy, traverses only lesser pairs (i.e., (a,b) where (a,b)<=(b',a')) of edges.
+         */
+        class Iterator: public boost::iterator_facade<Iterator, EdgeHist, boost::forward_traversal_tag, EdgeHist> {
+            void Skip() { //For a half iterator, skip conjugate pairs
+                while (half_ && pos_ != stop_ && index_->GreaterPair(edge_, index_->Neighbour(pos_)))
+                    ++pos_;
+            }
+
+        public:
+            Iterator(const self &index, size_t pos, size_t stop, EdgeId edge, bool half)
+                    : index_(&index), pos_(pos), stop_(stop), edge_(edge), half_(half) {
+                Skip();
+            }
+
+        private:
+            friend class boost::iterator_core_access;
+
+            void increment() {
+                ++pos_;
+                Skip();
+            }
+
+            bool equal(const Iterator &other) const {
+                return pos_ == other.pos_;
+            }
+
+            EdgeHist dereference() const {
+                return std::make_pair(index_->Neighbour(pos_),
+                                      HistProxy(index_->HistData(pos_), index_->CalcOffset(edge_)));
+            }
+
+            const self *index_;
+            size_t pos_, stop_; //positions in the CSR arrays
+            EdgeId edge_;
+            bool half_;
+        };
+
+        EdgeProxy(const self &index, std::pair<size_t, size_t> row, EdgeId edge, bool half = false)
+            : index_(index), row_(row), edge_(edge), half_(half)
+        {}
+
+        Iterator begin() const {
+            return Iterator(index_, row_.first, row_.second, edge_, half_);
+        }
+
+        Iterator end() const {
+            return Iterator(index_, row_.second, row_.second, edge_, half_);
+        }
+
+        HistProxy operator[](EdgeId e2) const {
+            if (half_ && index_.GreaterPair(edge_, e2))
+                return HistProxy();
+            return index_.Get(edge_, e2);
+        }
+
+        bool empty() const {
+            return row_.first == row_.second;
+        }
+
+    private:
+        const self &index_;
+        std::pair<size_t, size_t> row_;
+        EdgeId edge_;
+        bool half_;
+    };
+
+    typedef typename EdgeProxy::Iterator EdgeIterator;
+
+    //---------------- Constructors and conversions ----------------
+
+    FrozenPairedIndex(const Graph &graph)
+            : graph_(graph), size_(0), offsets_(1, 0)
+    {}
+
+    /**
+     * @brief Packs the contents of a mutable index. The index itself is left intact,
+     *        clear it afterwards to actually release the memory.
+     */
+    template<template<typename, typename> class Container>
+    explicit FrozenPairedIndex(const PairedIndex<G, Traits, Container> &index)
+            : graph_(index.graph()), size_(index.size()) {
+        for (auto i = index.data_begin(); i != index.data_end(); ++i) {
+            edges_.push_back(i->first);
+            for (const auto &entry : i->second)
+                edges_.push_back(entry.first);
+        }
+        std::sort(edges_.begin(), edges_.end());
+        edges_.erase(std::unique(edges_.begin(), edges_.end()), edges_.end());
+        edges_.shrink_to_fit();
+        VERIFY(edges_.size() < std::numeric_limits<uint32_t>::max());
+
+        offsets_.assign(edges_.size() + 1, 0);
+        for (auto i = index.data_begin(); i != index.data_end(); ++i)
+            offsets_[EdgeIndex(i->first) + 1] = i->second.size();
+        std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+        neighbours_.resize(offsets_.back());
+        hists_.resize(offsets_.back());
+
+        //Pack the histograms of lesser pairs, in the order of the index
+        std::vector<std::pair<uint32_t, const InnerHistogram*>> row;
+        for (auto i = index.data_begin(); i != index.data_end(); ++i) {
+            EdgeId e1 = i->first;
+            row.clear();
+            for (const auto &entry : i->second)
+                row.emplace_back(uint32_t(EdgeIndex(entry.first)), entry.second.get());
+            std::sort(row.begin(), row.end());
+
+            size_t pos = offsets_[EdgeIndex(e1)];
+            for (const auto &entry : row) {
+                neighbours_[pos] = entry.first;
+                if (!GreaterPair(e1, edges_[entry.first]))
+                    hists_[pos] = Pack(*entry.second);
+                ++pos;
+            }
+        }
+        points_.shrink_to_fit();
+
+        //Greater pairs share the histogram with their conjugates
+        for (size_t i = 0; i < edges_.size(); ++i) {
+            EdgeId e1 = edges_[i];
+            for (size_t pos = offsets_[i]; pos < offsets_[i + 1]; ++pos) {
+                EdgeId e2 = Neighbour(pos);
+                if (!GreaterPair(e1, e2))
+                    continue;
+                EdgePair conj = ConjugatePair(e1, e2);
+                size_t conj_pos = Find(conj.first, conj.second);
+                VERIFY_MSG(conj_pos != neighbours_.size(), "Paired index is not conjugate-symmetrical");
+                hists_[pos] = hists_[conj_pos];
+            }
+        }
+    }
+
+    /**
+     * @brief Restores the contents into a mutable index, dropping its previous contents.
+     */
+    template<template<typename, typename> class Container>
+    void Unfreeze(PairedIndex<G, Traits, Container> &index) const {
+        index.clear();
+        for (size_t i = 0; i < edges_.size(); ++i) {
+            EdgeId e1 = edges_[i];
+            for (size_t pos = offsets_[i]; pos < offsets_[i + 1]; ++pos) {
+                EdgeId e2 = Neighbour(pos);
+                if (GreaterPair(e1, e2))
+                    continue;
+
+                auto hist = new InnerHistogram();
+                HistReader reader(HistData(pos));
+                while (reader.left())
+                    hist->insert(hist->end(), reader.Next());
+
+                index.storage_[e1].insert(std::make_pair(e2, InnerHistPtr(hist, /* owning */ true)));
+                if (e1 != graph_.conjugate(e2)) {
+                    EdgePair conj = ConjugatePair(e1, e2);
+                    index.storage_[conj.first].insert(std::make_pair(conj.second, InnerHistPtr(hist, /* owning */ false)));
+                }
+            }
+        }
+        index.size_ = size_;
+    }
+
+    //---------------- Data accessing methods ----------------
+
+    /**
+     * @brief Returns a whole proxy map to the neighbourhood of some edge.
+     */
+    EdgeProxy Get(EdgeId e) const {
+        return EdgeProxy(*this, Row(e), e);
+    }
+
+    /**
+     * @brief Returns a half proxy map to the neighbourhood of some edge.
+     */
+    EdgeProxy GetHalf(EdgeId e) const {
+        return EdgeProxy(*this, Row(e), e, true);
+    }
+
+    /**
+     * @brief Operator alias of Get(id).
+     */
+    EdgeProxy operator[](EdgeId e) const {
+        return Get(e);
+    }
+
+    /**
+     * @brief Returns a histogram proxy for all points between two edges.
+     */
+    HistProxy Get(EdgeId e1, EdgeId e2) const {
+        size_t pos = Find(e1, e2);
+        if (pos == neighbours_.size())
+            return HistProxy();
+        return HistProxy(HistData(pos), CalcOffset(e1));
+    }
+
+    /**
+     * @brief Operator alias of Get(e1, e2).
+     */
+    HistProxy operator[](EdgePair p) const {
+        return Get(p.first, p.second);
+    }
+
+    /**
+     * @brief Checks if an edge (or its conjugated twin) is consisted in the index.
+     */
+    bool contains(EdgeId edge) const {
+        auto row = Row(edge), conj_row = Row(graph_.conjugate(edge));
+        return row.first != row.second || conj_row.first != conj_row.second;
+    }
+
+    /**
+     * @brief Checks if there is a histogram for two points.
+     */
+    bool contains(EdgeId e1, EdgeId e2) const {
+        return Find(e1, e2) != neighbours_.size();
+    }
+
+    //---------------- Miscellaneous ----------------
+
+    const Graph &graph() const { return graph_; }
+
+    /**
+     * @brief Returns the physical index size (total count of all points), as in the source index.
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Returns the memory occupied by the index.
+     */
+    size_t bytes_used() const {
+        return edges_.capacity() * sizeof(EdgeId) + offsets_.capacity() * sizeof(size_t) +
+               neighbours_.capacity() * sizeof(uint32_t) + hists_.capacity() * sizeof(size_t) +
+               points_.capacity();
+    }
+
+    void clear() {
+        std::vector<EdgeId>().swap(edges_);
+        std::vector<size_t>(1, 0).swap(offsets_);
+        std::vector<uint32_t>().swap(neighbours_);
+        std::vector<size_t>().swap(hists_);
+        std::vector<uint8_t>().swap(points_);
+        size_ = 0;
+    }
+
+    EdgePair ConjugatePair(EdgeId e1, EdgeId e2) const {
+        return std::make_pair(graph_.conjugate(e2), graph_.conjugate(e1));
+    }
+
+private:
+    size_t Pack(const InnerHistogram &hist) {
+        uint8_t flags = kIntegralDistances | kIntegralWeights | kIntegralVariances | kZeroVariances;
+        for (const auto &p : hist) {
+            if (!IsIntegral(p.d))
+                flags &= uint8_t(~kIntegralDistances);
+            if (!IsIntegral(p.weight))
+                flags &= uint8_t(~kIntegralWeights);
+            if (!IsIntegral(Variance(p)))
+                flags &= uint8_t(~kIntegralVariances);
+            if (Variance(p) != 0)
+                flags &= uint8_t(~kZeroVariances);
+        }
+
+        size_t start = points_.size();
+        PutVarint(points_, hist.size());
+        points_.push_back(flags);
+        int32_t prev = 0;
+        for (const auto &p : hist) {
+            if (flags & kIntegralDistances) {
+                int32_t d = int32_t(p.d);
+                PutVarint(points_, ZigZag(d - prev));
+                prev = d;
+            } else {
+                PutField(points_, p.d, false);
+            }
+            PutField(points_, p.weight, flags & kIntegralWeights);
+            if (!(flags & kZeroVariances))
+                PutField(points_, Variance(p), flags & kIntegralVariances);
+        }
+        return start;
+    }
+
+    size_t EdgeIndex(EdgeId e) const {
+        auto it = std::lower_bound(edges_.begin(), edges_.end(), e);
+        if (it == edges_.end() || *it != e)
+            return edges_.size();
+        return size_t(it - edges_.begin());
+    }
+
+    //Range of positions in CSR arrays for the neighbours of an edge
+    std::pair<size_t, size_t> Row(EdgeId e) const {
+        size_t i = EdgeIndex(e);
+        if (i == edges_.size())
+            return { 0, 0 };
+        return { offsets_[i], offsets_[i + 1] };
+    }
+
+    //Returns neighbours_.size() when there is no such pair
+    size_t Find(EdgeId e1, EdgeId e2) const {
+        auto row = Row(e1);
+        auto it = std::lower_bound(neighbours_.begin() + row.first, neighbours_.begin() + row.second, e2,
+                                   [this](uint32_t i, EdgeId e) { return edges_[i] < e; });
+        if (it == neighbours_.begin() + row.second || edges_[*it] != e2)
+            return neighbours_.size();
+        return size_t(it - neighbours_.begin());
+    }
+
+    EdgeId Neighbour(size_t pos) const {
+        return edges_[neighbours_[pos]];
+    }
+
+    const uint8_t *HistData(size_t pos) const {
+        return points_.data() + hists_[pos];
+    }
+
+    bool GreaterPair(EdgeId e1, EdgeId e2) const {
+        auto ep = std::make_pair(e1, e2);
+        return ep > ConjugatePair(e1, e2);
+    }
+
+    size_t CalcOffset(EdgeId e) const {
+        return graph_.length(e);
+    }
+
+    const Graph &graph_;
+    size_t size_;
+
+    std::vector<EdgeId> edges_;       //dense index -> edge, sorted
+    std::vector<size_t> offsets_;     //dense index -> start of its neighbours
+    std::vector<uint32_t> neighbours_; //dense indices of second edges
+    std::vector<size_t> hists_;       //offsets of packed histograms in points_
+    std::vector<uint8_t> points_;
+};
+
+//Aliases for common graphs
+template<typename Graph>
+using FrozenPairedInfoIndexT = FrozenPairedIndex<Graph, PointTraits>;
+
+template<typename Graph>
+using FrozenUnclusteredPairedInfoIndexT = FrozenPairedIndex<Graph, RawPointTraits>;
+
+}
+
+}
@@ -19,6 +19,9 @@ namespace omnigraph {
 
 namespace de {
 
+template<typename G, typename Traits>
+class FrozenPairedIndex;
+
 template<typename G, typename Traits, template<typename, typename> class Container>
 class PairedIndex : public PairedBuffer<G, Traits, Container> {
     typedef PairedIndex<G, Traits, Container> self;
@@ -30,6 +33,8 @@ class PairedIndex : public PairedBuffer<G, Traits, Container> {
 
     using typename base::EdgePair;
 
+    friend class FrozenPairedIndex<G, Traits>;
+
 public:
     using typename base::Graph;
     using typename base::EdgeId;
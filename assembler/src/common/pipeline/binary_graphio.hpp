@@ -0,0 +1,563 @@
+//***************************************************************************
+//* Copyright (c) 2015 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+// Binary graph pack checkpoints. The whole graph pack (topology, packed edge
+// sequences, coverages, paired indices, k-mer mapper) goes into a single
+// versioned .gpb container made of tagged sections. The container is written
+// with large sequential writes and read back from one read-only mapping.
+// Text saves from graphio.hpp stay available as an export format.
+
+#include "pipeline/graphio.hpp"
+#include "io/kmers/mmapped_reader.hpp"
+
+#include <streambuf>
+#include <istream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+namespace debruijn_graph {
+
+namespace graphio {
+
+namespace binary {
+
+static const uint64_t GPB_MAGIC = 0x3130425047534150ULL; // "PASGPB01"
+static const uint32_t GPB_VERSION = 1;
+
+enum SectionTag : uint32_t {
+    GRAPH = 1,
+    COVERAGE = 2,
+    FLANKING_COVERAGE = 3,
+    PAIRED_INDEX = 4,
+    KMER_MAPPER = 5,
+    POSITIONS = 6
+};
+
+enum PairedIndexKind : uint32_t {
+    UNCLUSTERED = 0,
+    CLUSTERED = 1,
+    SCAFFOLDING = 2
+};
+
+inline std::string CheckpointFileName(const std::string &file_name) {
+    return file_name + ".gpb";
+}
+
+template<class T>
+void WriteValue(std::ostream &out, const T &value) {
+    out.write((const char *) &value, sizeof(T));
+}
+
+template<class T>
+T ReadValue(std::istream &in) {
+    T value;
+    in.read((char *) &value, sizeof(T));
+    VERIFY_MSG(!in.fail(), "Truncated graph pack checkpoint");
+    return value;
+}
+
+inline bool Exhausted(std::istream &in) {
+    return in.peek() == std::char_traits<char>::eof();
+}
+
+// Read-only stream over a chunk of memory, no copying involved
+class MemoryStreamBuf : public std::streambuf {
+  public:
+    MemoryStreamBuf(const char *data, size_t size) {
+        char *p = const_cast<char *>(data);
+        setg(p, p, p + size);
+    }
+};
+
+class CheckpointWriter {
+    static const size_t BUFFER_SIZE = 16 * 1024 * 1024;
+
+  public:
+    CheckpointWriter(const std::string &file_name, unsigned k)
+            : file_name_(file_name), buffer_(BUFFER_SIZE), size_pos_(-1) {
+        // Buffer must be installed before the file is opened
+        out_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+        out_.open(file_name_, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        VERIFY_MSG(out_.is_open(), "Couldn't open file " << file_name_ << " on write");
+
+        WriteValue(out_, GPB_MAGIC);
+        WriteValue(out_, GPB_VERSION);
+        WriteValue(out_, uint32_t(k));
+    }
+
+    std::ostream &BeginSection(SectionTag tag) {
+        VERIFY(size_pos_ == std::streampos(-1));
+        WriteValue(out_, uint32_t(tag));
+        size_pos_ = out_.tellp();
+        WriteValue(out_, uint64_t(0));
+        return out_;
+    }
+
+    void EndSection() {
+        VERIFY(size_pos_ != std::streampos(-1));
+        std::streampos end = out_.tellp();
+        uint64_t size = uint64_t(end - size_pos_) - sizeof(uint64_t);
+        out_.seekp(size_pos_);
+        WriteValue(out_, size);
+        out_.seekp(end);
+        size_pos_ = -1;
+    }
+
+    ~CheckpointWriter() {
+        out_.close();
+        VERIFY_MSG(!out_.fail(), "Failed to write " << file_name_);
+    }
+
+  private:
+    std::string file_name_;
+    std::vector<char> buffer_;
+    std::ofstream out_;
+    std::streampos size_pos_;
+};
+
+class CheckpointReader {
+  public:
+    struct Section {
+        const char *data;
+        size_t size;
+    };
+
+    CheckpointReader(const std::string &file_name, unsigned k)
+            : file_(file_name, /*unlink*/false, /*blocksize*/-1ULL) {
+        const char *begin = (const char *) file_.data(), *end = begin + file_.size();
+        const size_t header_size = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+        VERIFY_MSG(file_.size() >= header_size, "Truncated graph pack checkpoint " << file_name);
+
+        MemoryStreamBuf buf(begin, header_size);
+        std::istream header(&buf);
+        VERIFY_MSG(ReadValue<uint64_t>(header) == GPB_MAGIC, file_name << " is not a graph pack checkpoint");
+        uint32_t version = ReadValue<uint32_t>(header);
+        VERIFY_MSG(version == GPB_VERSION, "Unsupported graph pack checkpoint version " << version);
+        VERIFY_MSG(ReadValue<uint32_t>(header) == k, "Cannot read graph pack checkpoint, different Ks");
+
+        const size_t section_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+        for (const char *pos = begin + header_size; pos != end; ) {
+            VERIFY_MSG(size_t(end - pos) >= section_header_size, "Truncated graph pack checkpoint " << file_name);
+            uint32_t tag;
+            uint64_t size;
+            memcpy(&tag, pos, sizeof(tag));
+            memcpy(&size, pos + sizeof(tag), sizeof(size));
+            pos += section_header_size;
+            VERIFY_MSG(size_t(end - pos) >= size, "Truncated graph pack checkpoint " << file_name);
+            sections_.insert({tag, Section{pos, size}});
+            pos += size;
+        }
+    }
+
+    std::vector<Section> sections(SectionTag tag) const {
+        std::vector<Section> res;
+        auto range = sections_.equal_range(tag);
+        for (auto it = range.first; it != range.second; ++it)
+            res.push_back(it->second);
+        return res;
+    }
+
+  private:
+    MMappedReader file_;
+    std::multimap<uint32_t, Section> sections_;
+};
+
+template<class Graph>
+class BinaryDataPrinter {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef typename Graph::VertexId VertexId;
+
+  public:
+    BinaryDataPrinter(const Graph &g, CheckpointWriter &writer)
+            : g_(g), writer_(writer) {}
+
+    void SaveGraph() {
+        std::ostream &out = writer_.BeginSection(GRAPH);
+        WriteValue(out, uint64_t(g_.GetGraphIdDistributor().GetMax()));
+
+        // Only one element of each conjugate pair is stored
+        uint64_t vertex_count = 0;
+        for (VertexId v : g_)
+            vertex_count += (v.int_id() <= g_.conjugate(v).int_id());
+        WriteValue(out, vertex_count);
+        for (VertexId v : g_) {
+            if (v.int_id() > g_.conjugate(v).int_id())
+                continue;
+            WriteValue(out, uint64_t(v.int_id()));
+            WriteValue(out, uint64_t(g_.conjugate(v).int_id()));
+        }
+
+        uint64_t edge_count = 0;
+        for (auto it = g_.ConstEdgeBegin(/*canonical_only*/true); !it.IsEnd(); ++it)
+            edge_count += 1;
+        WriteValue(out, edge_count);
+        for (auto it = g_.ConstEdgeBegin(/*canonical_only*/true); !it.IsEnd(); ++it) {
+            EdgeId e = *it;
+            WriteValue(out, uint64_t(e.int_id()));
+            WriteValue(out, uint64_t(g_.conjugate(e).int_id()));
+            WriteValue(out, uint64_t(g_.EdgeStart(e).int_id()));
+            WriteValue(out, uint64_t(g_.EdgeEnd(e).int_id()));
+            g_.EdgeNucls(e).BinWrite(out);
+        }
+        writer_.EndSection();
+    }
+
+    void SaveCoverage() {
+        std::ostream &out = writer_.BeginSection(COVERAGE);
+        for (auto it = g_.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+            WriteValue(out, uint64_t((*it).int_id()));
+            WriteValue(out, uint32_t(g_.coverage_index().RawCoverage(*it)));
+        }
+        writer_.EndSection();
+    }
+
+    void SaveFlankingCoverage(const FlankingCoverage<Graph> &flanking_cov) {
+        std::ostream &out = writer_.BeginSection(FLANKING_COVERAGE);
+        for (auto it = g_.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+            WriteValue(out, uint64_t((*it).int_id()));
+            WriteValue(out, uint32_t(flanking_cov.RawCoverage(*it)));
+        }
+        writer_.EndSection();
+    }
+
+    template<class Index>
+    void SavePaired(const Index &paired_index, PairedIndexKind kind, size_t lib) {
+        typedef typename Index::Point Point;
+        std::ostream &out = writer_.BeginSection(PAIRED_INDEX);
+        WriteValue(out, uint32_t(kind));
+        WriteValue(out, uint32_t(lib));
+        WriteValue(out, uint32_t(sizeof(Point)));
+
+        std::vector<Point> points;
+        for (auto it = g_.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+            EdgeId e1 = *it;
+            for (auto entry : paired_index.GetHalf(e1)) {
+                points.assign(entry.second.begin(), entry.second.end());
+                WriteValue(out, uint64_t(e1.int_id()));
+                WriteValue(out, uint64_t(entry.first.int_id()));
+                WriteValue(out, uint64_t(points.size()));
+                out.write((const char *) points.data(), points.size() * sizeof(Point));
+            }
+        }
+        writer_.EndSection();
+    }
+
+    template<class KmerMapper>
+    void SaveKmerMapper(const KmerMapper &mapper) {
+        mapper.BinWrite(writer_.BeginSection(KMER_MAPPER));
+        writer_.EndSection();
+    }
+
+    void SavePositions(const EdgesPositionHandler<Graph> &edge_pos) {
+        std::ostream &out = writer_.BeginSection(POSITIONS);
+        for (auto it = g_.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+            auto positions = edge_pos.GetEdgePositions(*it);
+            if (positions.empty())
+                continue;
+            WriteValue(out, uint64_t((*it).int_id()));
+            WriteValue(out, uint64_t(positions.size()));
+            for (const auto &pos : positions) {
+                WriteValue(out, uint64_t(pos.contigId.size()));
+                out.write(pos.contigId.data(), pos.contigId.size());
+                WriteValue(out, uint64_t(pos.mr.initial_range.start_pos));
+                WriteValue(out, uint64_t(pos.mr.initial_range.end_pos));
+                WriteValue(out, uint64_t(pos.mr.mapped_range.start_pos));
+                WriteValue(out, uint64_t(pos.mr.mapped_range.end_pos));
+            }
+        }
+        writer_.EndSection();
+    }
+
+  private:
+    const Graph &g_;
+    CheckpointWriter &writer_;
+};
+
+template<class Graph>
+class BinaryDataScanner {
+    typedef typename Graph::EdgeId EdgeId;
+    typedef typename Graph::VertexId VertexId;
+    typedef CheckpointReader::Section Section;
+
+    EdgeId edge(uint64_t id) const {
+        auto it = edges_.find(id);
+        VERIFY(it != edges_.end());
+        return it->second;
+    }
+
+  public:
+    BinaryDataScanner(Graph &g, const CheckpointReader &reader)
+            : g_(g), reader_(reader) {}
+
+    void LoadGraph() {
+        auto sections = reader_.sections(GRAPH);
+        VERIFY_MSG(sections.size() == 1, "Graph pack checkpoint should contain exactly one graph");
+        MemoryStreamBuf buf(sections[0].data, sections[0].size);
+        std::istream in(&buf);
+
+        size_t max_id = ReadValue<uint64_t>(in);
+        auto id_storage = g_.GetGraphIdDistributor().Reserve(max_id, /*force_zero_shift*/true);
+        size_t vertex_count = ReadValue<uint64_t>(in);
+        std::unordered_map<size_t, VertexId> vertices(2 * vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            size_t ids[2];
+            ids[0] = ReadValue<uint64_t>(in);
+            ids[1] = ReadValue<uint64_t>(in);
+            VERIFY(ids[0] < max_id && ids[1] < max_id);
+            auto id_distributor = id_storage.GetSegmentIdDistributor(ids, ids + 2);
+            VertexId v = g_.AddVertex(typename Graph::VertexData(), id_distributor);
+            vertices[ids[0]] = v;
+            vertices[ids[1]] = g_.conjugate(v);
+        }
+
+        size_t edge_count = ReadValue<uint64_t>(in);
+        edges_.clear();
+        edges_.reserve(2 * edge_count);
+        Sequence nucls;
+        for (size_t i = 0; i < edge_count; ++i) {
+            size_t ids[2];
+            ids[0] = ReadValue<uint64_t>(in);
+            ids[1] = ReadValue<uint64_t>(in);
+            size_t start = ReadValue<uint64_t>(in), end = ReadValue<uint64_t>(in);
+            VERIFY(ids[0] < max_id && ids[1] < max_id);
+            VERIFY(vertices.count(start) && vertices.count(end));
+            VERIFY_MSG(nucls.BinRead(in), "Truncated graph pack checkpoint");
+            auto id_distributor = id_storage.GetSegmentIdDistributor(ids, ids + 2);
+            EdgeId e = g_.AddEdge(vertices[start], vertices[end], nucls, id_distributor);
+            edges_[ids[0]] = e;
+            edges_[ids[1]] = g_.conjugate(e);
+        }
+        INFO("Loaded graph with " << 2 * vertex_count << " vertices and " << 2 * edge_count << " edges");
+    }
+
+    void LoadCoverage() {
+        for (const Section &section : reader_.sections(COVERAGE)) {
+            MemoryStreamBuf buf(section.data, section.size);
+            std::istream in(&buf);
+            while (!Exhausted(in)) {
+                EdgeId e = edge(ReadValue<uint64_t>(in));
+                g_.coverage_index().SetRawCoverage(e, ReadValue<uint32_t>(in));
+            }
+        }
+    }
+
+    bool LoadFlankingCoverage(FlankingCoverage<Graph> &flanking_cov) {
+        auto sections = reader_.sections(FLANKING_COVERAGE);
+        if (sections.empty()) {
+            INFO("Flanking coverage saves are absent");
+            return false;
+        }
+        for (const Section &section : sections) {
+            MemoryStreamBuf buf(section.data, section.size);
+            std::istream in(&buf);
+            while (!Exhausted(in)) {
+                EdgeId e = edge(ReadValue<uint64_t>(in));
+                flanking_cov.SetRawCoverage(e, ReadValue<uint32_t>(in));
+            }
+        }
+        return true;
+    }
+
+    template<class Index>
+    void LoadPaired(Index &paired_index, PairedIndexKind kind, size_t lib,
+                    bool force_exists = true) {
+        typedef typename Index::Point Point;
+        for (const Section &section : reader_.sections(PAIRED_INDEX)) {
+            MemoryStreamBuf buf(section.data, section.size);
+            std::istream in(&buf);
+            if (ReadValue<uint32_t>(in) != kind || ReadValue<uint32_t>(in) != lib)
+                continue;
+            VERIFY_MSG(ReadValue<uint32_t>(in) == sizeof(Point), "Incompatible paired info point layout");
+
+            std::vector<Point> points;
+            while (!Exhausted(in)) {
+                EdgeId e1 = edge(ReadValue<uint64_t>(in));
+                EdgeId e2 = edge(ReadValue<uint64_t>(in));
+                points.resize(ReadValue<uint64_t>(in));
+                in.read((char *) points.data(), points.size() * sizeof(Point));
+                VERIFY_MSG(!in.fail(), "Truncated graph pack checkpoint");
+                //Need to prevent doubling of self-conjugate edge pairs
+                //Their weight would be always even, so we don't lose precision
+                bool self_conj = (std::make_pair(e1, e2) == paired_index.ConjugatePair(e1, e2));
+                for (Point &point : points) {
+                    if (self_conj)
+                        point.weight = math::round(point.weight / 2);
+                    paired_index.Add(e1, e2, point);
+                }
+            }
+            DEBUG("PII SIZE " << paired_index.size());
+            return;
+        }
+        VERIFY_MSG(!force_exists, "Paired info " << kind << ":" << lib << " not found");
+        INFO("Paired info not found, skipping");
+    }
+
+    template<class KmerMapper>
+    bool LoadKmerMapper(KmerMapper &mapper) {
+        mapper.clear();
+        auto sections = reader_.sections(KMER_MAPPER);
+        if (sections.empty())
+            return false;
+        MemoryStreamBuf buf(sections[0].data, sections[0].size);
+        std::istream in(&buf);
+        mapper.BinRead(in);
+        return true;
+    }
+
+    bool LoadPositions(EdgesPositionHandler<Graph> &edge_pos) {
+        auto sections = reader_.sections(POSITIONS);
+        if (sections.empty()) {
+            INFO("No positions were saved");
+            return false;
+        }
+        VERIFY(!edge_pos.IsAttached());
+        edge_pos.Attach();
+        MemoryStreamBuf buf(sections[0].data, sections[0].size);
+        std::istream in(&buf);
+        while (!Exhausted(in)) {
+            EdgeId e = edge(ReadValue<uint64_t>(in));
+            size_t count = ReadValue<uint64_t>(in);
+            for (size_t i = 0; i < count; ++i) {
+                std::string contig_id(ReadValue<uint64_t>(in), '\0');
+                in.read(&contig_id[0], contig_id.size());
+                size_t start = ReadValue<uint64_t>(in), end = ReadValue<uint64_t>(in);
+                size_t m_start = ReadValue<uint64_t>(in), m_end = ReadValue<uint64_t>(in);
+                edge_pos.AddEdgePosition(e, contig_id, start, end, m_start, m_end);
+            }
+        }
+        return true;
+    }
+
+  private:
+    Graph &g_;
+    const CheckpointReader &reader_;
+    std::unordered_map<size_t, EdgeId> edges_;
+};
+
+}
+
+template<class graph_pack>
+void PrintAllBinary(const std::string &file_name, const graph_pack &gp) {
+    typedef typename graph_pack::graph_t Graph;
+    INFO("Saving graph pack checkpoint to " << binary::CheckpointFileName(file_name));
+    {
+        binary::CheckpointWriter writer(binary::CheckpointFileName(file_name), unsigned(gp.k_value));
+        binary::BinaryDataPrinter<Graph> printer(gp.g, writer);
+        printer.SaveGraph();
+        printer.SaveCoverage();
+        if (gp.edge_pos.IsAttached())
+            printer.SavePositions(gp.edge_pos);
+        if (gp.kmer_mapper.IsAttached())
+            printer.SaveKmerMapper(gp.kmer_mapper);
+        if (gp.flanking_cov.IsAttached())
+            printer.SaveFlankingCoverage(gp.flanking_cov);
+        for (size_t i = 0; i < gp.paired_indices.size(); ++i)
+            printer.SavePaired(gp.paired_indices[i], binary::UNCLUSTERED, i);
+        for (size_t i = 0; i < gp.clustered_indices.size(); ++i)
+            printer.SavePaired(gp.clustered_indices[i], binary::CLUSTERED, i);
+        for (size_t i = 0; i < gp.scaffolding_indices.size(); ++i)
+            printer.SavePaired(gp.scaffolding_indices[i], binary::SCAFFOLDING, i);
+    }
+    // Edge index is already stored in a binary mmappable form
+    if (gp.index.IsAttached())
+        SaveEdgeIndex(file_name, gp.index.inner_index());
+    PrintSingleLongReads(file_name, gp.single_long_reads);
+    gp.ginfo.Save(file_name + ".ginfo");
+}
+
+namespace binary {
+
+template<class graph_pack>
+void ScanGraphPack(const std::string &file_name, BinaryDataScanner<typename graph_pack::graph_t> &scanner,
+                   graph_pack &gp) {
+    scanner.LoadGraph();
+    scanner.LoadCoverage();
+    gp.index.Attach();
+    if (LoadEdgeIndex(file_name, gp.index.inner_index())) {
+        gp.index.Update();
+    } else {
+        WARN("Cannot load edge index, kmer coverages will be missed");
+        gp.index.Refill();
+    }
+    scanner.LoadPositions(gp.edge_pos);
+    //load kmer_mapper only if needed
+    if (gp.kmer_mapper.IsAttached())
+        if (!scanner.LoadKmerMapper(gp.kmer_mapper)) {
+            WARN("Cannot load kmer_mapper, information on projected kmers will be missed");
+        }
+    if (!scanner.LoadFlankingCoverage(gp.flanking_cov)) {
+        WARN("Cannot load flanking coverage, flanking coverage will be recovered from index");
+        gp.flanking_cov.Fill(gp.index.inner_index());
+    }
+}
+
+}
+
+inline bool CheckpointExists(const std::string &file_name) {
+    return fs::FileExists(binary::CheckpointFileName(file_name));
+}
+
+// Binary counterpart of ScanGraphPack, paired indices and long reads are not loaded.
+// Returns false if there is no binary checkpoint for the given prefix
+template<class graph_pack>
+bool ScanGraphPackBinary(const std::string &file_name, graph_pack &gp) {
+    typedef typename graph_pack::graph_t Graph;
+    if (!CheckpointExists(file_name))
+        return false;
+    INFO("Reading graph pack checkpoint from " << binary::CheckpointFileName(file_name));
+
+    binary::CheckpointReader reader(binary::CheckpointFileName(file_name), unsigned(gp.k_value));
+    binary::BinaryDataScanner<Graph> scanner(gp.g, reader);
+    binary::ScanGraphPack(file_name, scanner, gp);
+    return true;
+}
+
+// Binary counterpart of ScanWithClusteredIndices
+template<class graph_pack>
+bool ScanWithClusteredIndicesBinary(const std::string &file_name, graph_pack &gp,
+                                    PairedInfoIndicesT<typename graph_pack::graph_t> &paired_indices) {
+    typedef typename graph_pack::graph_t Graph;
+    if (!CheckpointExists(file_name))
+        return false;
+    INFO("Reading graph pack checkpoint from " << binary::CheckpointFileName(file_name));
+
+    binary::CheckpointReader reader(binary::CheckpointFileName(file_name), unsigned(gp.k_value));
+    binary::BinaryDataScanner<Graph> scanner(gp.g, reader);
+    binary::ScanGraphPack(file_name, scanner, gp);
+    for (size_t i = 0; i < paired_indices.size(); ++i)
+        scanner.LoadPaired(paired_indices[i], binary::CLUSTERED, i, false);
+    return true;
+}
+
+// Returns false if there is no binary checkpoint for the given prefix
+template<class graph_pack>
+bool ScanAllBinary(const std::string &file_name, graph_pack &gp,
+                   bool force_exists = true) {
+    typedef typename graph_pack::graph_t Graph;
+    if (!CheckpointExists(file_name))
+        return false;
+    INFO("Reading graph pack checkpoint from " << binary::CheckpointFileName(file_name));
+
+    binary::CheckpointReader reader(binary::CheckpointFileName(file_name), unsigned(gp.k_value));
+    binary::BinaryDataScanner<Graph> scanner(gp.g, reader);
+    binary::ScanGraphPack(file_name, scanner, gp);
+    for (size_t i = 0; i < gp.paired_indices.size(); ++i)
+        scanner.LoadPaired(gp.paired_indices[i], binary::UNCLUSTERED, i, force_exists);
+    for (size_t i = 0; i < gp.clustered_indices.size(); ++i)
+        scanner.LoadPaired(gp.clustered_indices[i], binary::CLUSTERED, i, force_exists);
+    for (size_t i = 0; i < gp.scaffolding_indices.size(); ++i)
+        scanner.LoadPaired(gp.scaffolding_indices[i], binary::SCAFFOLDING, i, force_exists);
+    ScanSingleLongReads(file_name, gp.single_long_reads);
+    gp.ginfo.Load(file_name + ".ginfo");
+    return true;
+}
+
+}
+}
@@ -50,6 +50,7 @@ template<> struct MappingTraits<debruijn_graph::config::LibraryData> {
         io.mapRequired("insert size distribution"   , data.insert_size_distribution);
         io.mapRequired("pi threshold"               , data.pi_threshold);
         io.mapRequired("binary converted"           , data.binary_reads_info.binary_converted);
+        io.mapOptional("binary files number"        , data.binary_reads_info.file_num);
         io.mapRequired("single reads mapped"        , data.single_reads_mapped);
         io.mapRequired("library index"              , data.lib_index);
         io.mapRequired("number of reads"            , data.read_count);
@@ -661,6 +662,12 @@ void load_launch_info(debruijn_config &cfg, boost::property_tree::ptree const &p
         cfg.load_from = cfg.output_dir + cfg.load_from;
     }
 
+    cfg.text_saves = false;
+    load(cfg.text_saves, pt, "text_saves", false);
+
+    cfg.cache_paired_mappings = true;
+    load(cfg.cache_paired_mappings, pt, "cache_paired_mappings", false);
+
     load(cfg.tmp_dir, pt, "tmp_dir");
     load(cfg.main_iteration, pt, "main_iteration");
 
@@ -117,7 +117,7 @@ struct LibraryData {
     double pi_threshold;
 
     struct BinaryReadsInfo {
-        BinaryReadsInfo(): binary_converted(false), chunk_num(0), buffer_size(0) {}
+        BinaryReadsInfo(): binary_converted(false), chunk_num(0), file_num(0), buffer_size(0) {}
 
         bool binary_converted;
         std::string bin_reads_info_file;
@@ -125,6 +125,8 @@ struct LibraryData {
         std::string merged_read_prefix;
         std::string single_read_prefix;
         size_t chunk_num;
+        //number of files the reads were converted to, might differ from chunk_num
+        size_t file_num;
         size_t buffer_size;
     } binary_reads_info;
 
@@ -485,6 +487,7 @@ struct debruijn_config {
     boost::optional<scaffold_correction> sc_cor;
     truseq_analysis tsa;
     std::string load_from;
+    bool text_saves;
 
     std::string entry_point;
 
@@ -494,6 +497,7 @@ struct debruijn_config {
 
     single_read_resolving_mode single_reads_rr;
     bool use_single_reads;
+    bool cache_paired_mappings;
 
     bool correct_mismatches;
     bool paired_info_statistics;
@@ -107,7 +107,7 @@ struct graph_pack: private boost::noncopyable {
         VERIFY(kmer_mapper.IsAttached());
         EnsureIndex();
         INFO("Normalizing k-mer map. Total " << kmer_mapper.size() << " kmers to process");
-        kmer_mapper.Normalize();
+        kmer_mapper.Freeze();
         INFO("Normalizing done");
     }
 
@@ -7,6 +7,8 @@
 
 #include "pipeline/stage.hpp"
 #include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
+#include "pipeline/config_struct.hpp"
 
 #include "utils/logger/log_writers.hpp"
 
@@ -21,7 +23,8 @@ void AssemblyStage::load(debruijn_graph::conj_graph_pack& gp,
     std::string p = fs::append_path(load_from, prefix == NULL ? id_ : prefix);
     INFO("Loading current state from " << p);
 
-    debruijn_graph::graphio::ScanAll(p, gp, false);
+    if (!debruijn_graph::graphio::ScanAllBinary(p, gp, false))
+        debruijn_graph::graphio::ScanAll(p, gp, false);
     debruijn_graph::config::load_lib_data(p);
 }
 
@@ -31,7 +34,9 @@ void AssemblyStage::save(const debruijn_graph::conj_graph_pack& gp,
     std::string p = fs::append_path(save_to, prefix == NULL ? id_ : prefix);
     INFO("Saving current state to " << p);
 
-    debruijn_graph::graphio::PrintAll(p, gp);
+    debruijn_graph::graphio::PrintAllBinary(p, gp);
+    if (cfg::get().text_saves)
+        debruijn_graph::graphio::PrintAll(p, gp);
     debruijn_graph::config::write_lib_data(p);
 }
 
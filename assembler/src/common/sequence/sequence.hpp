@@ -11,6 +11,7 @@
 #include <string>
 #include <memory>
 #include <cstring>
+#include <atomic>
 
 #include "seq.hpp"
 #include "rtseq.hpp"
@@ -28,17 +29,29 @@ class Sequence {
     // Number of bits in STN (for faster div and mod)
     const static size_t STNBits = log_<STN, 2>::value;
 
-    class ManagedNuclBuffer final : public llvm::ThreadSafeRefCountedBase<ManagedNuclBuffer>,
-                                    protected llvm::TrailingObjects<ManagedNuclBuffer, ST> {
+    // Thread-safe refcounting as in llvm::ThreadSafeRefCountedBase, but the buffer
+    // can tell whether it is referenced by a single Sequence, which may then reuse it
+    class ManagedNuclBuffer final : protected llvm::TrailingObjects<ManagedNuclBuffer, ST> {
         friend TrailingObjects;
 
-        ManagedNuclBuffer() {}
+        mutable std::atomic<int> ref_count_;
 
-        ManagedNuclBuffer(size_t nucls, ST *buf) {
+        ManagedNuclBuffer() : ref_count_(0) {}
+
+        ManagedNuclBuffer(size_t nucls, ST *buf) : ref_count_(0) {
             std::uninitialized_copy(buf, buf + Sequence::DataSize(nucls), data());
         }
 
       public:
+        void Retain() const { ++ref_count_; }
+
+        void Release() const {
+            if (--ref_count_ == 0)
+                delete this;
+        }
+
+        bool unique() const { return ref_count_ == 1; }
+
         static ManagedNuclBuffer *create(size_t nucls) {
             void *mem = ::operator new(totalSizeToAlloc<ST>(Sequence::DataSize(nucls)));
             return new (mem) ManagedNuclBuffer();
@@ -115,7 +128,8 @@ class Sequence {
             bytes[cur] = 0;
     }
 
-    inline bool ReadHeader(std::istream &file);
+    template<class Stream>
+    inline bool ReadHeader(Stream &file);
     inline bool WriteHeader(std::ostream &file) const;
 
     Sequence(size_t size, int)
@@ -281,7 +295,8 @@ public:
     }
 
 public:
-    inline bool BinRead(std::istream &file);
+    template<class Stream>
+    inline bool BinRead(Stream &file);
     inline bool BinWrite(std::ostream &file) const;
 };
 
@@ -390,7 +405,8 @@ std::ostream &operator<<(std::ostream &os, const Sequence &s) {
     return os;
 }
 
-bool Sequence::ReadHeader(std::istream &file) {
+template<class Stream>
+bool Sequence::ReadHeader(Stream &file) {
     file.read((char *) &size_, sizeof(size_));
 
     from_ = 0;
@@ -409,10 +425,15 @@ bool Sequence::WriteHeader(std::ostream &file) const {
 }
 
 
-bool Sequence::BinRead(std::istream &file) {
+template<class Stream>
+bool Sequence::BinRead(Stream &file) {
+    // Buffer not shared with other sequences is reused if it is large enough,
+    // so that reading a stream into the same sequence does not allocate every time
+    size_t capacity = data_ && data_->unique() ? DataSize(from_ + size_) : 0;
     ReadHeader(file);
 
-    data_ = llvm::IntrusiveRefCntPtr<ManagedNuclBuffer>(ManagedNuclBuffer::create(size_));
+    if (DataSize(size_) > capacity)
+        data_ = llvm::IntrusiveRefCntPtr<ManagedNuclBuffer>(ManagedNuclBuffer::create(size_));
     file.read((char *) data_->data(), DataSize(size_) * sizeof(ST));
 
     return !file.fail();
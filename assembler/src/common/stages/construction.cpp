@@ -13,6 +13,7 @@
 #include "modules/graph_construction.hpp"
 #include "assembly_graph/stats/picture_dump.hpp"
 
+#include "utils/filesystem/copy_file.hpp"
 #include "utils/filesystem/temporary.hpp"
 
 #include "pipeline/graph_pack.hpp"
@@ -35,13 +36,14 @@ struct ConstructionStorage {
     using CoverageMap = utils::PerfectHashMap<RtSeq, uint32_t, utils::slim_kmer_index_traits<RtSeq>, utils::DefaultStoring>;
 
     ConstructionStorage(unsigned k)
-            : ext_index(k) {}
+            : ext_index(k), kmers_estimate(0) {}
 
     utils::DeBruijnExtensionIndex<> ext_index;
 
     std::unique_ptr<qf::cqf> cqf;
     std::unique_ptr<utils::KMerDiskCounter<RtSeq>> counter;
     std::unique_ptr<CoverageMap> coverage_map;
+    size_t kmers_estimate;
     config::debruijn_config::construction params;
     io::ReadStreamList<io::SingleReadSeq> read_streams;
     io::SingleStreamPtr contigs_stream;
@@ -123,6 +125,68 @@ void Construction::fini(debruijn_graph::conj_graph_pack &) {
 
 Construction::~Construction() {}
 
+// Replaces input streams with ones skipping reads of low k+1-mer multiplicity
+static void WrapWithCoverageFilter(ConstructionStorage &storage) {
+    unsigned kplusone = storage.ext_index.k() + 1;
+    rolling_hash::SymmetricCyclicHash<rolling_hash::NDNASeqHash> hasher(kplusone);
+    storage.read_streams = io::CovFilteringWrap(storage.read_streams, kplusone, hasher,
+                                                *storage.cqf, storage.params.read_cov_threshold);
+}
+
+// Bulky products (k+1-mer buckets, extension index k-mers) are hard linked
+// from the working directory, everything else is serialized next to them
+static void SaveStorage(const ConstructionStorage &storage, const std::string &p,
+                        bool with_ext_index) {
+    INFO("Saving construction products to " << p);
+    bool has_cqf = bool(storage.cqf), has_counter = bool(storage.counter);
+
+    std::ofstream os(p + ".cst", std::ios::binary);
+    os.write((const char*)&storage.kmers_estimate, sizeof(storage.kmers_estimate));
+    os.write((const char*)&has_cqf, sizeof(has_cqf));
+    os.write((const char*)&has_counter, sizeof(has_counter));
+    os.write((const char*)&with_ext_index, sizeof(with_ext_index));
+    VERIFY_MSG(os.good(), "Cannot write construction products to " << p);
+
+    if (has_cqf)
+        storage.cqf->serialize(p + ".cqf");
+    if (has_counter)
+        storage.counter->SaveBuckets(p + ".kpomers");
+    if (with_ext_index) {
+        std::ofstream idx(p + ".extidx", std::ios::binary);
+        storage.ext_index.BinWrite(idx);
+        fs::link_file(*storage.ext_index.kmers_file(), p + ".extkmers");
+    }
+}
+
+static void LoadStorage(ConstructionStorage &storage, const std::string &p) {
+    INFO("Loading construction products from " << p);
+    bool has_cqf = false, has_counter = false, has_ext_index = false;
+
+    std::ifstream is(p + ".cst", std::ios::binary);
+    VERIFY_MSG(is.good(), "Cannot open construction products " << p);
+    is.read((char*)&storage.kmers_estimate, sizeof(storage.kmers_estimate));
+    is.read((char*)&has_cqf, sizeof(has_cqf));
+    is.read((char*)&has_counter, sizeof(has_counter));
+    is.read((char*)&has_ext_index, sizeof(has_ext_index));
+    VERIFY_MSG(!is.fail(), "Malformed construction products " << p);
+
+    if (has_cqf) {
+        storage.cqf.reset(new qf::cqf(p + ".cqf"));
+        WrapWithCoverageFilter(storage);
+    }
+    if (has_counter) {
+        storage.counter.reset(new utils::KMerDiskCounter<RtSeq>(storage.workdir, storage.ext_index.k() + 1));
+        storage.counter->LoadBuckets(p + ".kpomers");
+    }
+    if (has_ext_index) {
+        std::ifstream idx(p + ".extidx", std::ios::binary);
+        storage.ext_index.BinRead(idx, p + ".extidx");
+        auto kmers = storage.workdir->tmp_file("ext_kmers");
+        fs::link_file(p + ".extkmers", *kmers);
+        storage.ext_index.set_kmers_file(kmers);
+    }
+}
+
 class CoverageFilter: public Construction::Phase {
   public:
     CoverageFilter()
@@ -145,6 +209,7 @@ class CoverageFilter: public Construction::Phase {
 
         INFO("Estimating k-mers cardinality");
         size_t kmers = EstimateCardinality(kplusone, read_streams, hasher, KmerFilter());
+        storage().kmers_estimate = kmers;
 
         // Create main CQF using # of slots derived from estimated # of k-mers
         storage().cqf.reset(new qf::cqf(kmers));
@@ -153,19 +218,19 @@ class CoverageFilter: public Construction::Phase {
         FillCoverageHistogram(*storage().cqf, kplusone, hasher, read_streams, rthr, KmerFilter());
 
         // Replace input streams with wrapper ones
-        storage().read_streams = io::CovFilteringWrap(read_streams, kplusone, hasher, *storage().cqf, rthr);
+        WrapWithCoverageFilter(storage());
     }
 
     void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), fs::append_path(save_to, prefix), false);
     }
 
 };
@@ -189,25 +254,28 @@ public:
         VERIFY_MSG(read_streams.size(), "No input streams specified");
 
         unsigned nthreads = (unsigned)read_streams.size();
+        unsigned kplusone = index.k() + 1;
         utils::DeBruijnReadKMerSplitter<io::SingleReadSeq,
                                         utils::StoringTypeFilter<storing_type>>
-                splitter(storage().workdir, index.k() + 1, 0,
+                splitter(storage().workdir, kplusone, 0,
                          read_streams, (contigs_stream == 0) ? 0 : &(*contigs_stream),
                          buffer_size);
         storage().counter.reset(new utils::KMerDiskCounter<RtSeq>(storage().workdir, splitter));
+        // Only the coverage filter estimates cardinality, there is no extra pass over the reads otherwise
+        storage().counter->PreferInMemory(storage().kmers_estimate);
         storage().counter->CountAll(nthreads, nthreads, /* merge */false);
     }
 
     void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), fs::append_path(save_to, prefix), false);
     }
 };
 
@@ -228,15 +296,15 @@ public:
     }
 
     void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), fs::append_path(save_to, prefix), true);
     }
 };
 
@@ -257,15 +325,15 @@ public:
     }
 
     void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), fs::append_path(save_to, prefix), true);
     }
 };
 
@@ -281,17 +349,21 @@ public:
         DeBruijnGraphExtentionConstructor<Graph>(gp.g, storage().ext_index).ConstructGraph(storage().params.keep_perfect_loops);
     }
 
-    void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+    void load(debruijn_graph::conj_graph_pack &gp,
+              const std::string &load_from,
+              const char* prefix) override {
+        AssemblyStage::load(gp, load_from, prefix);
+        // Condensing is done without the edge index, it is filled later
+        gp.index.Detach();
+        gp.index.clear();
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
-    void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        //FIXME why commented here and others
-        // VERIFY_MSG(false, "implement me");
+    void save(const debruijn_graph::conj_graph_pack &gp,
+              const std::string &save_to,
+              const char* prefix) const override {
+        AssemblyStage::save(gp, save_to, prefix);
+        SaveStorage(storage(), fs::append_path(save_to, prefix), false);
     }
 };
 
@@ -308,16 +380,18 @@ public:
         gp.index.Attach();
     }
 
-    void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+    void load(debruijn_graph::conj_graph_pack &gp,
+              const std::string &load_from,
+              const char* prefix) override {
+        AssemblyStage::load(gp, load_from, prefix);
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
-    void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+    void save(const debruijn_graph::conj_graph_pack &gp,
+              const std::string &save_to,
+              const char* prefix) const override {
+        AssemblyStage::save(gp, save_to, prefix);
+        SaveStorage(storage(), fs::append_path(save_to, prefix), false);
     }
 };
 
@@ -337,16 +411,16 @@ public:
         FillCoverageAndFlanking(gp.index.inner_index(), gp.g, gp.flanking_cov);
     }
 
-    void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+    void load(debruijn_graph::conj_graph_pack &gp,
+              const std::string &load_from,
+              const char* prefix) override {
+        AssemblyStage::load(gp, load_from, prefix);
     }
 
-    void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+    void save(const debruijn_graph::conj_graph_pack &gp,
+              const std::string &save_to,
+              const char* prefix) const override {
+        AssemblyStage::save(gp, save_to, prefix);
     }
 };
 
@@ -527,16 +601,16 @@ public:
         gp.ginfo.set_cov_histogram(hist);
     }
 
-    void load(debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+    void load(debruijn_graph::conj_graph_pack &gp,
+              const std::string &load_from,
+              const char* prefix) override {
+        AssemblyStage::load(gp, load_from, prefix);
     }
 
-    void save(const debruijn_graph::conj_graph_pack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+    void save(const debruijn_graph::conj_graph_pack &gp,
+              const std::string &save_to,
+              const char* prefix) const override {
+        AssemblyStage::save(gp, save_to, prefix);
     }
 
 };
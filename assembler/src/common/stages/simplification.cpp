@@ -256,7 +256,7 @@ public:
                 "Complex tip clipper");
 
         algo.AddAlgo(
-                ComplexBRInstance(gp_.g, simplif_cfg_.cbr, info_container_),
+                ComplexBRInstance(gp_.g, simplif_cfg_.cbr),
                 "Complex bulge remover");
 
         algo.AddAlgo(
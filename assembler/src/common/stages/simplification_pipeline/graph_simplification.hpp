@@ -470,14 +470,12 @@ AlgoPtr<Graph> RelativelyLowCoverageDisconnectorInstance(Graph &g,
 template<class Graph>
 AlgoPtr<Graph> ComplexBRInstance(
     Graph &g,
-    config::debruijn_config::simplification::complex_bulge_remover cbr_config,
-    const SimplifInfoContainer &info) {
+    config::debruijn_config::simplification::complex_bulge_remover cbr_config) {
     if (!cbr_config.enabled)
         return nullptr;
     size_t max_length = (size_t) ((double) g.k() * cbr_config.max_relative_length);
     size_t max_diff = cbr_config.max_length_difference;
-    return std::make_shared<omnigraph::complex_br::ComplexBulgeRemover<Graph>>(g, max_length,
-                                                                               max_diff, info.chunk_cnt());
+    return std::make_shared<omnigraph::complex_br::ComplexBulgeRemover<Graph>>(g, max_length, max_diff);
 }
 
 template<class Graph>
@@ -495,7 +493,7 @@ AlgoPtr<Graph> ComplexTipClipperInstance(Graph &g,
 
     return std::make_shared<omnigraph::ComplexTipClipper<Graph>>(g, ctc_conf.max_relative_coverage,
                                          ctc_conf.max_edge_len,
-                                         parser.max_length_bound(), info.chunk_cnt(),
+                                         parser.max_length_bound(),
                                          "", removal_handler);
 }
 
@@ -132,6 +132,11 @@ void link_files_by_prefix(fs::files_t const& files, std::string const& to_folder
     }
 }
 
+void link_file(std::string const& from_path, std::string const& to_path) {
+    remove_if_exists(to_path);
+    details::hard_link(from_path, to_path);
+}
+
 void copy_files_by_ext(std::string const& from_folder, std::string const& to_folder, std::string const& ext, bool recursive) {
     using namespace details;
 
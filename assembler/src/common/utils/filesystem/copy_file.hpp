@@ -14,5 +14,7 @@ files_t files_by_prefix(std::string const& path);
 void copy_files_by_prefix(files_t const& files, std::string const& to_folder);
 void link_files_by_prefix(files_t const& files, std::string const& to_folder);
 void copy_files_by_ext(std::string const& from_folder, std::string const& to_folder, std::string const& ext, bool recursive);
+// Hard links the file (copies it if linking fails), replacing the existing one
+void link_file(std::string const& from_path, std::string const& to_path);
 
 }
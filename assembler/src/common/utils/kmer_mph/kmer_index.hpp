@@ -83,6 +83,11 @@ public:
     return bucket_starts_[bucket] + index_[bucket].lookup(s);
   }
 
+  // Prefetches the memory seq_idx(s) is going to touch
+  void prefetch(const KMerSeq &s) const {
+    index_[seq_bucket(s)].prefetch(s);
+  }
+
   size_t raw_seq_idx(const KMerRawReference data) const {
     size_t bucket = raw_seq_bucket(data);
 
@@ -16,6 +16,7 @@
 
 #include "utils/logger/logger.hpp"
 #include "utils/filesystem/path_helper.hpp"
+#include "utils/filesystem/copy_file.hpp"
 
 #include "utils/memory_limit.hpp"
 #include "utils/filesystem/file_limit.hpp"
@@ -85,10 +86,20 @@ class KMerDiskCounter : public KMerCounter<Seq> {
   typedef KMerCounter<Seq, traits> __super;
   typedef typename traits::RawKMerStorage BucketStorage;
   typedef typename traits::ResultFile ResultFile;
+  typedef typename Seq::DataType DataType;
+  typedef typename adt::array_vector<DataType>::iterator RunIterator;
+  typedef typename adt::array_vector<DataType>::value_type RawKMer;
+  typedef adt::iterator_range<RunIterator> Run;
 public:
   KMerDiskCounter(fs::TmpDir work_dir,
                   KMerSplitter<Seq> &splitter)
-      : work_dir_(work_dir), splitter_(splitter), k_(splitter.K()) {
+      : work_dir_(work_dir), splitter_(&splitter), k_(splitter.K()), in_memory_preferred_(false), cardinality_estimate_(0) {
+    kmer_prefix_ = work_dir_->tmp_file("kmers");
+  }
+
+  // Counter without a splitter, its buckets could only be restored via LoadBuckets()
+  KMerDiskCounter(fs::TmpDir work_dir, unsigned k)
+      : work_dir_(work_dir), splitter_(nullptr), k_(k), in_memory_preferred_(false), cardinality_estimate_(0) {
     kmer_prefix_ = work_dir_->tmp_file("kmers");
   }
 
@@ -109,37 +120,35 @@ public:
     return std::unique_ptr<BucketStorage>(new BucketStorage(GetMergedKMersFname((unsigned)idx), Seq::GetDataSize(k_), unlink));
   }
 
+  // Try to keep the k-mer runs in memory. An estimated number of distinct
+  // k-mers (e.g. from HLL), when known, skips the attempt if the k-mer set
+  // clearly does not fit.
+  void PreferInMemory(size_t cardinality_estimate = 0) {
+    in_memory_preferred_ = true;
+    cardinality_estimate_ = cardinality_estimate;
+  }
+
   size_t Count(unsigned num_buckets, unsigned num_threads) override {
+    VERIFY_MSG(splitter_, "No splitter to count k-mers with");
     this->num_buckets_ = num_buckets;
     unsigned num_files = num_buckets * num_threads;
 
+    ChooseCountingMode();
+
     // Split k-mers into buckets.
     INFO("Splitting kmer instances into " << num_files << " files using " << num_threads << " threads. This might take a while.");
-    auto raw_kmers = splitter_.Split(num_files, num_threads);
+    auto raw_kmers = splitter_->Split(num_files, num_threads);
 
     INFO("Starting k-mer counting.");
-    size_t kmers = 0;
-#   pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
-    for (unsigned i = 0; i < raw_kmers.size(); ++i) {
-      kmers += MergeKMers(*raw_kmers[i], GetUniqueKMersFname(i));
-      raw_kmers[i].reset();
-    }
+    size_t kmers = (splitter_->in_memory() ?
+                    CountInMemory(num_buckets, num_threads) :
+                    CountOnDisk(raw_kmers, num_buckets, num_threads));
     INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
     if (!kmers) {
       FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
       exit(-1);
     }
 
-    INFO("Merging temporary buckets.");
-    for (unsigned i = 0; i < num_buckets; ++i) {
-      std::string ofname = GetMergedKMersFname(i);
-      std::ofstream ofs(ofname.c_str(), std::ios::out | std::ios::binary);
-      for (unsigned j = 0; j < num_threads; ++j) {
-        BucketStorage ins(GetUniqueKMersFname(i + j * num_buckets), Seq::GetDataSize(k_), /* unlink */ true);
-        ofs.write((const char*)ins.data(), ins.data_size());
-      }
-    }
-
     this->kmers_ = kmers;
     this->counted_ = true;
 
@@ -149,13 +158,22 @@ public:
   void MergeBuckets() override {
     INFO("Merging final buckets.");
 
+    std::vector<std::unique_ptr<BucketStorage>> buckets;
+    std::vector<size_t> offsets(this->num_buckets_ + 1, 0);
+    for (unsigned j = 0; j < this->num_buckets_; ++j) {
+      buckets.push_back(GetBucket(j, /* unlink */ true));
+      offsets[j + 1] = offsets[j] + buckets.back()->size();
+    }
+
     final_kmers_ = work_dir_->tmp_file("final_kmers");
-    std::ofstream ofs(*final_kmers_, std::ios::out | std::ios::binary);
+    MMappedRecordArrayWriter<DataType> os(*final_kmers_, Seq::GetDataSize(k_));
+    os.resize(offsets.back());
+#   pragma omp parallel for schedule(dynamic)
     for (unsigned j = 0; j < this->num_buckets_; ++j) {
-      auto bucket = GetBucket(j, /* unlink */ true);
-      ofs.write((const char*)bucket->data(), bucket->data_size());
+      memcpy(os.data() + offsets[j] * Seq::GetDataSize(k_),
+             buckets[j]->data(), buckets[j]->data_size());
+      buckets[j].reset();
     }
-    ofs.close();
   }
 
   size_t CountAll(unsigned num_buckets, unsigned num_threads, bool merge = true) override {
@@ -170,6 +188,35 @@ public:
     return kmer_prefix_->file() + ".merged." + std::to_string(suffix);
   }
 
+  // Counted buckets are saved as <prefix>.<bucket> (hard linked when possible),
+  // <prefix> itself keeps the counter parameters.
+  void SaveBuckets(const std::string &prefix) const {
+    VERIFY_MSG(this->counted_, "k-mers were not counted yet");
+    std::ofstream os(prefix, std::ios::binary);
+    os.write((const char*)&k_, sizeof(k_));
+    os.write((const char*)&this->num_buckets_, sizeof(this->num_buckets_));
+    os.write((const char*)&this->kmers_, sizeof(this->kmers_));
+    VERIFY_MSG(!os.fail(), "Failed to save k-mer counter to " << prefix);
+
+    for (unsigned i = 0; i < this->num_buckets_; ++i)
+      fs::link_file(GetMergedKMersFname(i), prefix + "." + std::to_string(i));
+  }
+
+  void LoadBuckets(const std::string &prefix) {
+    std::ifstream is(prefix, std::ios::binary);
+    VERIFY_MSG(is.is_open(), "Cannot find k-mer counter saves " << prefix);
+    unsigned k;
+    is.read((char*)&k, sizeof(k));
+    VERIFY_MSG(k == k_, "Cannot read k-mer counter, different Ks");
+    is.read((char*)&this->num_buckets_, sizeof(this->num_buckets_));
+    is.read((char*)&this->kmers_, sizeof(this->kmers_));
+    VERIFY_MSG(!is.fail(), "Failed to load k-mer counter from " << prefix);
+
+    for (unsigned i = 0; i < this->num_buckets_; ++i)
+      fs::link_file(prefix + "." + std::to_string(i), GetMergedKMersFname(i));
+    this->counted_ = true;
+  }
+
   ResultFile final_kmers_file() {
     VERIFY_MSG(this->final_kmers_, "k-mers were not counted yet");
     return final_kmers_;
@@ -179,97 +226,214 @@ private:
   fs::TmpDir work_dir_;
   fs::TmpFile kmer_prefix_;
   fs::TmpFile final_kmers_;
-  KMerSplitter<Seq> &splitter_;
+  KMerSplitter<Seq> *splitter_;
   unsigned k_;
+  bool in_memory_preferred_;
+  size_t cardinality_estimate_;
+
+  void ChooseCountingMode() {
+    if (!in_memory_preferred_)
+      return;
+
+    // Splitter buffers take up to a third of free memory, leave another third
+    // for the sorted runs. Runs keep duplicates between splitter dumps, so
+    // require at least twice the size of the distinct k-mer set.
+    size_t budget = utils::get_free_memory() / 3;
+    if (cardinality_estimate_ && 2 * cardinality_estimate_ * kmer_size() > budget) {
+      INFO("Estimated k-mer set does not fit into memory, counting on disk");
+      return;
+    }
+
+    // Without an estimate, start in memory: the splitter spills the runs to
+    // disk as soon as they outgrow the budget
+    INFO("Counting k-mers in memory while they fit");
+    splitter_->KeepInMemory(budget);
+  }
 
-  std::string GetUniqueKMersFname(unsigned suffix) const {
-    return kmer_prefix_->file() + ".unique." + std::to_string(suffix);
+  // Parts smaller than this are not worth a separate merge
+  static const size_t MIN_PART_SIZE = 1 << 16;
+  static const size_t SAMPLES_PER_PART = 64;
+
+  size_t CountOnDisk(typename KMerSplitter<Seq>::RawKMers &raw_kmers,
+                     unsigned num_buckets, unsigned num_threads) {
+    size_t kmers = 0;
+    for (unsigned i = 0; i < num_buckets; ++i) {
+      std::vector<std::unique_ptr<BucketStorage>> files;
+      std::vector<Run> runs;
+      for (unsigned j = 0; j < num_threads; ++j)
+        PrepareRuns(*raw_kmers[i + j * num_buckets], files, runs);
+
+      kmers += MergeBucket(runs, GetMergedKMersFname(i), num_threads);
+
+      files.clear();
+      for (unsigned j = 0; j < num_threads; ++j)
+        raw_kmers[i + j * num_buckets].reset();
+    }
+
+    return kmers;
   }
 
-  size_t MergeKMers(const std::string &ifname, const std::string &ofname) {
-    MMappedRecordArrayReader<typename Seq::DataType> ins(ifname, Seq::GetDataSize(k_), /* unlink */ true);
+  size_t CountInMemory(unsigned num_buckets, unsigned num_threads) {
+    auto runs = splitter_->ReleaseRuns();
+    VERIFY(runs.size() == num_buckets * num_threads);
+
+    // Bucket i consists of the runs for files i, i + num_buckets, ...
+    size_t kmers = 0;
+    for (unsigned i = 0; i < num_buckets; ++i) {
+      std::vector<Run> ranges;
+      for (unsigned j = 0; j < num_threads; ++j)
+        for (auto &run : runs[i + j * num_buckets])
+          ranges.push_back(adt::make_range(run.begin(), run.end()));
+
+      kmers += MergeBucket(ranges, GetMergedKMersFname(i), num_threads);
+
+      for (unsigned j = 0; j < num_threads; ++j)
+        runs[i + j * num_buckets].clear();
+    }
+
+    return kmers;
+  }
+
+  void PrepareRuns(const std::string &ifname,
+                   std::vector<std::unique_ptr<BucketStorage>> &files,
+                   std::vector<Run> &runs) {
+    files.emplace_back(new BucketStorage(ifname, Seq::GetDataSize(k_), /* unlink */ true));
+    BucketStorage &ins = *files.back();
 
     std::string IdxFileName = ifname + ".idx";
     if (FILE *f = fopen(IdxFileName.c_str(), "rb")) {
       fclose(f);
-      MMappedRecordReader<size_t> index(ifname + ".idx", true, -1ULL);
+      MMappedRecordReader<size_t> index(IdxFileName, true, -1ULL);
 
-      // INFO("Total runs: " << index.size());
-
-      // Prepare runs
-      std::vector<adt::iterator_range<decltype(ins.begin())>> ranges;
       auto beg = ins.begin();
       for (size_t sz : index) {
         auto end = std::next(beg, sz);
-        ranges.push_back(adt::make_range(beg, end));
-        VERIFY(std::is_sorted(beg, end, adt::array_less<typename Seq::DataType>()));
+        runs.push_back(adt::make_range(beg, end));
+        VERIFY(std::is_sorted(beg, end, adt::array_less<DataType>()));
         beg = end;
       }
+    } else {
+      // No run index, the whole file is a single unsorted run
+      libcxx::sort(ins.begin(), ins.end(), adt::array_less<DataType>());
+      runs.push_back(adt::make_range(ins.begin(), ins.end()));
+    }
+  }
 
-      // Construct tree on top entries of runs
-      adt::loser_tree<decltype(beg),
-              adt::array_less<typename Seq::DataType>> tree(ranges);
+  // Picks splitter keys from the evenly spaced samples of all runs, so the
+  // parts [splitters[p - 1], splitters[p]) have roughly the same size.
+  std::vector<RawKMer> SampleSplitters(const std::vector<Run> &runs,
+                                       size_t total, size_t num_parts) const {
+    std::vector<RawKMer> splitters;
+    if (num_parts < 2)
+      return splitters;
+
+    size_t step = std::max(total / (num_parts * SAMPLES_PER_PART), size_t(1));
+    adt::KMerVector<Seq> samples(k_, num_parts * SAMPLES_PER_PART + runs.size());
+    for (const auto &run : runs) {
+      size_t sz = run.end() - run.begin();
+      for (size_t pos = step / 2; pos < sz; pos += step)
+        samples.push_back(*(run.begin() + pos));
+    }
+    if (samples.size() < num_parts)
+      return splitters;
+
+    libcxx::sort(samples.begin(), samples.end(), adt::array_less<DataType>());
+    splitters.reserve(num_parts - 1);
+    for (size_t p = 1; p < num_parts; ++p) {
+      auto key = *(samples.begin() + p * samples.size() / num_parts);
+      if (splitters.empty() || adt::array_less<DataType>()(splitters.back(), key))
+        splitters.emplace_back(key);
+    }
 
-      if (tree.empty()) {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        fclose(g);
-        return 0;
-      }
+    return splitters;
+  }
 
-      // Write it down!
-      adt::KMerVector<Seq> buf(k_, 1024*1024);
-      auto pval = tree.pop();
-      size_t total = 0;
-      while (!tree.empty()) {
-          buf.clear();
-          for (size_t cnt = 0; cnt < buf.capacity() && !tree.empty(); ) {
-              auto cval = tree.pop();
-              if (!adt::array_equal_to<typename Seq::DataType>()(pval, cval)) {
-                  buf.push_back(pval);
-                  pval = cval;
-                  cnt += 1;
-              }
-          }
-          total += buf.size();
-
-          FILE *g = fopen(ofname.c_str(), "ab");
-          if (!g)
-            FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-          size_t res = fwrite(buf.data(), buf.el_data_size(), buf.size(), g);
-          if (res != buf.size())
-            FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-          fclose(g);
+  // Merges the sorted runs of a bucket into a single sorted file of unique
+  // k-mers. The key space is partitioned by the sampled splitters and the
+  // parts are merged concurrently into the disjoint ranges of the output.
+  size_t MergeBucket(const std::vector<Run> &runs,
+                     const std::string &ofname, unsigned num_threads) {
+    size_t total = 0;
+    for (const auto &run : runs)
+      total += run.end() - run.begin();
+
+    size_t num_parts = std::min(size_t(4 * num_threads), total / MIN_PART_SIZE);
+    auto splitters = SampleSplitters(runs, total, num_parts);
+    num_parts = splitters.size() + 1;
+
+    // Every key goes into the same part for all the runs, so there are no
+    // duplicates between the parts. Part sizes before deduplication give the
+    // upper bounds for part offsets in the output.
+    std::vector<std::vector<Run>> parts(num_parts);
+    std::vector<size_t> offsets(num_parts + 1, 0);
+    for (const auto &run : runs) {
+      auto beg = run.begin();
+      for (size_t p = 0; p < num_parts; ++p) {
+        auto end = (p + 1 < num_parts ?
+                    std::lower_bound(beg, run.end(), splitters[p], adt::array_less<DataType>()) :
+                    run.end());
+        if (beg != end) {
+          parts[p].push_back(adt::make_range(beg, end));
+          offsets[p + 1] += end - beg;
+        }
+        beg = end;
       }
+    }
+    for (size_t p = 0; p < num_parts; ++p)
+      offsets[p + 1] += offsets[p];
 
-      // Handle very last value
-      {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        size_t res = fwrite(pval.data(), pval.data_size(), 1, g);
-        if (res != 1)
-          FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-        fclose(g);
-        total += 1;
+    size_t kmers = 0;
+    {
+      MMappedRecordArrayWriter<DataType> os(ofname, Seq::GetDataSize(k_));
+      if (!total)
+        return 0;
+      os.resize(total);
+
+      std::vector<size_t> sizes(num_parts, 0);
+#     pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+      for (size_t p = 0; p < num_parts; ++p)
+        sizes[p] = MergeRuns(parts[p], os.begin() + offsets[p]);
+
+      // Close the gaps left by the duplicates
+      for (size_t p = 0; p < num_parts; ++p) {
+        if (offsets[p] != kmers)
+          memmove(os.data() + kmers * Seq::GetDataSize(k_),
+                  os.data() + offsets[p] * Seq::GetDataSize(k_),
+                  sizes[p] * kmer_size());
+        kmers += sizes[p];
       }
+    }
 
-      return total;
-    } else {
-      // Sort the stuff
-      libcxx::sort(ins.begin(), ins.end(), adt::array_less<typename Seq::DataType>());
-
-      // FIXME: Use something like parallel version of unique_copy but with explicit
-      // resizing.
-      auto it = std::unique(ins.begin(), ins.end(), adt::array_equal_to<typename Seq::DataType>());
+    if (truncate(ofname.c_str(), kmers * kmer_size()) != 0)
+      FATAL_ERROR("truncate(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
 
-      MMappedRecordArrayWriter<typename Seq::DataType> os(ofname, Seq::GetDataSize(k_));
-      os.resize(it - ins.begin());
-      std::copy(ins.begin(), it, os.begin());
+    return kmers;
+  }
 
-      return it - ins.begin();
+  size_t MergeRuns(const std::vector<Run> &runs, RunIterator out) {
+    if (runs.empty())
+      return 0;
+
+    adt::loser_tree<RunIterator, adt::array_less<DataType>> tree(runs);
+    if (tree.empty())
+      return 0;
+
+    size_t cnt = 0;
+    auto pval = tree.pop();
+    while (!tree.empty()) {
+      auto cval = tree.pop();
+      if (!adt::array_equal_to<DataType>()(pval, cval)) {
+        *out++ = pval;
+        cnt += 1;
+        pval = cval;
+      }
     }
+
+    // Handle very last value
+    *out++ = pval;
+    cnt += 1;
+
+    return cnt;
   }
 };
 
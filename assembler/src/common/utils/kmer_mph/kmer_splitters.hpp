@@ -15,6 +15,9 @@
 
 #include <libcxx/sort.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace utils {
 
 template<class Seq>
@@ -22,12 +25,14 @@ class KMerSplitter {
 public:
     typedef typename Seq::hash hash_function;
     typedef std::vector<fs::DependentTmpFile> RawKMers;
+    typedef std::vector<adt::KMerVector<Seq>> KMerRuns;
 
     KMerSplitter(const std::string &work_dir, unsigned K, uint32_t seed = 0)
             : KMerSplitter(fs::tmp::make_temp_dir(work_dir, "kmer_splitter"), K, seed) {}
 
     KMerSplitter(fs::TmpDir work_dir, unsigned K, uint32_t seed = 0)
-            : work_dir_(work_dir), K_(K), seed_(seed) {}
+            : work_dir_(work_dir), K_(K), seed_(seed),
+              in_memory_(false), memory_budget_(0), runs_size_(0) {}
 
     virtual ~KMerSplitter() {}
 
@@ -39,12 +44,32 @@ public:
 
     unsigned K() const { return K_; }
 
+    // Keep sorted runs in memory instead of spilling them into RawKMers
+    // files. Splitter falls back to files as soon as runs exceed the budget.
+    void KeepInMemory(size_t memory_budget) {
+        in_memory_ = true;
+        memory_budget_ = memory_budget;
+    }
+
+    bool in_memory() const { return in_memory_; }
+
+    // Sorted runs for every output file, valid only if in_memory() after Split()
+    std::vector<KMerRuns> ReleaseRuns() {
+        runs_size_ = 0;
+        return std::move(runs_);
+    }
+
 protected:
     fs::TmpDir work_dir_;
     hash_function hash_;
     unsigned K_;
     uint32_t seed_;
 
+    bool in_memory_;
+    size_t memory_budget_;
+    size_t runs_size_;
+    std::vector<KMerRuns> runs_;
+
     DECL_LOGGER("K-mer Splitting");
 };
 
@@ -67,7 +92,15 @@ protected:
     size_t cell_size_;
     size_t num_files_;
 
+    // Output files are kept open during splitting. Every file is written by
+    // a single thread at a time, so the offsets need no synchronization.
+    RawKMers files_;
+    std::vector<int> fds_;
+    std::vector<size_t> offsets_;
+    std::vector<std::vector<size_t>> run_sizes_;
+
     RawKMers PrepareBuffers(size_t num_files, unsigned nthreads, size_t reads_buffer_size) {
+        CloseFiles();
         num_files_ = num_files;
 
         // Determine the set of output files
@@ -101,6 +134,14 @@ protected:
             entry.resize(num_files_, adt::KMerVector<Seq>(this->K_, (size_t) (1.1 * (double) cell_size_)));
         }
 
+        if (this->in_memory_) {
+            INFO("Keeping sorted k-mer runs in memory, budget " << (double)this->memory_budget_ / 1024.0 / 1024.0 / 1024.0 << " Gb");
+            this->runs_.clear();
+            this->runs_.resize(num_files_);
+            this->runs_size_ = 0;
+        } else
+            OpenFiles(out);
+
         return out;
     }
 
@@ -131,34 +172,89 @@ protected:
             }
             libcxx::sort(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::less2_fast());
             auto it = std::unique(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::equal_to());
-
-#     pragma omp critical
-            {
-                size_t cnt =  it - SortBuffer.begin();
-
-                // Write k-mers
-                FILE *f = fopen(ostreams[k]->file().c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                size_t res = fwrite(SortBuffer.data(), SortBuffer.el_data_size(), cnt, f);
-                if (res != cnt)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
-
-                // Write index
-                f = fopen((ostreams[k]->file() + ".idx").c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                res = fwrite(&cnt, sizeof(cnt), 1, f);
-                if (res != 1)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
+            size_t cnt =  it - SortBuffer.begin();
+
+            if (this->in_memory_) {
+                // Every file is touched by a single iteration, no need to lock
+                SortBuffer.resize(cnt);
+                SortBuffer.shrink_to_fit();
+                this->runs_[k].push_back(std::move(SortBuffer));
+#               pragma omp atomic
+                this->runs_size_ += cnt * this->kmer_size();
+                continue;
             }
+
+            WriteRun(k, SortBuffer, cnt);
         }
 
         for (auto & entry : kmer_buffers_)
             for (auto & eentry : entry)
                 eentry.clear();
+
+        if (this->in_memory_ && this->runs_size_ > this->memory_budget_)
+            SpillRuns(ostreams);
+    }
+
+    void OpenFiles(const RawKMers &ostreams) {
+        files_ = ostreams;
+        fds_.resize(num_files_);
+        offsets_.assign(num_files_, 0);
+        run_sizes_.assign(num_files_, std::vector<size_t>());
+        for (unsigned k = 0; k < num_files_; ++k) {
+            fds_[k] = ::open(files_[k]->file().c_str(), O_WRONLY | O_CREAT | O_TRUNC, (mode_t) 0660);
+            if (fds_[k] == -1)
+                FATAL_ERROR("Cannot open temporary file " << files_[k]->file() << " for writing");
+        }
+    }
+
+    // Writes down the run indices and closes the output files
+    void CloseFiles() {
+        for (unsigned k = 0; k < fds_.size(); ++k) {
+            ::close(fds_[k]);
+
+            const auto &sizes = run_sizes_[k];
+            FILE *f = fopen((files_[k]->file() + ".idx").c_str(), "wb");
+            if (!f)
+                FATAL_ERROR("Cannot open temporary file " << files_[k]->file() << ".idx for writing");
+            size_t res = fwrite(sizes.data(), sizeof(size_t), sizes.size(), f);
+            if (res != sizes.size())
+                FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+            fclose(f);
+        }
+
+        files_.clear();
+        fds_.clear();
+        offsets_.clear();
+        run_sizes_.clear();
+    }
+
+    void WriteRun(unsigned k, const SeqKMerVector &run, size_t cnt) {
+        const char *data = (const char*)run.data();
+        size_t size = cnt * run.el_data_size(), written = 0;
+        while (written < size) {
+            ssize_t res = pwrite(fds_[k], data + written, size - written, (off_t)(offsets_[k] + written));
+            if (res == -1)
+                FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+            written += res;
+        }
+
+        offsets_[k] += size;
+        run_sizes_[k].push_back(cnt);
+    }
+
+    void SpillRuns(const RawKMers &ostreams) {
+        INFO("In-memory k-mer runs exceeded the memory budget, spilling them to disk");
+
+        OpenFiles(ostreams);
+#   pragma omp parallel for
+        for (unsigned k = 0; k < num_files_; ++k) {
+            for (const auto &run : this->runs_[k])
+                WriteRun(k, run, run.size());
+        }
+
+        this->runs_.clear();
+        this->runs_size_ = 0;
+        this->in_memory_ = false;
     }
 
     void ClearBuffers() {
@@ -167,6 +263,8 @@ protected:
                 eentry.clear();
                 eentry.shrink_to_fit();
             }
+
+        CloseFiles();
     }
 
     unsigned GetFileNumForSeq(const Seq &s, unsigned total) const {
@@ -17,4 +17,20 @@ size_t get_max_rss();
 size_t get_used_memory();
 size_t get_free_memory();
 
+// Detects when free memory drops below the given fraction of what was free at
+// construction time. Every check re-samples the memory usage, so callers in
+// hot loops should check only every few thousand items.
+class MemoryPressureMonitor {
+  public:
+    explicit MemoryPressureMonitor(double ratio = 0.4)
+            : free_threshold_(size_t(ratio * double(get_free_memory()))) {}
+
+    bool high() const {
+        return get_free_memory() < free_threshold_;
+    }
+
+  private:
+    size_t free_threshold_;
+};
+
 }
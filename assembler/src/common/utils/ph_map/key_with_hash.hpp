@@ -47,6 +47,12 @@ public:
         return idx_;
     }
 
+    // Prefetches the memory the computation of idx() is going to touch
+    void prefetch_idx() const {
+        if (!ready_)
+            hash_.prefetch(key_);
+    }
+
     SimpleKeyWithHash &operator=(const SimpleKeyWithHash &that) {
         VERIFY(&this->hash_ == &that.hash_);
         this->key_= that.key_;
@@ -144,6 +150,12 @@ private:
         return idx_;
     }
 
+    // Prefetches the memory the computation of idx() is going to touch
+    void prefetch_idx() const {
+        if (!ready_)
+            hash_.prefetch(key_.IsMinimal() ? key_ : !key_);
+    }
+
     bool is_minimal() const {
         if(!ready_) {
             return key_.IsMinimal();
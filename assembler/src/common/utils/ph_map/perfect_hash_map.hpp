@@ -118,6 +118,18 @@ public:
         return StoringType::get_value(*this, kwh, inverter);
     }
 
+    // Prefetches the memory the index of the key is computed from. Call it
+    // some time before prefetch(), which computes the index.
+    void prefetch_idx(const KeyWithHash &kwh) const {
+        kwh.prefetch_idx();
+    }
+
+    // Computes the index of the key and prefetches its value
+    void prefetch(const KeyWithHash &kwh) const {
+        if (valid(kwh))
+            __builtin_prefetch(&ValueBase::operator[](kwh.idx()));
+    }
+
     //Think twice or ask AntonB if you want to use it!
     V &get_raw_value_reference(const KeyWithHash &kwh) {
         return ValueBase::operator[](kwh.idx());
@@ -386,6 +398,15 @@ public:
         return io::make_kmer_iterator<KMer>(*this->kmers_, base::k(), parts);
     }
 
+    // Sorted k-mers are kept in a separate file, which is not serialized with the map
+    typename traits::ResultFile kmers_file() const {
+        return kmers_;
+    }
+
+    void set_kmers_file(typename traits::ResultFile kmers) {
+        kmers_ = std::move(kmers);
+    }
+
     friend struct KeyIteratingIndexBuilder;
 };
 
@@ -8,7 +8,7 @@
 #pragma once
 
 #include "pipeline/graph_pack.hpp"
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 #include "utils/stl_utils.hpp"
 #include "modules/simplification/cleaner.hpp"
 #include "io/reads/splitting_wrapper.hpp"
@@ -462,7 +462,8 @@ void ThreadAssemblies(const string& base_saves, ContigStream& base_assembly,
     typedef typename gp_t::graph_t Graph;
     gp_t gp;
 //        ConstructGraph<gp_t::k_value, Graph>(gp.g, gp.index, base_assembly);
-    ScanGraphPack(base_saves, gp);
+    if (!ScanGraphPackBinary(base_saves, gp))
+        ScanGraphPack(base_saves, gp);
     base_assembly.reset();
     visualization::position_filler::FillPos(gp, base_assembly, base_prefix);
     visualization::position_filler::FillPos(gp, assembly_to_thread, to_thread_prefix);
@@ -10,7 +10,7 @@
 #include "stages/simplification_pipeline/graph_simplification.hpp"
 
 #include "compare_standard.hpp"
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 
 #include "comparison_utils.hpp"
 #include "diff_masking.hpp"
@@ -99,7 +99,8 @@ class CapEnvironmentManager {
 
     shared_ptr<gp_t> result(new gp_t(unsigned(K), env_->kDefaultGPWorkdir, 0));
 
-    debruijn_graph::graphio::ScanGraphPack(path, *result);
+    if (!debruijn_graph::graphio::ScanGraphPackBinary(path, *result))
+        debruijn_graph::graphio::ScanGraphPack(path, *result);
 
     ContigStreams streams;
     for (size_t i = 0; i < env_->genomes_.size(); ++i) {
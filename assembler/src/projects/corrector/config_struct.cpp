@@ -52,8 +52,9 @@ struct MappingTraits<corrector::corrector_config> {
         io.mapOptional("output_dir", cfg.output_dir, std::string("."));
         io.mapOptional("max_nthreads", cfg.max_nthreads, 1u);
         io.mapRequired("strategy", cfg.strat);
-        io.mapOptional("bwa", cfg.bwa, std::string("."));
         io.mapOptional("log_filename", cfg.log_filename, std::string("."));
+        io.mapOptional("dump_sam", cfg.dump_sam, false);
+        io.mapOptional("max_alignments_memory", cfg.max_alignments_memory, 2048u);
     }
 };
 }}
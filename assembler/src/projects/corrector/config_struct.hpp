@@ -24,8 +24,10 @@ struct corrector_config {
     std::string output_dir;
     unsigned max_nthreads;
     Strategy strat;
-    std::string bwa;
     std::string log_filename;
+    bool dump_sam;
+    // Alignments kept in memory until the contigs are processed, in Mb
+    unsigned max_alignments_memory;
 };
 
 void load(corrector::corrector_config& cfg, const std::string &filename);
@@ -0,0 +1,226 @@
+//***************************************************************************
+//* Copyright (c) 2015 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "contig_aligner.hpp"
+
+#include "bwa/bwa.h"
+#include "bwa/bwamem.h"
+
+#include "io/reads/file_reader.hpp"
+
+#include <cstdlib>
+
+namespace corrector {
+
+namespace {
+
+const char kRecordMarker = 1;
+
+// bwa cigar operations are MIDSH, BAM ones are MIDNSHP=X
+const uint32_t kBamCigarOp[5] = { 0, 1, 2, 4, 5 };
+
+// A, C, G, T, N in BAM 4-bit encoding
+const uint8_t kNt4ToNt16[5] = { 1, 2, 4, 8, 15 };
+
+// Output format of bwa: marker, contig id, SAM flag, AlignedRead::Header, cigar, sequence.
+// Unmapped reads, secondary alignments and alignments with zero quality are not reported.
+void FormatRecord(const mem_opt_t*, const bntseq_t*, struct __kstring_t *str, bseq1_t *s,
+                  int, const mem_aln_t*, int, const mem_aln_t *p, const mem_aln_t*) {
+    if (p->rid < 0 || p->n_cigar == 0 || p->mapq == 0 || (p->flag & 0x104))
+        return;
+
+    AlignedRead::Header header;
+    header.pos = int32_t(p->pos);
+    header.l_seq = uint32_t(s->l_seq);
+    header.n_cigar = uint16_t(p->n_cigar);
+    header.mapq = uint8_t(p->mapq);
+    header.flags = 0;
+    int32_t contig = p->rid;
+    uint16_t sam_flag = uint16_t(p->flag);
+
+    std::string record(1 + sizeof(contig) + sizeof(sam_flag) + sizeof(header) +
+                       4 * header.n_cigar + (header.l_seq + 1) / 2, '\0');
+    char *dst = &record[0];
+    *dst++ = kRecordMarker;
+    memcpy(dst, &contig, sizeof(contig));
+    dst += sizeof(contig);
+    memcpy(dst, &sam_flag, sizeof(sam_flag));
+    dst += sizeof(sam_flag);
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    for (int i = 0; i < p->n_cigar; ++i) {
+        uint32_t op = (p->cigar[i] & ~0xfU) | kBamCigarOp[p->cigar[i] & 0xf];
+        memcpy(dst, &op, sizeof(op));
+        dst += sizeof(op);
+    }
+    // The query is already in 2-bit encoding, SAM stores it on the forward strand of the contig
+    uint8_t *seq = (uint8_t*)dst;
+    for (int i = 0; i < s->l_seq; ++i) {
+        int c = p->is_rev ? s->seq[s->l_seq - 1 - i] : s->seq[i];
+        if (c > 4)
+            c = 4;
+        if (p->is_rev && c < 4)
+            c = 3 - c;
+        seq[i >> 1] |= uint8_t(kNt4ToNt16[c] << ((~i & 1) << 2));
+    }
+
+    mem_kputsn(record.data(), int(record.size()), str);
+}
+
+// Makes bwa output FormatRecord while in scope, the previous formatter is restored afterwards
+class FormatterScope {
+public:
+    FormatterScope() : prev_(mem_fmt_fnc) { mem_fmt_fnc = &FormatRecord; }
+    ~FormatterScope() { mem_fmt_fnc = prev_; }
+
+private:
+    decltype(mem_fmt_fnc) prev_;
+};
+
+void ParseHits(const char *buf, std::vector<ContigHit> &hits) {
+    if (!buf)
+        return;
+    while (*buf == kRecordMarker) {
+        ++buf;
+        ContigHit hit;
+        int32_t contig;
+        memcpy(&contig, buf, sizeof(contig));
+        hit.contig = contig;
+        buf += sizeof(contig);
+        memcpy(&hit.sam_flag, buf, sizeof(hit.sam_flag));
+        buf += sizeof(hit.sam_flag);
+        memcpy(&hit.header, buf, sizeof(hit.header));
+        buf += sizeof(hit.header);
+        hit.cigar = buf;
+        buf += 4 * hit.header.n_cigar;
+        hit.seq = buf;
+        buf += (hit.header.l_seq + 1) / 2;
+        hits.push_back(hit);
+    }
+}
+
+// Read name as in SAM, without the comment and the mate suffix
+std::string SamName(const std::string &name, bool paired) {
+    std::string res = name.substr(0, name.find_first_of(" \t"));
+    size_t len = res.length();
+    if (paired && len > 2 && res[len - 2] == '/' && (res[len - 1] == '1' || res[len - 1] == '2'))
+        res.resize(len - 2);
+    return res;
+}
+
+}
+
+void AlignmentBatch::clear() {
+    for (char *buf : buffers_)
+        free(buf);
+    buffers_.clear();
+    names_.clear();
+    seqs_.clear();
+    hits_.clear();
+}
+
+ContigAligner::ContigAligner(const std::string &contigs_file, const std::string &index_prefix, size_t nthreads)
+        : memopt_(mem_opt_init(), free),
+          idx_(nullptr, bwa_idx_destroy) {
+    bwa_verbose = 1;
+    memopt_->n_threads = int(nthreads);
+    // Supplementary alignments keep the whole read, as the primary ones
+    memopt_->flag |= MEM_F_SOFTCLIP;
+
+    INFO("Building bwa index of " << contigs_file);
+    bwa_idx_build(contigs_file.c_str(), index_prefix.c_str(), BWTALGO_AUTO, 10000000);
+    idx_.reset(bwa_idx_load(index_prefix.c_str(), BWA_IDX_ALL));
+    VERIFY_MSG(idx_, "Failed to load bwa index " << index_prefix);
+}
+
+ContigAligner::~ContigAligner() {}
+
+size_t ContigAligner::contig_count() const {
+    return size_t(idx_->bns->n_seqs);
+}
+
+std::string ContigAligner::contig_name(size_t contig) const {
+    return idx_->bns->anns[contig].name;
+}
+
+void ContigAligner::ProcessBatch(AlignmentBatch &batch, int64_t n_processed) const {
+    mem_opt_t opt = *memopt_;
+    if (batch.paired())
+        opt.flag |= MEM_F_PE;
+
+    size_t n = batch.seqs_.size();
+    std::vector<bseq1_t> seqs(n);
+    for (size_t i = 0; i < n; ++i) {
+        bseq1_t &s = seqs[i];
+        memset(&s, 0, sizeof(s));
+        s.l_seq = int(batch.seqs_[i].length());
+        s.seq = &batch.seqs_[i][0];
+        // Mates share the name, otherwise bwa complains
+        s.name = const_cast<char*>(batch.name(i).c_str());
+        s.id = int(i);
+    }
+
+    {
+        FormatterScope formatter;
+        mem_process_seqs(&opt, idx_->bwt, idx_->bns, idx_->pac, n_processed, int(n), seqs.data(), nullptr);
+    }
+
+    batch.buffers_.resize(n);
+    batch.hits_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        batch.buffers_[i] = seqs[i].sam;
+        ParseHits(seqs[i].sam, batch.hits_[i]);
+    }
+}
+
+void ContigAligner::AlignPaired(const std::string &left, const std::string &right,
+                                const BatchHandler &handler) const {
+    io::FileReadStream left_stream(left), right_stream(right);
+    size_t chunk_size = size_t(memopt_->chunk_size) * size_t(memopt_->n_threads);
+    int64_t n_processed = 0;
+    while (!left_stream.eof() && !right_stream.eof()) {
+        AlignmentBatch batch(true);
+        size_t bases = 0;
+        while (bases < chunk_size && !left_stream.eof() && !right_stream.eof()) {
+            io::SingleRead r1, r2;
+            left_stream >> r1;
+            right_stream >> r2;
+            batch.names_.push_back(SamName(r1.name(), true));
+            batch.seqs_.push_back(r1.GetSequenceString());
+            batch.seqs_.push_back(r2.GetSequenceString());
+            bases += r1.size() + r2.size();
+        }
+        ProcessBatch(batch, n_processed);
+        n_processed += int64_t(batch.size());
+        handler(batch);
+        DEBUG("Aligned " << n_processed / 2 << " read pairs");
+    }
+    if (!left_stream.eof() || !right_stream.eof())
+        WARN("Different number of reads in " << left << " and " << right << ", extra reads are ignored");
+}
+
+void ContigAligner::AlignSingle(const std::string &reads, const BatchHandler &handler) const {
+    io::FileReadStream stream(reads);
+    size_t chunk_size = size_t(memopt_->chunk_size) * size_t(memopt_->n_threads);
+    int64_t n_processed = 0;
+    while (!stream.eof()) {
+        AlignmentBatch batch(false);
+        size_t bases = 0;
+        while (bases < chunk_size && !stream.eof()) {
+            io::SingleRead r;
+            stream >> r;
+            batch.names_.push_back(SamName(r.name(), false));
+            batch.seqs_.push_back(r.GetSequenceString());
+            bases += r.size();
+        }
+        ProcessBatch(batch, n_processed);
+        n_processed += int64_t(batch.size());
+        handler(batch);
+        DEBUG("Aligned " << n_processed << " reads");
+    }
+}
+
+}
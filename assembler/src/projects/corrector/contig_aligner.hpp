@@ -0,0 +1,89 @@
+//***************************************************************************
+//* Copyright (c) 2015 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "contig_alignments.hpp"
+
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+struct bwaidx_s;
+typedef struct bwaidx_s bwaidx_t;
+
+struct mem_opt_s;
+typedef struct mem_opt_s mem_opt_t;
+};
+
+namespace corrector {
+
+// One alignment of a read, cigar and sequence point into the batch buffers
+// and are not necessarily aligned
+struct ContigHit {
+    int contig;
+    uint16_t sam_flag;
+    AlignedRead::Header header;
+    const char *cigar;
+    const char *seq;
+
+    bool is_primary() const {
+        return (sam_flag & 0x800) == 0;
+    }
+};
+
+// Alignments of a batch of reads, in paired mode mates are reads 2i and 2i + 1
+class AlignmentBatch {
+    friend class ContigAligner;
+
+    bool paired_;
+    std::vector<std::string> names_;
+    std::vector<std::string> seqs_;
+    std::vector<char*> buffers_;
+    std::vector<std::vector<ContigHit>> hits_;
+
+    void clear();
+public:
+    explicit AlignmentBatch(bool paired) : paired_(paired) {}
+    ~AlignmentBatch() { clear(); }
+
+    bool paired() const { return paired_; }
+    size_t size() const { return hits_.size(); }
+    const std::string &name(size_t i) const { return names_[paired_ ? i / 2 : i]; }
+    const std::vector<ContigHit> &hits(size_t i) const { return hits_[i]; }
+};
+
+// Aligns reads to contigs with the bundled bwa mem. Instead of SAM, bwa
+// produces compact binary records of mapped alignments with non-zero quality.
+class ContigAligner {
+public:
+    typedef std::function<void(const AlignmentBatch&)> BatchHandler;
+
+    // Index is built into the files with index_prefix
+    ContigAligner(const std::string &contigs_file, const std::string &index_prefix, size_t nthreads);
+    ~ContigAligner();
+
+    size_t contig_count() const;
+    std::string contig_name(size_t contig) const;
+
+    void AlignPaired(const std::string &left, const std::string &right, const BatchHandler &handler) const;
+    void AlignSingle(const std::string &reads, const BatchHandler &handler) const;
+
+private:
+    void ProcessBatch(AlignmentBatch &batch, int64_t n_processed) const;
+
+    std::unique_ptr<mem_opt_t, void(*)(void*)> memopt_;
+    std::unique_ptr<bwaidx_t, void(*)(bwaidx_t*)> idx_;
+
+    DECL_LOGGER("ContigAligner")
+};
+
+}
@@ -0,0 +1,169 @@
+//***************************************************************************
+//* Copyright (c) 2015 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace corrector {
+
+// Alignment of a read to a contig, cigar and sequence are encoded as in BAM
+struct AlignedRead {
+    // Next read in the storage is the mate, both mates are counted together
+    static const uint8_t kPairedWithNext = 1;
+    // Read from paired library, which mate is not aligned to the same contig
+    static const uint8_t kOrphanMate = 2;
+
+    struct Header {
+        int32_t pos;
+        uint32_t l_seq;
+        uint16_t n_cigar;
+        uint8_t mapq;
+        uint8_t flags;
+    };
+
+    Header header;
+    const uint32_t *cigar;
+    const uint8_t *seq;
+
+    int32_t pos() const { return header.pos; }
+    uint32_t map_qual() const { return header.mapq; }
+    int32_t data_len() const { return int32_t(header.l_seq); }
+    uint32_t cigar_len() const { return header.n_cigar; }
+    const uint32_t *cigar_ptr() const { return cigar; }
+    const uint8_t *seq_ptr() const { return seq; }
+    bool paired_with_next() const { return header.flags & kPairedWithNext; }
+    bool orphan_mate() const { return header.flags & kOrphanMate; }
+};
+
+// All alignments to one contig packed into a single buffer. The buffer can be
+// spilled to a file, later alignments are kept in memory after the spilled ones.
+class ContigAlignments {
+    std::vector<uint32_t> data_;
+    size_t size_;
+    std::string spill_file_;
+
+    // Alignments are read back from the spill file by blocks of this size
+    static const size_t kReadBlockWords = 1 << 20;
+
+    static size_t RecordWords(const AlignedRead::Header &h) {
+        return (sizeof(AlignedRead::Header) + 4 * h.n_cigar + (h.l_seq + 1) / 2 + 3) / 4;
+    }
+
+    // Collects complete records of data into chunks of at least chunk_size reads, mates are never
+    // separated. Unless at_end, a trailing read paired with the next one is left for the next call.
+    // Returns the number of words consumed, f is called for all collected reads before returning.
+    template<class F>
+    static size_t ParseRecords(const uint32_t *data, size_t words, bool at_end, size_t chunk_size,
+                               std::vector<AlignedRead> &chunk, F &f) {
+        const size_t header_words = (sizeof(AlignedRead::Header) + 3) / 4;
+        size_t i = 0, last_start = 0;
+        while (i + header_words <= words) {
+            AlignedRead read;
+            const char *src = (const char*)&data[i];
+            memcpy(&read.header, src, sizeof(read.header));
+            size_t record_words = RecordWords(read.header);
+            if (i + record_words > words)
+                break;
+            read.cigar = (const uint32_t*)(src + sizeof(read.header));
+            read.seq = (const uint8_t*)(read.cigar + read.header.n_cigar);
+            chunk.push_back(read);
+            last_start = i;
+            i += record_words;
+            if (chunk.size() >= chunk_size && !read.paired_with_next()) {
+                f(chunk);
+                chunk.clear();
+            }
+        }
+        if (!at_end && !chunk.empty() && chunk.back().paired_with_next()) {
+            chunk.pop_back();
+            i = last_start;
+        }
+        if (!chunk.empty()) {
+            f(chunk);
+            chunk.clear();
+        }
+        return i;
+    }
+
+public:
+    ContigAlignments() : size_(0) {}
+
+    // cigar and seq of length header.n_cigar and (header.l_seq + 1) / 2
+    void Add(const AlignedRead::Header &header, const void *cigar, const void *seq) {
+        size_t start = data_.size();
+        data_.resize(start + RecordWords(header), 0);
+        char *dst = (char*)&data_[start];
+        memcpy(dst, &header, sizeof(header));
+        dst += sizeof(header);
+        memcpy(dst, cigar, 4 * header.n_cigar);
+        dst += 4 * header.n_cigar;
+        memcpy(dst, seq, (header.l_seq + 1) / 2);
+        size_++;
+    }
+
+    // Appends alignments stored in memory to the file and frees the buffer.
+    // The same file should be passed for all spills of the contig.
+    void Spill(const std::string &file_name) {
+        VERIFY(spill_file_.empty() || spill_file_ == file_name);
+        spill_file_ = file_name;
+        if (data_.empty())
+            return;
+        std::ofstream out(file_name, std::ios_base::binary | std::ios_base::app);
+        out.write((const char*)data_.data(), data_.size() * sizeof(uint32_t));
+        VERIFY_MSG(out.good(), "Failed to write alignments to " << file_name);
+        std::vector<uint32_t>().swap(data_);
+    }
+
+    // Calls f for consecutive chunks of alignments in the order they were added.
+    // Alignments are valid only during the call, mates are always in the same chunk.
+    template<class F>
+    void ForEachChunk(size_t chunk_size, F f) const {
+        std::vector<AlignedRead> chunk;
+        if (!spill_file_.empty()) {
+            std::ifstream in(spill_file_, std::ios_base::binary);
+            VERIFY_MSG(in.good(), "Failed to read alignments from " << spill_file_);
+            std::vector<uint32_t> buf(kReadBlockWords);
+            size_t filled = 0;
+            bool at_end = false;
+            while (!at_end) {
+                if (filled == buf.size())
+                    buf.resize(2 * buf.size());
+                in.read((char*)(buf.data() + filled), (buf.size() - filled) * sizeof(uint32_t));
+                filled += size_t(in.gcount()) / sizeof(uint32_t);
+                at_end = in.eof();
+                size_t used = ParseRecords(buf.data(), filled, at_end, chunk_size, chunk, f);
+                std::copy(buf.begin() + used, buf.begin() + filled, buf.begin());
+                filled -= used;
+            }
+            VERIFY_MSG(filled == 0, "Truncated alignments file " << spill_file_);
+        }
+        ParseRecords(data_.data(), data_.size(), true, chunk_size, chunk, f);
+    }
+
+    size_t size() const { return size_; }
+
+    // Memory taken by the alignments which are not spilled
+    size_t memory() const { return data_.capacity() * sizeof(uint32_t); }
+
+    void clear() {
+        std::vector<uint32_t>().swap(data_);
+        size_ = 0;
+        if (!spill_file_.empty())
+            std::remove(spill_file_.c_str());
+        spill_file_.clear();
+    }
+};
+
+}
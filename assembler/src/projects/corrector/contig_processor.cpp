@@ -15,6 +15,8 @@
 #include "io/reads/single_read.hpp"
 #include "utils/filesystem/path_helper.hpp"
 
+#include <samtools/bam.h>
+
 #include <boost/algorithm/string.hpp>
 
 using namespace std;
@@ -38,29 +40,43 @@ void ContigProcessor::ReadContig() {
     charts_.resize(contig_.length());
 }
 
-void ContigProcessor::UpdateOneRead(const SingleSamRead &tmp, MappedSamStream &sm) {
-    unordered_map<size_t, position_description> all_positions;
-    if (tmp.contig_id() < 0) {
-        return;
+namespace {
+
+// Votes of a single read
+class ReadPileup {
+    PositionDescriptionMap &ps_;
+public:
+    explicit ReadPileup(PositionDescriptionMap &ps) : ps_(ps) {}
+
+    void AddVote(size_t pos, size_t variant, int weight) {
+        ps_[pos].votes[variant] += weight;
+    }
+
+    void AddInsertion(size_t pos, const string &insertion) {
+        ps_[pos].insertions[insertion] += 1;
     }
-    auto cur_s = sm.get_contig_name(tmp.contig_id());
-    if (contig_name_.compare(cur_s) != 0) {
-        return;
+};
+
+// Votes of all reads in the window [begin, end) of the contig, the rest are ignored
+class WindowPileup {
+    vector<position_description> &charts_;
+    size_t begin_;
+    size_t end_;
+public:
+    WindowPileup(vector<position_description> &charts, size_t begin, size_t end)
+            : charts_(charts), begin_(begin), end_(end) {}
+
+    void AddVote(size_t pos, size_t variant, int weight) {
+        if (pos >= begin_ && pos < end_)
+            charts_[pos].votes[variant] += weight;
     }
-    CountPositions(tmp, all_positions);
-    size_t error_num = 0;
 
-    for (auto &pos : all_positions) {
-        charts_[pos.first].update(pos.second);
-        if (pos.second.FoundOptimal(contig_[pos.first]) != var_to_pos[(int) contig_[pos.first]]) {
-            error_num++;
-        }
+    void AddInsertion(size_t pos, const string &insertion) {
+        if (pos >= begin_ && pos < end_)
+            charts_[pos].insertions[insertion] += 1;
     }
+};
 
-    if (error_num >= error_counts_.size())
-        error_counts_[error_counts_.size() - 1]++;
-    else
-        error_counts_[error_num]++;
 }
 
 //returns: number of changed nucleotides;
@@ -129,12 +145,9 @@ size_t ContigProcessor::UpdateOneBase(size_t i, stringstream &ss, const unordere
 }
 
 
-bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<size_t, position_description> &ps) const {
+template<class Pileup>
+bool ContigProcessor::CountVotes(const AlignedRead &read, Pileup &ps) const {
 
-    if (read.contig_id() < 0) {
-        DEBUG("not this contig");
-        return false;
-    }
     //TODO: maybe change to read.is_properly_aligned() ?
     if (read.map_qual() == 0) {
         DEBUG("zero qual");
@@ -142,7 +155,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
     }
     int pos = read.pos();
     if (pos < 0) {
-        WARN("Negative position " << pos << " found on read " << read.name() << ", skipping");
+        WARN("Negative position " << pos << " found on contig " << contig_name_ << ", skipping");
         return false;
     }
     size_t position = size_t(pos);
@@ -151,7 +164,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
     size_t l_cigar = read.cigar_len();
 
     int aligned_length = 0;
-    uint32_t *cigar = read.cigar_ptr();
+    const uint32_t *cigar = read.cigar_ptr();
     //* in cigar;
     if (l_cigar == 0)
         return false;
@@ -182,7 +195,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
             size_t ind = i + position - skipped - 1;
             if (ind >= contig_.length())
                 break;
-            ps[ind].insertions[insertion_string] += 1;
+            ps.AddInsertion(ind, insertion_string);
             insertion_string = "";
         }
         char cur_state = bam_cigar_opchr(cigar[state_pos]);
@@ -190,7 +203,6 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
             VERIFY(i >= deleted);
             if (i + position < skipped) {
                 WARN(i << " " << position << " " << skipped);
-                INFO(read.name());
             }
             VERIFY(i + position >= skipped);
 
@@ -198,7 +210,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
             size_t cur = var_to_pos[(int) bam_nt16_rev_table[bam1_seqi(seq, i - deleted)]];
             if (ind >= contig_.length())
                 continue;
-            ps[ind].votes[cur] = ps[ind].votes[cur] + mate;
+            ps.AddVote(ind, cur, mate);
 
         } else {
             if (cur_state == 'I' || cur_state == 'H' || cur_state == 'S' ) {
@@ -207,7 +219,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
                         size_t ind = i + position - skipped - 1;
                         if (ind >= contig_.length())
                             break;
-                        ps[ind].votes[Variants::Insertion] += mate;
+                        ps.AddVote(ind, Variants::Insertion, mate);
                     }
                     insertion_string += bam_nt16_rev_table[bam1_seqi(seq, i - deleted)];
                 }
@@ -215,7 +227,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
             } else if (bam_cigar_opchr(cigar[state_pos]) == 'D') {
                 if (i + position - skipped >= contig_.length())
                     break;
-                ps[i + position - skipped].votes[Variants::Deletion] += mate;
+                ps.AddVote(i + position - skipped, Variants::Deletion, mate);
                 deleted += 1;
             }
         }
@@ -224,7 +236,7 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
         VERIFY(l_read + position >= skipped + 1);
         size_t ind = l_read + position - skipped - 1;
         if (ind < contig_.length()) {
-            ps[ind].insertions[insertion_string] += 1;
+            ps.AddInsertion(ind, insertion_string);
         }
         insertion_string = "";
     }
@@ -232,12 +244,18 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
 }
 
 
-bool ContigProcessor::CountPositions(const PairedSamRead &read, unordered_map<size_t, position_description> &ps) const {
+bool ContigProcessor::CountPositions(const AlignedRead &read, unordered_map<size_t, position_description> &ps) const {
+    ReadPileup pileup(ps);
+    return CountVotes(read, pileup);
+}
+
+bool ContigProcessor::CountPositions(const AlignedRead &left, const AlignedRead &right,
+                                     unordered_map<size_t, position_description> &ps) const {
 
     TRACE("starting pairing");
-    bool t1 = CountPositions(read.Left(), ps );
+    bool t1 = CountPositions(left, ps );
     unordered_map<size_t, position_description> tmp;
-    bool t2 = CountPositions(read.Right(), tmp);
+    bool t2 = CountPositions(right, tmp);
     //overlaps.. multimap? Look on qual?
     if (ps.size() == 0 || tmp.size() == 0) {
         //We do not need paired reads which are not really paired
@@ -250,18 +268,70 @@ bool ContigProcessor::CountPositions(const PairedSamRead &read, unordered_map<si
     return (t1 && t2);
 }
 
-size_t ContigProcessor::ProcessMultipleSamFiles() {
-    error_counts_.resize(kMaxErrorNum);
-    for (const auto &sf : sam_files_) {
-        MappedSamStream sm(sf.first);
-        while (!sm.eof()) {
-            SingleSamRead tmp;
-            sm >> tmp;
+void ContigProcessor::FillCharts(const vector<AlignedRead> &reads) {
+    size_t len = contig_.length();
+    size_t window = std::max(kMinWindowSize, (len + nthreads_ * kWindowsPerThread - 1) / (nthreads_ * kWindowsPerThread));
+    size_t window_num = (len + window - 1) / window;
 
-            UpdateOneRead(tmp, sm);
+    // Votes of a read are within [pos - 1, pos + read length), reads crossing
+    // the window border are counted by both windows, each keeps its own votes
+    vector<vector<size_t>> window_reads(window_num);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        if (reads[i].pos() < 0) {
+            WARN("Negative position " << reads[i].pos() << " found on contig " << contig_name_ << ", skipping");
+            continue;
         }
-        sm.close();
+        size_t begin = reads[i].pos() > 0 ? size_t(reads[i].pos() - 1) : 0;
+        size_t end = std::min(len, size_t(reads[i].pos()) + reads[i].data_len());
+        if (begin >= end)
+            continue;
+        for (size_t w = begin / window; w <= (end - 1) / window; ++w)
+            window_reads[w].push_back(i);
     }
+
+#   pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 1)
+    for (size_t w = 0; w < window_num; ++w) {
+        WindowPileup pileup(charts_, w * window, std::min(len, (w + 1) * window));
+        for (size_t i : window_reads[w])
+            CountVotes(reads[i], pileup);
+    }
+}
+
+void ContigProcessor::FillInterestingReads(const vector<AlignedRead> &reads) {
+    // Mates are stored one after another, reads with the mate on other contig are skipped
+    vector<pair<size_t, size_t>> units;
+    for (size_t i = 0; i < reads.size(); ++i) {
+        if (reads[i].paired_with_next() && i + 1 < reads.size()) {
+            units.push_back(make_pair(i, i + 1));
+            ++i;
+        } else if (!reads[i].orphan_mate()) {
+            units.push_back(make_pair(i, i));
+        }
+    }
+
+    // Positions are counted in parallel, but passed to ipp_ in the order of reads
+    vector<PositionDescriptionMap> chunk;
+    for (size_t start = 0; start < units.size(); start += kReadChunkSize) {
+        size_t chunk_size = std::min(kReadChunkSize, units.size() - start);
+        chunk.assign(chunk_size, PositionDescriptionMap());
+#       pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 64)
+        for (size_t j = 0; j < chunk_size; ++j) {
+            const auto &unit = units[start + j];
+            if (unit.first == unit.second)
+                CountPositions(reads[unit.first], chunk[j]);
+            else
+                CountPositions(reads[unit.first], reads[unit.second], chunk[j]);
+        }
+        for (const auto &ps : chunk)
+            ipp_.UpdateInterestingRead(ps);
+    }
+}
+
+size_t ContigProcessor::ProcessAlignments() {
+    // Alignments are passed twice by chunks, so that only a chunk of them is loaded at a time
+    alignments_.ForEachChunk(kReadChunkSize, [&](const vector<AlignedRead> &reads) {
+        FillCharts(reads);
+    });
     size_t total_coverage = 0;
     for (const auto &pos: charts_)
         total_coverage += pos.TotalMapped();
@@ -276,23 +346,9 @@ size_t ContigProcessor::ProcessMultipleSamFiles() {
                << " setting interesting positions heuristics to " << interesting_weight_cutoff);
     }
     ipp_.FillInterestingPositions(charts_);
-    for (const auto &sf : sam_files_) {
-        MappedSamStream sm(sf.first);
-        while (!sm.eof()) {
-            unordered_map<size_t, position_description> ps;
-            if (sf.second == io::LibraryType::PairedEnd ) {
-                PairedSamRead tmp;
-                sm >> tmp;
-                CountPositions(tmp, ps);
-            } else {
-                SingleSamRead tmp;
-                sm >> tmp;
-                CountPositions(tmp, ps);
-            }
-            ipp_.UpdateInterestingRead(ps);
-        }
-        sm.close();
-    }
+    alignments_.ForEachChunk(kReadChunkSize, [&](const vector<AlignedRead> &reads) {
+        FillInterestingReads(reads);
+    });
     ipp_.UpdateInterestingPositions();
     unordered_map<size_t, position_description> interesting_positions = ipp_.get_weights();
     stringstream s_new_contig;
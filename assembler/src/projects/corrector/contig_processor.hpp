@@ -15,51 +15,52 @@
 #pragma once
 #include "interesting_pos_processor.hpp"
 #include "positional_read.hpp"
+#include "contig_alignments.hpp"
 #include "utils/parallel/openmp_wrapper.h"
 
-#include <io/sam/sam_reader.hpp>
-#include <io/sam/read.hpp>
-#include "pipeline/library.hpp"
-
 #include <string>
 #include <vector>
 #include <unordered_map>
 
 namespace corrector {
 
-using namespace sam_reader;
-
-typedef std::vector<std::pair<std::string, io::LibraryType> > sam_files_type;
 class ContigProcessor {
-    sam_files_type sam_files_;
+    const ContigAlignments &alignments_;
     std::string contig_file_;
     std::string contig_name_;
     std::string output_contig_file_;
     std::string contig_;
     std::vector<position_description> charts_;
     InterestingPositionProcessor ipp_;
-    std::vector<int> error_counts_;
+    size_t nthreads_;
 
-    const size_t kMaxErrorNum = 20;
+    // Windows of the contig are filled in parallel, each by a single thread
+    const size_t kMinWindowSize = 10000;
+    const size_t kWindowsPerThread = 4;
+    // Alignments are loaded by chunks, reads of a chunk are counted in parallel
+    const size_t kReadChunkSize = 100000;
     int interesting_weight_cutoff;
 protected:
     DECL_LOGGER("ContigProcessor")
 public:
-    ContigProcessor(const sam_files_type &sam_files, const std::string &contig_file)
-            : sam_files_(sam_files), contig_file_(contig_file) {
+    ContigProcessor(const ContigAlignments &alignments, const std::string &contig_file, size_t nthreads = 1)
+            : alignments_(alignments), contig_file_(contig_file), nthreads_(nthreads) {
         ReadContig();
         ipp_.set_contig(contig_);
 //At least three reads to believe in inexact repeats heuristics.
         interesting_weight_cutoff = 2;
     }
-    size_t ProcessMultipleSamFiles();
+    size_t ProcessAlignments();
 private:
     void ReadContig();
 //Moved from read.hpp
-    bool CountPositions(const SingleSamRead &read, std::unordered_map<size_t, position_description> &ps) const;
-    bool CountPositions(const PairedSamRead &read, std::unordered_map<size_t, position_description> &ps) const;
+    template<class Pileup>
+    bool CountVotes(const AlignedRead &read, Pileup &ps) const;
+    bool CountPositions(const AlignedRead &read, std::unordered_map<size_t, position_description> &ps) const;
+    bool CountPositions(const AlignedRead &left, const AlignedRead &right, std::unordered_map<size_t, position_description> &ps) const;
 
-    void UpdateOneRead(const SingleSamRead &tmp, MappedSamStream &sm);
+    void FillCharts(const std::vector<AlignedRead> &reads);
+    void FillInterestingReads(const std::vector<AlignedRead> &reads);
     //returns: number of changed nucleotides;
 
     size_t UpdateOneBase(size_t i, std::stringstream &ss, const std::unordered_map<size_t, position_description> &interesting_positions) const ;
@@ -15,22 +15,13 @@
 #include "io/reads/osequencestream.hpp"
 #include "utils/parallel/openmp_wrapper.h"
 
-#include <boost/algorithm/string.hpp>
+#include <samtools/bam.h>
 
 #include <iostream>
-#include <unistd.h>
 
 using namespace std;
 
 namespace corrector {
-std::string DatasetProcessor::GetLibDir(const size_t lib_count) {
-    if (lib_dirs_.find(lib_count) != lib_dirs_.end())
-        return lib_dirs_[lib_count];
-    std::string res = fs::make_temp_dir(corr_cfg::get().work_dir, "lib" + to_string(lib_count));
-    lib_dirs_[lib_count] = res;
-    return res;
-}
-
 void DatasetProcessor::SplitGenome(const string &genome_splitted_dir) {
     io::FileReadStream frs(genome_file_);
     size_t cur_id = 0;
@@ -44,150 +35,147 @@ void DatasetProcessor::SplitGenome(const string &genome_splitted_dir) {
         }
         string full_path = fs::append_path(genome_splitted_dir, contig_name + ".fasta");
         string out_full_path = fs::append_path(genome_splitted_dir, contig_name + ".ref.fasta");
-        string sam_filename = fs::append_path(genome_splitted_dir, contig_name + ".pair.sam");
-        all_contigs_[contig_name] = {full_path, out_full_path, contig_seq.length(), sam_files_type(), sam_filename, cur_id};
+        all_contigs_[contig_name] = {full_path, out_full_path, contig_seq.length(), cur_id};
         cur_id ++;
-        buffered_reads_[contig_name].clear();
         io::OFastaReadStream oss(full_path);
         oss << io::SingleRead(contig_name, contig_seq);
         DEBUG("full_path " + full_path)
     }
+    alignments_.resize(cur_id);
 }
 
-//contigs - set of aligned contig names
-void DatasetProcessor::GetAlignedContigs(const string &read, set<string> &contigs) const {
-    vector<string> arr;
-    boost::split(arr, read, boost::is_any_of("\t"));
-    if (arr.size() > 5) {
-        if (arr[2] != "*" && stoi(arr[4]) > 0) {
-// here can be multuple aligned parsing if neeeded;
-            contigs.insert(arr[2]);
-        }
+void DatasetProcessor::MapContigIds(const ContigAligner &aligner) {
+    contig_ids_.resize(aligner.contig_count());
+    contig_names_.resize(aligner.contig_count());
+    for (size_t i = 0; i < aligner.contig_count(); ++i) {
+        string contig = aligner.contig_name(i);
+        VERIFY_MSG(all_contigs_.find(contig) != all_contigs_.end(), "wrong contig name in bwa index: " + contig);
+        contig_ids_[i] = all_contigs_[contig].id;
+        contig_names_[i] = contig;
     }
-
 }
 
-void DatasetProcessor::SplitSingleLibrary(const string &all_reads_filename, const size_t lib_count) {
-    ifstream fs(all_reads_filename);
-    while (!fs.eof()) {
-        set<string> contigs;
-        string r1;
-        getline(fs, r1);
-        if (r1[0] == '@')
-            continue;
-        GetAlignedContigs(r1, contigs);
-        for (auto &contig : contigs) {
-            VERIFY_MSG(all_contigs_.find(contig) != all_contigs_.end(), "wrong contig name in SAM file header: " + contig);
-            BufferedOutputRead(r1, contig, lib_count);
-        }
+static const ContigHit *PrimaryHit(const vector<ContigHit> &hits) {
+    for (const auto &hit : hits) {
+        if (hit.is_primary())
+            return &hit;
     }
-    FlushAll(lib_count);
+    return nullptr;
 }
 
-void DatasetProcessor::FlushAll(const size_t lib_count) {
-    for (const auto &ac : all_contigs_) {
-        if (buffered_reads_[ac.first].size() > 0) {
-            ofstream stream(ac.second.sam_filenames[lib_count].first.c_str(), std::ios_base::app | std::ios_base::out);
-            for (const string &read : buffered_reads_[ac.first]) {
-                stream << read;
-                stream << '\n';
+void DatasetProcessor::StoreAlignments(const AlignmentBatch &batch, bool count_pairs) {
+    // Contigs are sharded between threads by id, so alignments of every contig
+    // are stored by a single thread in the order of reads
+    size_t shards = nthreads_;
+    auto alignments_ptr = &alignments_;
+# pragma omp parallel for shared(alignments_ptr) num_threads(nthreads_) schedule(static, 1)
+    for (size_t shard = 0; shard < shards; ++shard) {
+        auto store = [&](const ContigHit &hit, uint8_t flags) {
+            size_t id = contig_ids_[hit.contig];
+            if (id % shards != shard)
+                return;
+            AlignedRead::Header header = hit.header;
+            header.flags = flags;
+            (*alignments_ptr)[id].Add(header, hit.cigar, hit.seq);
+        };
+        if (count_pairs) {
+            for (size_t i = 0; i + 1 < batch.size(); i += 2) {
+                const ContigHit *h1 = PrimaryHit(batch.hits(i));
+                const ContigHit *h2 = PrimaryHit(batch.hits(i + 1));
+                bool together = h1 && h2 && h1->contig == h2->contig;
+                if (together) {
+                    store(*h1, AlignedRead::kPairedWithNext);
+                    store(*h2, 0);
+                }
+                for (size_t j = i; j < i + 2; ++j) {
+                    for (const auto &hit : batch.hits(j)) {
+                        if (!together || !hit.is_primary())
+                            store(hit, AlignedRead::kOrphanMate);
+                    }
+                }
+            }
+        } else {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                for (const auto &hit : batch.hits(i))
+                    store(hit, 0);
             }
-            buffered_reads_[ac.first].clear();
         }
     }
+    for (size_t i = 0; i < batch.size(); ++i)
+        aligned_count_ += batch.hits(i).size();
 }
 
-void DatasetProcessor::BufferedOutputRead(const string &read, const string &contig_name, const size_t lib_count) {
-    buffered_reads_[contig_name].push_back(read);
-    buffered_count_++;
-    if (buffered_count_ % kBuffSize == 0) {
-        if (buffered_count_ % (10 * kBuffSize) == 0)
-            INFO("processed " << buffered_count_ << "reads, flushing");
-        FlushAll(lib_count);
-    }
+void DatasetProcessor::SpillAlignmentsIfNeeded() {
+    size_t memory = 0;
+    for (const auto &alignments : alignments_)
+        memory += alignments.memory();
+    if (memory < (size_t(corr_cfg::get().max_alignments_memory) << 20))
+        return;
+    INFO("Alignments take " << (memory >> 20) << " Mb, spilling them to " << work_dir_);
+    auto alignments_ptr = &alignments_;
+# pragma omp parallel for shared(alignments_ptr) num_threads(nthreads_) schedule(dynamic, 64)
+    for (size_t id = 0; id < alignments_ptr->size(); ++id)
+        (*alignments_ptr)[id].Spill(fs::append_path(work_dir_, "alignments_" + to_string(id)));
 }
 
-void DatasetProcessor::SplitPairedLibrary(const string &all_reads_filename, const size_t lib_count) {
-    ifstream fs(all_reads_filename);
-    while (!fs.eof()) {
-        set<string> contigs;
-        string r1;
-        string r2;
-        getline(fs, r1);
-        if (r1[0] == '@')
-            continue;
-        getline(fs, r2);
-        GetAlignedContigs(r1, contigs);
-        GetAlignedContigs(r2, contigs);
-        for (const auto &contig : contigs) {
-            VERIFY_MSG(all_contigs_.find(contig) != all_contigs_.end(), "wrong contig name in SAM file header: " + contig);
-            if (all_contigs_.find(contig) != all_contigs_.end()) {
-                BufferedOutputRead(r1, contig, lib_count);
-                BufferedOutputRead(r2, contig, lib_count);
+void DatasetProcessor::DumpSam(const AlignmentBatch &batch, ofstream &sam) const {
+    static const char kNt16[] = "=ACMGRSVTWYHKDBN";
+    for (size_t i = 0; i < batch.size(); ++i) {
+        for (const auto &hit : batch.hits(i)) {
+            sam << batch.name(i) << '\t' << hit.sam_flag << '\t' << contig_names_[hit.contig] << '\t'
+                << hit.header.pos + 1 << '\t' << unsigned(hit.header.mapq) << '\t';
+            for (size_t j = 0; j < hit.header.n_cigar; ++j) {
+                uint32_t op;
+                memcpy(&op, hit.cigar + 4 * j, sizeof(op));
+                sam << bam_cigar_oplen(op) << bam_cigar_opchr(op);
             }
+            sam << "\t*\t0\t0\t";
+            const uint8_t *seq = (const uint8_t*)hit.seq;
+            for (size_t j = 0; j < hit.header.l_seq; ++j)
+                sam << kNt16[bam1_seqi(seq, j)];
+            sam << "\t*\n";
         }
     }
-    FlushAll(lib_count);
 }
 
-string DatasetProcessor::RunPairedBwa(const string &left, const string &right, const size_t lib)  {
-    string cur_dir = GetLibDir(lib);
-    int run_res = 0;
-    string tmp_sam_filename = fs::append_path(cur_dir, "tmp.sam");
-    string bwa_string = fs::screen_whitespaces(fs::screen_whitespaces(corr_cfg::get().bwa));
-    string genome_screened = fs::screen_whitespaces(genome_file_);
-    string index_line = bwa_string + string(" index ") + "-a " + "is " + genome_screened ;
-    INFO("Running bwa index ...: " << index_line);
-    run_res = system(index_line.c_str());
-    if (run_res != 0) {
-        INFO("bwa failed, skipping sublib");
-        return "";
-    }
-    string nthreads_str = to_string(nthreads_);
-    string last_line = bwa_string + string(" mem ") + " -v 1 -t " + nthreads_str + " "+ genome_screened + " " + fs::screen_whitespaces(left) + " " + fs::screen_whitespaces(right)  + "  > "
-            + fs::screen_whitespaces(tmp_sam_filename) ;
-    INFO("Running bwa mem ...:" << last_line);
-    run_res = system(last_line.c_str());
-    if (run_res != 0) {
-        INFO("bwa failed, skipping sublib");
-        return "";
-    }
-    return tmp_sam_filename;
+void DatasetProcessor::AlignLibrary(const ContigAligner &aligner, const string &left, const string &right,
+                                    io::LibraryType lib_type, const size_t lib_count) {
+    ofstream sam;
+    if (corr_cfg::get().dump_sam) {
+        // Work directory is removed after the run, so the alignments go to the output one
+        string sam_filename = fs::append_path(corr_cfg::get().output_dir, "alignments_lib" + to_string(lib_count) + ".sam");
+        INFO("Writing alignments to " << sam_filename);
+        sam.open(sam_filename);
+        for (const auto &contig : contig_names_)
+            sam << "@SQ\tSN:" << contig << "\tLN:" << all_contigs_[contig].contig_length << '\n';
+    }
+    // Only paired-end reads are counted in pairs, mate-pairs are counted read by read
+    bool count_pairs = !right.empty() && lib_type == io::LibraryType::PairedEnd;
+    auto handler = [&](const AlignmentBatch &batch) {
+        StoreAlignments(batch, count_pairs);
+        SpillAlignmentsIfNeeded();
+        if (sam.is_open())
+            DumpSam(batch, sam);
+    };
+    if (right.empty())
+        aligner.AlignSingle(left, handler);
+    else
+        aligner.AlignPaired(left, right, handler);
+    INFO(aligned_count_ << " alignments stored so far");
 }
 
-string DatasetProcessor::RunSingleBwa(const string &single, const size_t lib)  {
-    int run_res = 0;
-    string cur_dir = GetLibDir(lib);
-    string tmp_sam_filename = fs::append_path(cur_dir, "tmp.sam");
-    string bwa_string = fs::screen_whitespaces(fs::screen_whitespaces(corr_cfg::get().bwa));
-    string genome_screened = fs::screen_whitespaces(genome_file_);
-    string index_line = bwa_string + string(" index ") + "-a " + "is " + genome_screened ;
-    INFO("Running bwa index ...: " << index_line);
-    run_res = system(index_line.c_str());
-    if (run_res != 0) {
-        INFO("bwa failed, skipping sublib");
-        return "";
-    }
-    string nthreads_str = to_string(nthreads_);
-    string last_line = bwa_string + " mem "+ " -v 1 -t " + nthreads_str + " " + genome_screened + " "  + fs::screen_whitespaces(single)  + "  > " + fs::screen_whitespaces(tmp_sam_filename);
-    INFO("Running bwa mem ...:" << last_line);
-    run_res = system(last_line.c_str());
-    if (run_res != 0) {
-        INFO("bwa failed, skipping sublib");
-        return "";
-    }
-    return tmp_sam_filename;
-}
-
-void DatasetProcessor::PrepareContigDirs(const size_t lib_count) {
-    string out_dir = GetLibDir(lib_count);
-    for (auto &ac : all_contigs_) {
-        auto contig_name = ac.first;
-        string out_name = fs::append_path(out_dir, contig_name + ".sam");
-        ac.second.sam_filenames.push_back(make_pair(out_name, unsplitted_sam_files_[lib_count].second));
-        BufferedOutputRead("@SQ\tSN:" + contig_name + "\tLN:" + to_string(all_contigs_[contig_name].contig_length), contig_name, lib_count);
+void DatasetProcessor::ProcessContig(const string &contig_name, size_t nthreads) {
+    const auto &contig = all_contigs_.at(contig_name);
+    bool long_enough = contig.contig_length > kMinContigLengthForInfo;
+    ContigProcessor pc(alignments_[contig.id], contig.input_contig_filename, nthreads);
+    size_t changes = pc.ProcessAlignments();
+    alignments_[contig.id].clear();
+    if (long_enough) {
+#pragma omp critical
+        {
+            INFO("Contig " << contig_name << " processed with " << changes << " changes in thread " << omp_get_thread_num());
+        }
     }
-    FlushAll(lib_count);
 }
 
 void DatasetProcessor::ProcessDataset() {
@@ -195,6 +183,8 @@ void DatasetProcessor::ProcessDataset() {
     INFO("Splitting assembly...");
     INFO("Assembly file: " + genome_file_);
     SplitGenome(work_dir_);
+    ContigAligner aligner(genome_file_, fs::append_path(work_dir_, "contigs_index"), nthreads_);
+    MapContigIds(aligner);
     for (size_t i = 0; i < corr_cfg::get().dataset.lib_count(); ++i) {
         const auto& dataset = corr_cfg::get().dataset[i];
         auto lib_type = dataset.type();
@@ -204,31 +194,15 @@ void DatasetProcessor::ProcessDataset() {
                 string left = iter->first;
                 string right = iter->second;
                 INFO(left + " " + right);
-                string samf = RunPairedBwa(left, right, lib_num);
-                if (samf != "") {
-                    INFO("Adding samfile " << samf);
-                    unsplitted_sam_files_.push_back(make_pair(samf, lib_type));
-                    PrepareContigDirs(lib_num);
-                    SplitPairedLibrary(samf, lib_num);
-                    lib_num++;
-                } else {
-                    FATAL_ERROR("Failed to align paired reads " << left << " and " << right);
-                }
+                AlignLibrary(aligner, left, right, lib_type, lib_num);
+                lib_num++;
             }
             for (auto iter = dataset.single_begin(); iter != dataset.single_end(); iter++) {
                 INFO("Processing single sublib of number " << lib_num);
                 string left = *iter;
                 INFO(left);
-                string samf = RunSingleBwa(left, lib_num);
-                if (samf != "") {
-                    INFO("Adding samfile " << samf);
-                    unsplitted_sam_files_.push_back(make_pair(samf, io::LibraryType::SingleReads));
-                    PrepareContigDirs(lib_num);
-                    SplitSingleLibrary(samf, lib_num);
-                    lib_num++;
-                } else {
-                    FATAL_ERROR("Failed to align single reads " << left);
-                }
+                AlignLibrary(aligner, left, "", io::LibraryType::SingleReads, lib_num);
+                lib_num++;
             }
         }
     }
@@ -239,18 +213,20 @@ void DatasetProcessor::ProcessDataset() {
     }
     size_t cont_num = ordered_contigs.size();
     sort(ordered_contigs.begin(), ordered_contigs.end(), std::greater<pair<size_t, string> >());
-    auto all_contigs_ptr = &all_contigs_;
-# pragma omp parallel for shared(all_contigs_ptr, ordered_contigs) num_threads(nthreads_) schedule(dynamic,1)
-    for (size_t i = 0; i < cont_num; i++) {
-        bool long_enough = (*all_contigs_ptr)[ordered_contigs[i].second].contig_length > kMinContigLengthForInfo;
-        ContigProcessor pc((*all_contigs_ptr)[ordered_contigs[i].second].sam_filenames, (*all_contigs_ptr)[ordered_contigs[i].second].input_contig_filename);
-        size_t changes = pc.ProcessMultipleSamFiles();
-        if (long_enough) {
-#pragma omp critical
-            {
-                INFO("Contig " << ordered_contigs[i].second << " processed with " << changes << " changes in thread " << omp_get_thread_num());
-            }
-        }
+    size_t total_length = 0;
+    for (const auto &contig : ordered_contigs)
+        total_length += contig.first;
+    // Contigs which would take a thread for the most of the time are processed
+    // one by one with all threads, the rest are processed in parallel
+    size_t large_num = 0;
+    while (large_num < cont_num && ordered_contigs[large_num].first >= kMinContigLengthForParallel &&
+           ordered_contigs[large_num].first * nthreads_ >= total_length)
+        large_num++;
+    for (size_t i = 0; i < large_num; i++)
+        ProcessContig(ordered_contigs[i].second, nthreads_);
+# pragma omp parallel for shared(ordered_contigs) num_threads(nthreads_) schedule(dynamic,1)
+    for (size_t i = large_num; i < cont_num; i++) {
+        ProcessContig(ordered_contigs[i].second, 1);
     }
     INFO("Gluing processed contigs");
     GlueSplittedContigs(output_contig_file_);
@@ -7,12 +7,16 @@
 
 #pragma once
 
+#include "contig_aligner.hpp"
+#include "contig_alignments.hpp"
+
 #include "utils/filesystem/path_helper.hpp"
 
 #include "io/reads/file_reader.hpp"
 
 #include "pipeline/library.hpp"
 
+#include <fstream>
 #include <string>
 #include <set>
 #include <vector>
@@ -20,14 +24,10 @@
 
 namespace corrector {
 
-typedef std::vector<std::pair<std:: string, io::LibraryType> > sam_files_type;
-
 struct OneContigDescription {
     std::string input_contig_filename;
     std::string output_contig_filename;
     size_t contig_length;
-    sam_files_type sam_filenames;
-    std::string sam_filename;
     size_t id;
 };
 typedef std::unordered_map<std::string, OneContigDescription> ContigInfoMap;
@@ -37,14 +37,17 @@ class DatasetProcessor {
     const std::string &genome_file_;
     std::string output_contig_file_;
     ContigInfoMap all_contigs_;
-    sam_files_type unsplitted_sam_files_;
+    // Alignments of all libraries, by contig id. They are kept in memory until
+    // max_alignments_memory is exceeded, then all buffers are spilled to the work dir.
+    std::vector<ContigAlignments> alignments_;
+    // bwa reference index -> contig id
+    std::vector<size_t> contig_ids_;
+    std::vector<std::string> contig_names_;
     const std::string &work_dir_;
-    std::unordered_map<std::string, std::vector<std::string> > buffered_reads_;
     size_t nthreads_;
-    size_t buffered_count_;
-    std::unordered_map<size_t, std::string> lib_dirs_;
-    const size_t kBuffSize = 100000;
+    size_t aligned_count_;
     const size_t kMinContigLengthForInfo = 20000;
+    const size_t kMinContigLengthForParallel = 100000;
 
 protected:
     DECL_LOGGER("DatasetProcessor")
@@ -53,22 +56,20 @@ public:
     DatasetProcessor(const std::string &genome_file, const std::string &work_dir, const std::string &output_dir, const size_t &thread_num)
             : genome_file_(genome_file), work_dir_(work_dir), nthreads_(thread_num) {
         output_contig_file_ = fs::append_path(output_dir, "corrected_contigs.fasta");
-        buffered_count_ = 0;
+        aligned_count_ = 0;
     }
 
     void ProcessDataset();
 private:
     void SplitGenome(const std::string &genome_splitted_dir);
-    void FlushAll(const size_t lib_count);
-    void BufferedOutputRead(const std::string &read, const std::string &contig_name, const size_t lib_count);
-    void GetAlignedContigs(const std::string &read, std::set<std::string> &contigs) const;
-    void SplitSingleLibrary(const std::string &out_contigs_filename, const size_t lib_count);
-    void SplitPairedLibrary(const std::string &all_reads, const size_t lib_count);
+    void MapContigIds(const ContigAligner &aligner);
+    void StoreAlignments(const AlignmentBatch &batch, bool count_pairs);
+    void SpillAlignmentsIfNeeded();
+    void DumpSam(const AlignmentBatch &batch, std::ofstream &sam) const;
+    void AlignLibrary(const ContigAligner &aligner, const std::string &left, const std::string &right,
+                      io::LibraryType lib_type, const size_t lib_count);
+    void ProcessContig(const std::string &contig_name, size_t nthreads);
     void GlueSplittedContigs(std::string &out_contigs_filename);
-    std::string RunPairedBwa(const std::string &left, const std::string &right, const size_t lib);
-    std::string RunSingleBwa(const std::string &single, const size_t lib);
-    void PrepareContigDirs(const size_t lib_count);
-    std::string GetLibDir(const size_t lib_count);
 };
 }
 ;
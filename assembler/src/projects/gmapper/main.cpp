@@ -88,12 +88,14 @@ std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(const conj_graph_pack&
                                                           const SequencingLib& library) {
     if (library.type() == io::LibraryType::MatePairs) {
         INFO("Mapping mate pairs using BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g, alignment::BWAIndex::AlignmentMode::Default, 0,
+                                                                 fs::append_path(gp.workdir, "bwa_index"));
     }
 
     if (library.data().unmerged_read_length < gp.k_value && library.type() == io::LibraryType::PairedEnd) {
         INFO("Mapping PE reads shorter than K with BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g, alignment::BWAIndex::AlignmentMode::Default, 0,
+                                                                 fs::append_path(gp.workdir, "bwa_index"));
     }
 
     INFO("Selecting usual mapper");
@@ -146,10 +148,10 @@ static bool ends_with(const std::string &s, const std::string &p) {
 
 void LoadGraph(debruijn_graph::ConjugateDeBruijnGraph &graph, const std::string &filename) {
     using namespace debruijn_graph;
-    if (ends_with(filename, ".gfa")) {
+    if (ends_with(filename, ".gfa") || ends_with(filename, ".gfa.gz")) {
         gfa::GFAReader gfa(filename);
-        INFO("GFA segments: " << gfa.num_edges() << ", links: " << gfa.num_links());
         gfa.to_graph(graph);
+        INFO("GFA segments: " << gfa.num_edges() << ", links: " << gfa.num_links());
     } else {
         graphio::ScanBasicGraph(filename, graph);
     }
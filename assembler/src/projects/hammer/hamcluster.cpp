@@ -14,7 +14,11 @@
 #include "config_struct_hammer.hpp"
 #include "globals.hpp"
 
+#include "utils/memory_limit.hpp"
+
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 class EncoderKMer {
@@ -38,30 +42,52 @@ struct SubKMerComparator {
     }
 };
 
-template<class Op>
-std::pair<size_t, size_t> SubKMerSplitter::split(Op &&op) {
-  std::vector<SubKMer> data; std::vector<size_t> blocks;
+using PairSort = parallel_radix_sort::PairSort<SubKMer, size_t, SubKMer, EncoderKMer>;
+
+// Sorts the k-mer indices by their sub-k-mers and returns the bounds of the
+// blocks of equal sub-k-mers
+static std::vector<size_t> SplitBySubKMers(std::vector<size_t> &blocks, std::vector<SubKMer> &data,
+                                           int nthreads) {
+  PairSort::InitAndSort(data.data(), blocks.data(), data.size(), data.size() > 1000*16 ? nthreads : 1);
+
+  std::vector<size_t> bounds(1, 0);
+  for (auto start = data.begin(), end = data.end(); start != end;) {
+    auto chunk_end = std::upper_bound(start + 1, end, *start, SubKMerComparator());
+    bounds.push_back(chunk_end - data.begin());
+    start = chunk_end;
+  }
+
+  return bounds;
+}
+
+template<class Result, class Op, class Merge>
+size_t SubKMerSplitter::split(Op &&op, Merge &&merge, unsigned nthreads) {
+  std::vector<std::vector<SubKMer>> data;
+  std::vector<std::vector<size_t>> blocks;
 
   MMappedReader bifs(bifname_, /* unlink */ true);
   MMappedReader kifs(kifname_, /* unlink */ true);
-  size_t icnt = 0, ocnt = 0;
+  size_t icnt = 0;
   while (bifs.good()) {
-    deserialize(blocks, data, bifs, kifs);
+    // Read a batch of input blocks and process them in parallel
+    size_t batch_size = 0;
+    data.clear(); blocks.clear();
+    while (bifs.good() && batch_size < BATCH_SIZE) {
+      blocks.emplace_back(); data.emplace_back();
+      deserialize(blocks.back(), data.back(), bifs, kifs);
+      batch_size += blocks.back().size();
+    }
 
-    using PairSort = parallel_radix_sort::PairSort<SubKMer, size_t, SubKMer, EncoderKMer>;
-    // PairSort::InitAndSort(data.data(), blocks.data(), data.size());
-    PairSort::InitAndSort(data.data(), blocks.data(), data.size(), data.size() > 1000*16 ? -1 : 1);
+    std::vector<Result> results(blocks.size());
+#   pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+    for (size_t i = 0; i < blocks.size(); ++i)
+      op(blocks[i], data[i], results[i]);
+    merge(results);
 
-    for (auto start = data.begin(), end = data.end(); start != end;) {
-      auto chunk_end = std::upper_bound(start + 1, data.end(), *start, SubKMerComparator());
-      op(blocks.begin() + (start - data.begin()), chunk_end - start);
-      start = chunk_end;
-      ocnt += 1;
-    }
-    icnt += 1;
+    icnt += blocks.size();
   }
 
-  return std::make_pair(icnt, ocnt);
+  return icnt;
 }
 
 #if 1
@@ -87,117 +113,277 @@ static bool canMerge(const ConcurrentDSU &uf, size_t x, size_t y) {
 }
 #endif
 
+// Pairs of k-mer indices within the Hamming distance, in the order they were compared
+typedef std::vector<std::pair<size_t, size_t>> KMerPairs;
+
+static void findNeighbours(KMerPairs &pairs,
+                           const std::vector<size_t>::iterator &block,
+                           const std::vector<hammer::KMer> &kmers,
+                           size_t from, size_t to,
+                           unsigned tau) {
+  for (size_t i = from; i < to; ++i) {
+    const hammer::KMer &kmerx = kmers[i];
+    for (size_t j = i + 1; j < kmers.size(); j++) {
+      if (hamdistKMer(kmerx, kmers[j], tau) <= tau)
+        pairs.emplace_back(block[i], block[j]);
+    }
+  }
+}
+
+// Distances do not depend on the clusters, so only the merging has to be
+// serial. Then cluster size checks hold and the result does not depend on the
+// thread timing.
+static void mergeNeighbours(dsu::ConcurrentDSU &uf, const KMerPairs &pairs) {
+  for (const auto &p : pairs) {
+    if (!uf.same(p.first, p.second) &&
+        canMerge(uf, p.first, p.second))
+      uf.unite(p.first, p.second);
+  }
+}
+
+static std::vector<hammer::KMer> gatherKMers(const std::vector<size_t>::iterator &block,
+                                             size_t block_size,
+                                             const KMerData &data) {
+  std::vector<hammer::KMer> kmers;
+  kmers.reserve(block_size);
+  for (size_t i = 0; i < block_size; ++i)
+    kmers.push_back(data.kmer(block[i]));
+  return kmers;
+}
+
+static void findNeighboursQuadratic(KMerPairs &pairs,
+                                    const std::vector<size_t>::iterator &block,
+                                    size_t block_size,
+                                    const KMerData &data,
+                                    unsigned tau) {
+  findNeighbours(pairs, block, gatherKMers(block, block_size, data), 0, block_size, tau);
+}
 
-static void processBlockQuadratic(dsu::ConcurrentDSU  &uf,
-                                  const std::vector<size_t>::iterator &block,
-                                  size_t block_size,
-                                  const KMerData &data,
-                                  unsigned tau) {
-  for (size_t i = 0; i < block_size; ++i) {
-    size_t x = block[i];
-    hammer::KMer kmerx = data.kmer(x);
-    for (size_t j = i + 1; j < block_size; j++) {
-      size_t y = block[j];
-      hammer::KMer kmery = data.kmer(y);
-      if (!uf.same(x, y) &&
-          canMerge(uf, x, y) &&
-          hamdistKMer(kmerx, kmery, tau) <= tau) {
-        uf.unite(x, y);
+// Processes the given blocks out of the ones delimited by bounds. Groups of
+// blocks are compared in parallel, a window of groups at a time.
+static void processBlocks(dsu::ConcurrentDSU &uf,
+                          const std::vector<size_t>::iterator &blocks,
+                          const std::vector<size_t> &bounds,
+                          const std::vector<size_t> &idxs,
+                          const KMerData &data,
+                          unsigned tau, unsigned nthreads) {
+  const size_t group = 1024;
+  std::vector<KMerPairs> pairs(4 * nthreads);
+  for (size_t w = 0; w < idxs.size(); w += group * pairs.size()) {
+#   pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+    for (size_t g = 0; g < pairs.size(); ++g) {
+      size_t from = std::min(w + g * group, idxs.size()), to = std::min(from + group, idxs.size());
+      for (size_t b = from; b < to; ++b) {
+        size_t idx = idxs[b];
+        findNeighboursQuadratic(pairs[g], blocks + bounds[idx], bounds[idx + 1] - bounds[idx], data, tau);
       }
     }
+
+    for (auto &p : pairs) {
+      mergeNeighbours(uf, p);
+      p.clear();
+    }
   }
 }
 
+// Rows of large blocks are compared in parallel
+static void processLargeBlock(dsu::ConcurrentDSU  &uf,
+                              std::vector<size_t> &block,
+                              const KMerData &data,
+                              unsigned tau, unsigned nthreads) {
+  const size_t rows = 16;
+  auto kmers = gatherKMers(block.begin(), block.size(), data);
+  std::vector<KMerPairs> pairs((block.size() + rows - 1) / rows);
+# pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+  for (size_t r = 0; r < pairs.size(); ++r)
+    findNeighbours(pairs[r], block.begin(), kmers, r * rows, std::min((r + 1) * rows, block.size()), tau);
+
+  for (const auto &p : pairs)
+    mergeNeighbours(uf, p);
+}
+
+// Result of splitting a big block in the second pass
+struct SplitBlock {
+  KMerPairs pairs;
+  std::vector<std::vector<size_t>> large_blocks;
+};
+
 void KMerHamClusterer::cluster(const std::string &prefix,
                                const KMerData &data,
                                dsu::ConcurrentDSU &uf) {
-  // First pass - split & sort the k-mers
+  unsigned nthreads = cfg::get().general_max_nthreads;
+  unsigned block_thr = cfg::get().hamming_blocksize_quadratic_threshold;
+  const size_t large_block_thr = 1024;
+
+  // A part of sub-k-mers is sorted together with the indices, taking twice the
+  // memory. The in-memory first pass also keeps up to one part of indices for
+  // the second pass. Otherwise sub-k-mers and all the big blocks go to disk.
+  size_t part_mem = data.size() * (sizeof(size_t) + sizeof(SubKMer));
+  bool in_memory = 2 * part_mem + data.size() * sizeof(size_t) < utils::get_free_memory();
+
   std::string fname = prefix + ".first", bfname = fname + ".blocks", kfname = fname + ".kmers";
-  std::ofstream bfs(bfname, std::ios::out | std::ios::binary);
-  std::ofstream kfs(kfname, std::ios::out | std::ios::binary);
-  VERIFY(bfs.good()); VERIFY(kfs.good());
-
-  INFO("Serializing sub-kmers.");
-  for (unsigned i = 0; i < tau_ + 1; ++i) {
-    size_t from = (*Globals::subKMerPositions)[i];
-    size_t to = (*Globals::subKMerPositions)[i+1];
-
-    INFO("Serializing: [" << from << ", " << to << ")");
-    serialize(bfs, kfs,
-              data, NULL, 0,
-              SubKMerPartSerializer(from, to));
+  std::ofstream bfs, kfs;
+  if (!in_memory) {
+    INFO("Serializing sub-kmers.");
+    bfs.open(bfname, std::ios::out | std::ios::binary);
+    kfs.open(kfname, std::ios::out | std::ios::binary);
+    VERIFY(bfs.good()); VERIFY(kfs.good());
+    for (unsigned i = 0; i < tau_ + 1; ++i) {
+      size_t from = (*Globals::subKMerPositions)[i];
+      size_t to = (*Globals::subKMerPositions)[i+1];
+
+      INFO("Serializing: [" << from << ", " << to << ")");
+      serialize(bfs, kfs,
+                data, NULL, 0,
+                SubKMerPartSerializer(from, to));
+    }
+    VERIFY(!bfs.fail()); VERIFY(!kfs.fail());
+    bfs.close(); kfs.close();
   }
-  VERIFY(!bfs.fail()); VERIFY(!kfs.fail());
-  bfs.close(); kfs.close();
+
+  // Blocks for the second pass are kept in memory until they take as much as
+  // a part of the first pass, the rest is dumped to disk
+  std::vector<std::vector<size_t>> big_blocks;
+  size_t big_blocks_mem = 0;
 
   size_t big_blocks1 = 0;
   {
-    unsigned block_thr = cfg::get().hamming_blocksize_quadratic_threshold;
-
     INFO("Splitting sub-kmers, pass 1.");
-    SubKMerSplitter Splitter(bfname, kfname);
+    std::unique_ptr<MMappedReader> bifs, kifs;
+    if (!in_memory) {
+      bifs.reset(new MMappedReader(bfname, /* unlink */ true));
+      kifs.reset(new MMappedReader(kfname, /* unlink */ true));
+    }
+    SubKMerSplitter splitter(bfname, kfname);
 
     fname = prefix + ".second", bfname = fname + ".blocks", kfname = fname + ".kmers";
-    bfs.open(bfname, std::ios::out | std::ios::binary);
-    kfs.open(kfname, std::ios::out | std::ios::binary);
-    VERIFY(bfs.good()); VERIFY(kfs.good());
 
-    std::pair<size_t, size_t> stat =
-      Splitter.split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
+    std::vector<size_t> blocks;
+    std::vector<SubKMer> subkmers;
+    size_t ocnt = 0;
+    for (unsigned i = 0; i < tau_ + 1; ++i) {
+      if (in_memory) {
+        size_t from = (*Globals::subKMerPositions)[i];
+        size_t to = (*Globals::subKMerPositions)[i+1];
+
+        INFO("Splitting: [" << from << ", " << to << ")");
+        SubKMerPartSerializer serializer(from, to);
+        blocks.resize(data.size());
+        subkmers.resize(data.size());
+#       pragma omp parallel for num_threads(nthreads)
+        for (size_t j = 0; j < data.size(); ++j) {
+          blocks[j] = j;
+          subkmers[j] = serializer.serialize(data.kmer(j));
+        }
+      } else {
+        splitter.deserialize(blocks, subkmers, *bifs, *kifs);
+      }
+
+      std::vector<size_t> bounds = SplitBySubKMers(blocks, subkmers, nthreads);
+      std::vector<size_t> small_blocks;
+      for (size_t b = 0; b + 1 < bounds.size(); ++b) {
+        auto start = blocks.begin() + bounds[b];
+        size_t sz = bounds[b + 1] - bounds[b];
         if (sz < block_thr) {
-          // Merge small blocks.
-          processBlockQuadratic(uf, start, sz, data, tau_);
+          small_blocks.push_back(b);
+          continue;
+        }
+
+        // Big blocks go to the next pass
+        big_blocks1 += 1;
+        if (in_memory && big_blocks_mem + sz <= data.size()) {
+          big_blocks.emplace_back(start, start + sz);
+          big_blocks_mem += sz;
         } else {
-          big_blocks1 += 1;
-          // Otherwise - dump for next iteration.
-          for (unsigned i = 0; i < tau_ + 1; ++i) {
+          if (!bfs.is_open()) {
+            INFO("Dumping big blocks to disk");
+            bfs.open(bfname, std::ios::out | std::ios::binary);
+            kfs.open(kfname, std::ios::out | std::ios::binary);
+            VERIFY(bfs.good()); VERIFY(kfs.good());
+          }
+          for (unsigned s = 0; s < tau_ + 1; ++s) {
             serialize(bfs, kfs,
                       data, &start, sz,
-                      SubKMerStridedSerializer(i, tau_ + 1));
+                      SubKMerStridedSerializer(s, tau_ + 1));
           }
         }
-    });
+      }
+
+      // Merge small blocks.
+      processBlocks(uf, blocks.begin(), bounds, small_blocks, data, tau_, nthreads);
+      ocnt += bounds.size() - 1;
+    }
     INFO("Splitting done."
-         " Processed " << stat.first << " blocks."
-         " Produced " << stat.second << " blocks.");
+         " Processed " << tau_ + 1 << " blocks."
+         " Produced " << ocnt << " blocks.");
 
     // Sanity check - there cannot be more blocks than tau + 1 times of total
-    // kmer number. And on the first pass we have only tau + 1 input blocks!
-    VERIFY(stat.first == tau_ + 1);
-    VERIFY(stat.second <= (tau_ + 1) * data.size());
+    // kmer number.
+    VERIFY(ocnt <= (tau_ + 1) * data.size());
 
     VERIFY(!bfs.fail()); VERIFY(!kfs.fail());
-    bfs.close(); kfs.close();
     INFO("Merge done, total " << big_blocks1 << " new blocks generated.");
   }
 
-  size_t big_blocks2 = 0;
   {
     INFO("Spliting sub-kmers, pass 2.");
-    SubKMerSplitter Splitter(bfname, kfname);
-    size_t nblocks = 0;
-    std::pair<size_t, size_t> stat =
-      Splitter.split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
-        if (sz > 50) {
+    std::atomic<size_t> big_blocks2(0), nblocks(0);
+    auto split = [&](std::vector<size_t> &blocks, std::vector<SubKMer> &subkmers, SplitBlock &res) {
+      std::vector<size_t> bounds = SplitBySubKMers(blocks, subkmers, 1);
+      for (size_t b = 0; b + 1 < bounds.size(); ++b) {
+        auto start = blocks.begin() + bounds[b];
+        size_t sz = bounds[b + 1] - bounds[b];
+        if (sz > 50)
           big_blocks2 += 1;
-#if 0
-          for (size_t i = 0; i < block.size(); ++i) {
-            std::string s(Globals::blob + data[block[i]], K);
-            INFO("" << block[i] << ": " << s);
-          }
-#endif
-        }
-        processBlockQuadratic(uf, start, sz, data, tau_);
         nblocks += 1;
-    });
+
+        if (sz > large_block_thr)
+          res.large_blocks.emplace_back(start, start + sz);
+        else
+          findNeighboursQuadratic(res.pairs, start, sz, data, tau_);
+      }
+    };
+    // Large blocks are processed one by one
+    auto merge = [&](std::vector<SplitBlock> &results) {
+      for (auto &res : results) {
+        mergeNeighbours(uf, res.pairs);
+        for (auto &block : res.large_blocks)
+          processLargeBlock(uf, block, data, tau_, nthreads);
+      }
+    };
+
+    size_t icnt = big_blocks.size() * (tau_ + 1);
+    std::vector<SplitBlock> results;
+    for (size_t w = 0; w < icnt; w += results.size()) {
+      results.clear();
+      results.resize(std::min(size_t(4 * nthreads), icnt - w));
+#     pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+      for (size_t r = 0; r < results.size(); ++r) {
+        size_t i = w + r;
+        std::vector<size_t> blocks = big_blocks[i / (tau_ + 1)];
+        std::vector<SubKMer> subkmers(blocks.size());
+        SubKMerStridedSerializer serializer(i % (tau_ + 1), tau_ + 1);
+        for (size_t j = 0; j < blocks.size(); ++j)
+          subkmers[j] = serializer.serialize(data.kmer(blocks[j]));
+        split(blocks, subkmers, results[r]);
+      }
+      merge(results);
+    }
+    big_blocks.clear();
+
+    if (bfs.is_open()) {
+      bfs.close(); kfs.close();
+      icnt += SubKMerSplitter(bfname, kfname).split<SplitBlock>(split, merge, nthreads);
+    }
+
     INFO("Splitting done."
-            " Processed " << stat.first << " blocks."
-            " Produced " << stat.second << " blocks.");
+            " Processed " << icnt << " blocks."
+            " Produced " << nblocks << " blocks.");
 
     // Sanity check - there cannot be more blocks than tau + 1 times of total
     // kmer number. And there should be tau + 1 times big_blocks input blocks.
-    VERIFY(stat.first == (tau_ + 1)*big_blocks1);
-    VERIFY(stat.second <= (tau_ + 1) * (tau_ + 1) * data.size());
+    VERIFY(icnt == (tau_ + 1)*big_blocks1);
+    VERIFY(nblocks <= (tau_ + 1) * (tau_ + 1) * data.size());
 
     INFO("Merge done, saw " << big_blocks2 << " big blocks out of " << nblocks << " processed.");
   }
@@ -105,6 +105,9 @@ void serialize(Writer &blocks, Writer &kmers,
 class SubKMerSplitter {
   const std::string bifname_, kifname_;
 
+  // Number of k-mers in a batch of input blocks processed in parallel
+  static const size_t BATCH_SIZE = 1 << 20;
+
  public:
   SubKMerSplitter(const std::string &bifname, const std::string &kifname)
       : bifname_(bifname), kifname_(kifname) {}
@@ -133,8 +136,10 @@ class SubKMerSplitter {
       binary_read(kis, kmers[i]);
   }
 
-  template<class Op>
-  std::pair<size_t, size_t> split(Op &&op);
+  // Calls op(blocks, kmers, result) for every input block, a batch of blocks in
+  // parallel, then merge(results) for the batch. Returns the number of blocks
+  template<class Result, class Op, class Merge>
+  size_t split(Op &&op, Merge &&merge, unsigned nthreads);
 };
 
 class KMerHamClusterer {
@@ -12,7 +12,9 @@
 #include "read_corrector.hpp"
 
 #include "io/kmers/mmapped_writer.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -74,32 +76,96 @@ string getFilename( const string & dirprefix, int iter_count, const string & suf
   return tmp.str();
 }
 
-CorrectionStats CorrectReadsBatch(std::vector<bool> &res,
-                       std::vector<Read> &reads, size_t buf_size,
-                       const KMerData &data) {
-  unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
-  bool discard_singletons = cfg::get().bayes_discard_only_singletons;
-  bool correct_threshold = cfg::get().correct_use_threshold;
-  bool discard_bad = cfg::get().correct_discard_bad;
-
-  ReadCorrector corrector(data, cfg::get().correct_stats);
-# pragma omp parallel for shared(reads, res, data) num_threads(correct_nthreads)
-  for (size_t i = 0; i < buf_size; ++i) {
-    if (reads[i].size() >= K) {
-      res[i] =
-          corrector.CorrectOneRead(reads[i],
-                                   correct_threshold, discard_singletons, discard_bad);
-    } else
-      res[i] = false;
+namespace {
+
+struct ReadBatch {
+  std::vector<Read> reads;
+  std::vector<uint8_t> res; // not vector<bool>, filled concurrently
+  size_t size = 0;
+
+  explicit ReadBatch(size_t capacity)
+      : reads(capacity), res(capacity, false) {}
+};
+
+struct PairedReadBatch {
+  ReadBatch left, right;
+  size_t size = 0;
+
+  explicit PairedReadBatch(size_t capacity)
+      : left(capacity), right(capacity) {}
+};
+
+/// corrects reads one by one, thread-safe
+class BatchCorrector {
+  ReadCorrector corrector_;
+  bool discard_singletons_;
+  bool correct_threshold_;
+  bool discard_bad_;
+
+ public:
+  BatchCorrector(const KMerData &data)
+      : corrector_(data, cfg::get().correct_stats),
+        discard_singletons_(cfg::get().bayes_discard_only_singletons),
+        correct_threshold_(cfg::get().correct_use_threshold),
+        discard_bad_(cfg::get().correct_discard_bad) {}
+
+  void Correct(ReadBatch &batch, size_t i) {
+    Read &r = batch.reads[i];
+    batch.res[i] = r.size() >= K &&
+        corrector_.CorrectOneRead(r, correct_threshold_, discard_singletons_, discard_bad_);
   }
 
-  CorrectionStats stats;
+  CorrectionStats stats() const {
+    CorrectionStats stats;
+    stats.changedReads = corrector_.changed_reads();
+    stats.changedNucleotides = corrector_.changed_nucleotides();
+    stats.uncorrectedNucleotides = corrector_.uncorrected_nucleotides();
+    stats.totalNucleotides = corrector_.total_nucleotides();
+    return stats;
+  }
+};
+
+const size_t CORRECTION_CHUNK = 64;
+
+/// Three-stage pipeline over three batches rotating between the stages: while
+/// one batch is being corrected, the next one is read by the master thread and
+/// the previous one is written by another thread. Both threads join the
+/// correction once they are done, so the output order is preserved.
+/// read(batch) returns the number of reads put into the batch, 0 at the end of input.
+template<class Batch, class Reader, class Corrector, class Writer>
+void RunCorrectionPipeline(unsigned nthreads, size_t capacity,
+                           Reader read, Corrector correct, Writer write) {
+  std::vector<Batch> batches(3, Batch(capacity));
+  batches[0].size = read(batches[0]);
+  for (unsigned batch_no = 0; ; ++batch_no) {
+    Batch &prev = batches[(batch_no + 2) % 3];
+    Batch &cur = batches[batch_no % 3];
+    Batch &next = batches[(batch_no + 1) % 3];
+    if (cur.size == 0 && (batch_no == 0 || prev.size == 0))
+      break;
+
+    size_t prev_size = (batch_no == 0 ? 0 : prev.size);
+    if (cur.size)
+      INFO("Processing batch " << batch_no << " of " << cur.size << " reads.");
+    std::atomic<size_t> pos(0);
+#   pragma omp parallel num_threads(nthreads)
+    {
+      int writer = (omp_get_num_threads() > 1 ? 1 : 0);
+      if (omp_get_thread_num() == 0)
+        next.size = (cur.size ? read(next) : 0);
+      if (omp_get_thread_num() == writer && prev_size)
+        write(prev);
+
+      for (size_t i = pos.fetch_add(CORRECTION_CHUNK); i < cur.size; i = pos.fetch_add(CORRECTION_CHUNK)) {
+        for (size_t j = i, e = std::min(i + CORRECTION_CHUNK, cur.size); j < e; ++j)
+          correct(cur, j);
+      }
+    }
+    if (prev_size)
+      INFO("Written batch " << batch_no - 1);
+  }
+}
 
-  stats.changedReads += corrector.changed_reads();
-  stats.changedNucleotides += corrector.changed_nucleotides();
-  stats.uncorrectedNucleotides += corrector.uncorrected_nucleotides();
-  stats.totalNucleotides += corrector.total_nucleotides();
-  return stats;
 }
 
 CorrectionStats CorrectReadFile(const KMerData &data,
@@ -110,33 +176,30 @@ CorrectionStats CorrectReadFile(const KMerData &data,
 
   unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
   size_t read_buffer_size = correct_nthreads * cfg::get().correct_readbuffer;
-  std::vector<Read> reads(read_buffer_size);
-  std::vector<bool> res(read_buffer_size, false);
 
   ireadstream irs(fname, qvoffset);
   VERIFY(irs.is_open());
 
-  unsigned buffer_no = 0;
-  CorrectionStats stats;
-  while (!irs.eof()) {
-    size_t buf_size = 0;
-    for (; buf_size < read_buffer_size && !irs.eof(); ++buf_size) {
-      irs >> reads[buf_size];
-      reads[buf_size].trimNsAndBadQuality(trim_quality);
-    }
-    INFO("Prepared batch " << buffer_no << " of " << buf_size << " reads.");
-
-    stats += CorrectReadsBatch(res, reads, buf_size,
-                               data);
-
-    INFO("Processed batch " << buffer_no);
-    for (size_t i = 0; i < buf_size; ++i) {
-      reads[i].print(*(res[i] ? outf_good : outf_bad), qvoffset);
-    }
-    INFO("Written batch " << buffer_no);
-    ++buffer_no;
-  }
-  return stats;
+  BatchCorrector corrector(data);
+  RunCorrectionPipeline<ReadBatch>(
+      correct_nthreads, read_buffer_size,
+      [&](ReadBatch &batch) {
+        size_t buf_size = 0;
+        for (; buf_size < read_buffer_size && !irs.eof(); ++buf_size) {
+          irs >> batch.reads[buf_size];
+          batch.reads[buf_size].trimNsAndBadQuality(trim_quality);
+        }
+        return buf_size;
+      },
+      [&](ReadBatch &batch, size_t i) {
+        corrector.Correct(batch, i);
+      },
+      [&](const ReadBatch &batch) {
+        for (size_t i = 0; i < batch.size; ++i)
+          batch.reads[i].print(*(batch.res[i] ? outf_good : outf_bad), qvoffset);
+      });
+
+  return corrector.stats();
 }
 
 CorrectionStats CorrectPairedReadFiles(const KMerData &data,
@@ -147,47 +210,44 @@ CorrectionStats CorrectPairedReadFiles(const KMerData &data,
 
   unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
   size_t read_buffer_size = correct_nthreads * cfg::get().correct_readbuffer;
-  std::vector<Read> l(read_buffer_size);
-  std::vector<Read> r(read_buffer_size);
-  std::vector<bool> left_res(read_buffer_size, false);
-  std::vector<bool> right_res(read_buffer_size, false);
-
-  unsigned buffer_no = 0;
 
   ireadstream irsl(fnamel, qvoffset), irsr(fnamer, qvoffset);
   VERIFY(irsl.is_open()); VERIFY(irsr.is_open());
-  CorrectionStats stats;
 
-  while (!irsl.eof() && !irsr.eof()) {
-    size_t buf_size = 0;
-    for (; buf_size < read_buffer_size && !irsl.eof() && !irsr.eof(); ++buf_size) {
-      irsl >> l[buf_size]; irsr >> r[buf_size];
-      l[buf_size].trimNsAndBadQuality(trim_quality);
-      r[buf_size].trimNsAndBadQuality(trim_quality);
-    }
-    INFO("Prepared batch " << buffer_no << " of " << buf_size << " reads.");
-
-    stats += CorrectReadsBatch(left_res, l, buf_size,
-                      data);
-    stats += CorrectReadsBatch(right_res, r, buf_size,
-                      data);
-
-    INFO("Processed batch " << buffer_no);
-    for (size_t i = 0; i < buf_size; ++i) {
-      if (left_res[i] && right_res[i]) {
-        l[i].print(*ofcorl, qvoffset);
-        r[i].print(*ofcorr, qvoffset);
-      } else {
-        l[i].print(*(left_res[i] ? ofunp : ofbadl), qvoffset);
-        r[i].print(*(right_res[i] ? ofunp : ofbadr), qvoffset);
-      }
-    }
-    INFO("Written batch " << buffer_no);
-    ++buffer_no;
-  }
+  BatchCorrector corrector(data);
+  RunCorrectionPipeline<PairedReadBatch>(
+      correct_nthreads, read_buffer_size,
+      [&](PairedReadBatch &batch) {
+        std::vector<Read> &l = batch.left.reads, &r = batch.right.reads;
+        size_t buf_size = 0;
+        for (; buf_size < read_buffer_size && !irsl.eof() && !irsr.eof(); ++buf_size) {
+          irsl >> l[buf_size]; irsr >> r[buf_size];
+          l[buf_size].trimNsAndBadQuality(trim_quality);
+          r[buf_size].trimNsAndBadQuality(trim_quality);
+        }
+        return buf_size;
+      },
+      [&](PairedReadBatch &batch, size_t i) {
+        corrector.Correct(batch.left, i);
+        corrector.Correct(batch.right, i);
+      },
+      [&](const PairedReadBatch &batch) {
+        const std::vector<Read> &l = batch.left.reads, &r = batch.right.reads;
+        const std::vector<uint8_t> &left_res = batch.left.res, &right_res = batch.right.res;
+        for (size_t i = 0; i < batch.size; ++i) {
+          if (left_res[i] && right_res[i]) {
+            l[i].print(*ofcorl, qvoffset);
+            r[i].print(*ofcorr, qvoffset);
+          } else {
+            l[i].print(*(left_res[i] ? ofunp : ofbadl), qvoffset);
+            r[i].print(*(right_res[i] ? ofunp : ofbadr), qvoffset);
+          }
+        }
+      });
+
   if (!irsl.eof() || !irsr.eof())
       FATAL_ERROR("Pair of read files " + fnamel + " and " + fnamer + " contain unequal amount of reads");
-  return stats;
+  return corrector.stats();
 }
 
 std::string getLargestPrefix(const std::string &str1, const std::string &str2) {
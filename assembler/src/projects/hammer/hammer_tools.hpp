@@ -44,11 +44,6 @@ struct CorrectionStats {
   }
 };
 
-/// parallel correction of batch of reads
-CorrectionStats CorrectReadsBatch(std::vector<bool> &res, std::vector<Read> &reads, size_t buf_size,
-                       size_t &changedReads, size_t &changedNucleotides, size_t &uncorrectedNucleotides, size_t &totalNucleotides,
-                       const KMerData &data);
-
 /// correct reads in a given file
 CorrectionStats CorrectReadFile(const KMerData &data,
                          size_t &changedReads, size_t &changedNucleotides, size_t &uncorrectedNucleotides, size_t &totalNucleotides,
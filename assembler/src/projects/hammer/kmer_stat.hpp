@@ -35,13 +35,17 @@ typedef Seq<K> KMer;
 class Read;
 struct KMerStat;
 
+// Compares packed k-mers word by word: a position differs if either of its two bits does
 static inline unsigned hamdistKMer(const hammer::KMer &x, const hammer::KMer &y,
                                    unsigned tau = hammer::K) {
+  typedef hammer::KMer::DataType T;
+  const T *xd = x.data(), *yd = y.data();
   unsigned dist = 0;
-  for (unsigned i = 0; i < hammer::K; ++i) {
-    if (x[i] != y[i]) {
-      ++dist; if (dist > tau) return dist;
-    }
+  for (size_t i = 0; i < hammer::KMer::DataSize; ++i) {
+    T diff = xd[i] ^ yd[i];
+    diff = (diff | (diff >> 1)) & (T(-1) / 3);
+    dist += __builtin_popcountll(diff);
+    if (dist > tau) return dist;
   }
   return dist;
 }
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+#
+# Correction throughput benchmark for IonHammer. The reads of the test
+# dataset get homopolymer length errors injected with a fixed seed, so every
+# run corrects the same read set and the timings and the corrected reads of
+# different builds can be compared directly.
+#
+# Usage: benchmark.py -b build/bin/spades-ionhammer -o bench_dir
+
+import argparse
+import gzip
+import hashlib
+import itertools
+import os
+import random
+import re
+import subprocess
+import sys
+
+
+def exit_with_error(message):
+    sys.stderr.write("Error: {__message}\n".format(__message=message))
+    sys.exit(1)
+
+
+def read_fastq(path):
+    with gzip.open(path, "rt") as f:
+        for name, seq, _, _ in itertools.zip_longest(*[f] * 4):
+            yield name.rstrip(), seq.rstrip()
+
+
+def inject_hrun_errors(seq, rnd, error_rate):
+    result = []
+    for run in re.finditer(r"A+|C+|G+|T+|N+", seq):
+        run = run.group(0)
+        if rnd.random() < error_rate:
+            if len(run) > 1 and rnd.random() < 0.5:
+                run = run[:-1]
+            else:
+                run += run[0]
+        result.append(run)
+    return "".join(result)
+
+
+def make_reads(src, dst, rnd, error_rate):
+    with open(dst, "w") as out:
+        for name, seq in read_fastq(src):
+            seq = inject_hrun_errors(seq, rnd, error_rate)
+            out.write("{}\n{}\n+\n{}\n".format(name, seq, "I" * len(seq)))
+
+
+def corrected_digest(output_dir):
+    # Sorted, so that the digest does not depend on the order the threads write the reads in
+    records = []
+    for name in sorted(os.listdir(output_dir)):
+        if name.endswith(".cor.fasta"):
+            with open(os.path.join(output_dir, name)) as f:
+                records.append(name + "\n" + "".join(sorted(f.read().split(">"))))
+    return hashlib.md5("".join(records).encode()).hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="IonHammer correction throughput benchmark")
+    parser.add_argument("-b", "--binary", required=True, help="path to spades-ionhammer")
+    parser.add_argument("-o", "--output", required=True, help="working directory")
+    parser.add_argument("-t", "--threads", type=int, default=1, help="number of threads [default: 1]")
+    parser.add_argument("--seed", type=int, default=42, help="seed of the injected errors [default: 42]")
+    parser.add_argument("--error-rate", type=float, default=0.02,
+                        help="probability of a homopolymer length error per run [default: 0.02]")
+    parser.add_argument("--dataset", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                          "../../../test_dataset"),
+                        help="directory with ecoli_1K_{1,2}.fq.gz [default: assembler/test_dataset]")
+    parser.add_argument("--config", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                         "../../../configs/ionhammer/ionhammer.cfg"),
+                        help="IonHammer config to take the options from [default: configs/ionhammer/ionhammer.cfg]")
+    args = parser.parse_args()
+
+    if not os.path.isfile(args.binary):
+        exit_with_error("binary " + args.binary + " does not exist")
+    output = os.path.abspath(args.output)
+    os.makedirs(os.path.join(output, "tmp"), exist_ok=True)
+
+    rnd = random.Random(args.seed)
+    reads = []
+    for i in [1, 2]:
+        reads.append(os.path.join(output, "reads_{}.fq".format(i)))
+        make_reads(os.path.join(args.dataset, "ecoli_1K_{}.fq.gz".format(i)), reads[-1], rnd, args.error_rate)
+
+    dataset = os.path.join(output, "dataset.yaml")
+    with open(dataset, "w") as f:
+        f.write("- left reads: [{}]\n  right reads: [{}]\n  orientation: fr\n  type: paired-end\n".format(*reads))
+
+    corrected = os.path.join(output, "corrected")
+    os.makedirs(corrected, exist_ok=True)
+    options = {"dataset": dataset,
+               "working_dir": os.path.join(output, "tmp"),
+               "output_dir": corrected,
+               "max_nthreads": args.threads}
+    config = os.path.join(output, "ionhammer.cfg")
+    with open(args.config) as src, open(config, "w") as f:
+        for line in src:
+            key = line.split(":")[0].strip()
+            if key in options:
+                line = "{:<18}: {}\n".format(key, options[key])
+            f.write(line)
+
+    log = subprocess.check_output([args.binary, config], universal_newlines=True)
+    for line in log.splitlines():
+        if "Corrected " in line and "reads/s" in line:
+            print(line[line.index("Corrected "):])
+    print("Corrected reads digest: " + corrected_digest(corrected))
+
+
+if __name__ == "__main__":
+    main()
@@ -17,6 +17,7 @@
 
 #include "utils/segfault_handler.hpp"
 #include "utils/memory_limit.hpp"
+#include "utils/perf/perfcounter.hpp"
 
 #include "HSeq.hpp"
 #include "config_struct.hpp"
@@ -275,6 +276,20 @@ class TKMerDataEstimator {
 #endif
 };
 
+// Reports the correction throughput, the same read set gives comparable
+// numbers between the runs
+template <class Reader, class Corrector, class Writer>
+static void CorrectReads(Reader& irs, Corrector& read_corrector, Writer& ors) {
+  utils::perf_counter pc;
+  hammer::ReadProcessor rp(cfg::get().max_nthreads);
+  rp.Run(irs, read_corrector, ors);
+
+  double time = pc.time();
+  INFO("Corrected " << rp.processed() << " reads in " << std::fixed
+       << std::setprecision(2) << time << " s ("
+       << (size_t)((double)rp.processed() / std::max(time, 1e-3)) << " reads/s)");
+}
+
 };  // namespace correction
 };  // namespace hammer
 
@@ -350,8 +365,7 @@ int main(int argc, char** argv) {
         io::SeparatePairedReadStream irs(I->first, I->second, 0);
         PairedReadsCorrector read_corrector(kmerData, calcerFactory, debug_pred,
                                             select_pred);
-        hammer::ReadProcessor(cfg::get().max_nthreads)
-            .Run(irs, read_corrector, ors);
+        CorrectReads(irs, read_corrector, ors);
 
         outlib.push_back_paired(outcorl, outcorr);
       }
@@ -375,8 +389,7 @@ int main(int argc, char** argv) {
         io::FileReadStream irs(*I, io::PhredOffset);
         SingleReadsCorrector read_corrector(kmerData, calcerFactory, debug_pred,
                                             select_pred);
-        hammer::ReadProcessor(cfg::get().max_nthreads)
-            .Run(irs, read_corrector, ors);
+        CorrectReads(irs, read_corrector, ors);
 
         outlib.push_back_single(outcor);
       }
@@ -405,8 +418,7 @@ int main(int argc, char** argv) {
         SingleReadsCorrector read_corrector(kmerData, calcerFactory, &header,
                                             debug_pred, select_pred);
         io::UnmappedBamStream irs(*I);
-        hammer::ReadProcessor(cfg::get().max_nthreads)
-            .Run(irs, read_corrector, ors);
+        CorrectReads(irs, read_corrector, ors);
 
         outlib.push_back_single(outcor);
       }
@@ -56,21 +56,41 @@ class ReadCorrector {
   mutable size_t skipped_reads = 0;
   mutable size_t queue_overflow_reads = 0;
 
-  inline bool Flush(std::priority_queue<State>& candidates,
-                    std::priority_queue<State>& corrections,
+  // Per-thread buffers reused by all the reads corrected by the thread
+  struct CorrectionArena {
+    StateQueue<State> corrections;
+    StateQueue<State> candidates;
+    VisitedStates visited;
+    CorrectedReads reads;
+
+    void Clear() {
+      corrections.clear();
+      candidates.clear();
+      visited.Clear();
+      reads.Clear();
+    }
+  };
+
+  static CorrectionArena& Arena() {
+    static thread_local CorrectionArena arena;
+    return arena;
+  }
+
+  inline bool Flush(StateQueue<State>& candidates,
+                    StateQueue<State>& corrections,
                     size_t limit,
                     size_t readSize) const {
 
     if (corrections.size() > limit) {
-      auto top = pop_queue(candidates);
+      auto top = candidates.pop();
       if (!std::isinf(top.Penalty())) {
         corrections.emplace(std::move(top));
       }
-      std::priority_queue<State>().swap(candidates);
+      candidates.clear();
       return true;
     } else {
       while (!candidates.empty()) {
-        auto top = pop_queue(candidates);
+        auto top = candidates.pop();
         if (top.TotalCorrections() > std::max(readSize / 10, (size_t)3)) {
           continue;
         }
@@ -92,31 +112,32 @@ class ReadCorrector {
       return read;
     }
 
-    std::priority_queue<State> corrections;
-    std::priority_queue<State> candidates;
+    CorrectionArena& arena = Arena();
+    arena.Clear();
+    auto& corrections = arena.corrections;
+    auto& candidates = arena.candidates;
+    auto& visited = arena.visited;
 
-    CorrectionContext context(data, read, reverse);
+    CorrectionContext context(data, read, reverse, arena.reads);
     {
       corrections.emplace(StateBuilder<PenaltyCalcer>::Initial(
           context, penalty_calcer, (uint)offset));
     }
 
-    std::map<uint, std::set<size_t> > visited;
     const size_t queue_limit =  (const size_t)(cfg::get().queue_limit_multiplier * log2(read.size() - offset + 1));//(const size_t)(100 * read.size());
 
     bool queue_overflow = false;
 
     while (!corrections.empty()) {
 
-      auto state = std::pop_queue(corrections);
+      auto state = corrections.pop();
       assert(state.Position() <= read.size());
 
       {
         size_t hash = state.GetHKMer().GetHash();
-        if (visited[state.Position()].count(hash) && corrections.size()) {
+        if (!visited.Insert(state.Position(), hash) && corrections.size()) {
           continue;
         }
-        visited[state.Position()].insert(hash);
       }
 
       if (state.Position() < read.size()) {
@@ -129,13 +150,13 @@ class ReadCorrector {
       }
 
       if (state.Position() == read.size()) {
-        return state.Read()->ToString();
+        return context.Reads().ToString(state.Read());
       }
 
       //      //don't correct last kmer
       if ((state.Position() + context.GetHRun(state.Position()).len) ==
           read.size()) {
-        auto result = state.Read()->ToString();
+        auto result = context.Reads().ToString(state.Read());
         result += (context.GetHRun(state.Position()).str());
         return result;
       }
@@ -5,9 +5,12 @@
 #ifndef PROJECT_READ_CORRECTOR_INFO_H
 #define PROJECT_READ_CORRECTOR_INFO_H
 
+#include <algorithm>
+#include <cassert>
 #include <functional>
-#include <queue>
+#include <vector>
 #include "hkmer.hpp"
+#include "utils/verify.hpp"
 
 namespace hammer {
 namespace correction {
@@ -15,12 +18,96 @@ namespace correction {
 namespace numeric = boost::numeric::ublas;
 using HRun = HomopolymerRun;
 
-template <class Moveable>
-inline Moveable pop_queue(std::priority_queue<Moveable>& queue) {
-  Moveable result(std::move(const_cast<Moveable&&>(queue.top())));
-  queue.pop();
-  return result;
-}
+// Max-heap over the reusable vector. Uses the same heap algorithms as
+// std::priority_queue, so the states are extracted in the same order
+template <class T>
+class StateQueue {
+  std::vector<T> data_;
+
+ public:
+  inline bool empty() const { return data_.empty(); }
+
+  inline size_t size() const { return data_.size(); }
+
+  inline void clear() { data_.clear(); }
+
+  inline const T& top() const { return data_.front(); }
+
+  template <class... Args>
+  inline void emplace(Args&&... args) {
+    data_.emplace_back(std::forward<Args>(args)...);
+    std::push_heap(data_.begin(), data_.end(), std::less<T>());
+  }
+
+  inline T pop() {
+    std::pop_heap(data_.begin(), data_.end(), std::less<T>());
+    T result(std::move(data_.back()));
+    data_.pop_back();
+    return result;
+  }
+};
+
+// Open addressing set of (position, hkmer hash) pairs. Entries of the
+// previous reads are told apart by the generation stamp, so the set is
+// cleared in O(1) and keeps its table between the reads
+class VisitedStates {
+  struct Entry {
+    size_t hash;
+    uint32_t position;
+    uint32_t stamp;
+  };
+
+  std::vector<Entry> table_;
+  size_t size_ = 0;
+  uint32_t stamp_ = 1;
+
+  inline size_t Slot(uint32_t position, size_t hash) const {
+    uint64_t h = (hash ^ position) * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (table_.size() - 1);
+  }
+
+  void Grow() {
+    std::vector<Entry> old(std::max(table_.size() * 2, (size_t)1024), Entry{0, 0, 0});
+    old.swap(table_);
+    for (const auto& entry : old) {
+      if (entry.stamp != stamp_) {
+        continue;
+      }
+      size_t slot = Slot(entry.position, entry.hash);
+      while (table_[slot].stamp == stamp_) {
+        slot = (slot + 1) & (table_.size() - 1);
+      }
+      table_[slot] = entry;
+    }
+  }
+
+ public:
+  void Clear() {
+    size_ = 0;
+    if (++stamp_ == 0) {
+      std::fill(table_.begin(), table_.end(), Entry{0, 0, 0});
+      stamp_ = 1;
+    }
+  }
+
+  // Returns false if the pair was already in the set
+  inline bool Insert(uint32_t position, size_t hash) {
+    if (2 * (size_ + 1) > table_.size()) {
+      Grow();
+    }
+
+    size_t slot = Slot(position, hash);
+    while (table_[slot].stamp == stamp_) {
+      if (table_[slot].hash == hash && table_[slot].position == position) {
+        return false;
+      }
+      slot = (slot + 1) & (table_.size() - 1);
+    }
+    table_[slot] = Entry{hash, position, stamp_};
+    size_ += 1;
+    return true;
+  }
+};
 
 struct IonEvent {
   
@@ -47,45 +134,56 @@ struct IonEvent {
   }
 };
 
-class CorrectedRead {
-private:
+// Corrected prefixes of all the states of a read. A prefix is a chain of
+// nodes, each holding a range of hruns, and the states share the common
+// nodes. Only the last node may be extended, earlier nodes are immutable.
+class CorrectedReads {
+  struct Node {
+    uint32_t parent;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  std::vector<Node> nodes_;
   std::vector<HRun> runs_;
-  std::shared_ptr<CorrectedRead> previous_;
+  mutable std::vector<uint32_t> chain_;
 
  public:
-  CorrectedRead() : previous_(nullptr) {}
-
-  CorrectedRead(std::shared_ptr<CorrectedRead> previous)
-      : previous_(previous) {}
+  static const uint32_t NO_NODE = uint32_t(-1);
 
-  CorrectedRead(std::vector<HRun>&& runs,
-                 std::shared_ptr<CorrectedRead> previous)
-      : runs_(std::move(runs)), previous_(previous) {}
-
-  inline void Add(const HRun hrun) { runs_.push_back(hrun); }
+  void Clear() {
+    nodes_.clear();
+    runs_.clear();
+  }
 
-  size_t Size() const {
-    size_t size = previous_ != nullptr ? previous_->Size() : 0;
-    for (auto hrun : runs_) {
-      size += hrun.len;
-    }
-    return size;
+  inline uint32_t Extend(uint32_t parent) {
+    nodes_.push_back({parent, (uint32_t)runs_.size(), (uint32_t)runs_.size()});
+    return (uint32_t)(nodes_.size() - 1);
   }
 
-  inline void Fill(std::string& result) const {
-    if (previous_ != nullptr) {
-      previous_->Fill(result);
-    }
+  inline void Add(uint32_t node, const HRun hrun) {
+    VERIFY(node + 1 == nodes_.size());
+    runs_.push_back(hrun);
+    nodes_[node].end += 1;
+  }
 
-    for (auto hrun : runs_) {
-      result += hrun.str();
+  std::string ToString(uint32_t node) const {
+    chain_.clear();
+    size_t size = 0;
+    for (; node != NO_NODE; node = nodes_[node].parent) {
+      chain_.push_back(node);
+      for (uint32_t i = nodes_[node].begin; i < nodes_[node].end; ++i) {
+        size += runs_[i].len;
+      }
     }
-  }
 
-  inline std::string ToString() const {
     std::string result;
-    result.reserve(Size() + 10);
-    Fill(result);
+    result.reserve(size + 10);
+    for (auto it = chain_.rbegin(); it != chain_.rend(); ++it) {
+      for (uint32_t i = nodes_[*it].begin; i < nodes_[*it].end; ++i) {
+        result.append(runs_[i].len, ::nucl(runs_[i].nucl));
+      }
+    }
     return result;
   }
 };
@@ -100,7 +198,7 @@ class CorrectionState {
  private:
   PenaltyState penalty_state;
   HKMer kmer_;
-  std::shared_ptr<CorrectedRead> current_read_ = std::shared_ptr<CorrectedRead>(nullptr);
+  uint32_t current_read_ = CorrectedReads::NO_NODE;
   int16_t cursor_ = 0;
   int16_t corrections_ = 0;
 
@@ -111,7 +209,7 @@ class CorrectionState {
 
   inline size_t TotalCorrections() const { return (size_t)corrections_; }
 
-  const CorrectedRead* Read() const { return current_read_.get(); }
+  uint32_t Read() const { return current_read_; }
 
   unsigned Position() const { return (unsigned)cursor_; }
 };
@@ -121,6 +219,7 @@ class CorrectionContext {
   std::vector<char> read_;
   std::vector<uint8_t> hrun_sizes_;
   const KMerData& data_;
+  CorrectedReads& reads_;
   bool reversed_;
 
   inline void FillHRunSizes(const std::vector<char>& read,
@@ -143,8 +242,9 @@ class CorrectionContext {
 
  public:
   CorrectionContext(const KMerData& data, const std::string& read,
-                     bool reverse)
+                     bool reverse, CorrectedReads& reads)
       : data_(data)
+      , reads_(reads)
       , reversed_(reverse) {
     read_.resize(read.size());
     for (size_t i = 0; i < read.size(); ++i) {
@@ -165,6 +265,8 @@ class CorrectionContext {
 
   inline bool IsReversed() const { return reversed_; }
 
+  inline CorrectedReads& Reads() const { return reads_; }
+
   inline HRun GetHRun(size_t offset) const {
     return HRun((uint8_t)read_[offset], (uint8_t)hrun_sizes_[offset]);
   }
@@ -197,7 +299,7 @@ class StateBuilder {
         penalty_calcer_(penalty_calcer),
         context_(context),
         next_() {
-    next_.current_read_.reset(new CorrectedRead(previous_.current_read_));
+    next_.current_read_ = context_.Reads().Extend(previous_.current_read_);
     next_.kmer_ = previous_.kmer_;
     next_.penalty_state = previous_.penalty_state;
     next_.cursor_ = previous_.cursor_;
@@ -208,7 +310,7 @@ class StateBuilder {
     if (event.fixed_size_ != 0) {
       const HRun run = event.FixedHRun();
       next_.kmer_ <<= run;
-      next_.current_read_->Add(run);
+      context_.Reads().Add(next_.current_read_, run);
     }
 
     next_.cursor_ = (int16_t)(next_.cursor_ + event.overserved_size_);
@@ -228,7 +330,7 @@ class StateBuilder {
     State state;
     state.penalty_state = PenaltyCalcer::CreateState(
         context.IsReversed(), (unsigned)context.GetRead().size());
-    state.current_read_.reset(new CorrectedRead());
+    state.current_read_ = context.Reads().Extend(CorrectedReads::NO_NODE);
     size_t offset = 0;
     size_t minSkip = 0;
 
@@ -247,7 +349,7 @@ class StateBuilder {
     while (offset < skip) {
       HRun run = context.GetHRun(offset);
       state.kmer_ <<= run;
-      state.current_read_->Add(context.GetHRun(offset));
+      context.Reads().Add(state.current_read_, run);
       penalty.UpdateInitial(state.penalty_state,
                             IonEvent(run.nucl, run.len, run.len, true),
                             context.TryGetKMerStats(state.kmer_));
@@ -296,8 +398,9 @@ class MoveToNextDivergence {
 
   // we'll use it only while we move in branch…
   inline void Move() {
+    state_.current_read_ = context_.Reads().Extend(state_.current_read_);
     for (unsigned i = 0; i < Proceeded.size(); ++i) {
-      state_.current_read_->Add(Proceeded[i].FixedHRun());
+      context_.Reads().Add(state_.current_read_, Proceeded[i].FixedHRun());
       state_.kmer_ <<= Proceeded[i].FixedHRun();
       calcer_.Update(state_.penalty_state, Proceeded[i],
                     context_.TryGetKMerStats(state_.kmer_));
@@ -466,7 +569,7 @@ class CorrectLastHRun {
  private:
   inline bool AddAnotherNuclInsertions(const HRun run,
                                        const TState& previous,
-                                       std::priority_queue<TState>& corrections) {
+                                       StateQueue<TState>& corrections) {
     bool found = false;
     const auto& kmer = previous.GetHKMer();
 
@@ -508,7 +611,7 @@ class CorrectLastHRun {
         calcer_(calcer),
         is_good_function_(calcer_.Good()) {}
 
-  inline void AddOnlySimpleCorrections(std::priority_queue<TState>& corrections,
+  inline void AddOnlySimpleCorrections(StateQueue<TState>& corrections,
                                        unsigned indel_size = 1) {
     const unsigned cursor = previous_.Position();
     const HRun run = context_.GetHRun(cursor);
@@ -581,7 +684,7 @@ class CorrectLastHRun {
     }
   }
 
-  inline bool AddPossibleCorrections(std::priority_queue<TState>& corrections) {
+  inline bool AddPossibleCorrections(StateQueue<TState>& corrections) {
     const unsigned cursor = previous_.Position();
     const HRun run = context_.GetHRun(cursor);
     bool found = false;
@@ -8,7 +8,7 @@
 #include "getopt_pp/getopt_pp.h"
 #include "io/reads/io_helper.hpp"
 #include "io/reads/osequencestream.hpp"
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 #include "logger.hpp"
 #include "read_binning.hpp"
 #include "propagate.hpp"
@@ -105,7 +105,8 @@ int main(int argc, char** argv) {
     gp.kmer_mapper.Attach();
 
     INFO("Load graph and clustered paired info from " << saves_path);
-    graphio::ScanWithClusteredIndices(saves_path, gp, gp.clustered_indices);
+    if (!graphio::ScanWithClusteredIndicesBinary(saves_path, gp, gp.clustered_indices))
+        graphio::ScanWithClusteredIndices(saves_path, gp, gp.clustered_indices);
 
     //Propagation stage
     INFO("Using contigs from " << contigs_path);
@@ -5,7 +5,7 @@
  *      Author: idmit
  */
 
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "utils/stl_utils.hpp"
 #include "utils/filesystem/path_helper.hpp"
@@ -109,7 +109,8 @@ int main(int argc, char** argv) {
     conj_graph_pack gp(k, "tmp", 0);
     gp.kmer_mapper.Attach();
     INFO("Load graph from " << saves_path);
-    graphio::ScanGraphPack(saves_path, gp);
+    if (!graphio::ScanGraphPackBinary(saves_path, gp))
+        graphio::ScanGraphPack(saves_path, gp);
     gp.edge_pos.Attach();
 
     ofstream output(table_fn);
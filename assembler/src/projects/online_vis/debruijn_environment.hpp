@@ -8,7 +8,7 @@
 #pragma once
 
 #include "environment.hpp"
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 namespace online_visualization {
 
 class DebruijnEnvironment : public Environment {
@@ -53,17 +53,20 @@ class DebruijnEnvironment : public Environment {
               path_finder_(gp_.g) {
             DEBUG("Environment constructor");
             gp_.kmer_mapper.Attach();
-            debruijn_graph::graphio::ScanGraphPack(path_, gp_);
+            if (!debruijn_graph::graphio::ScanGraphPackBinary(path_, gp_))
+                debruijn_graph::graphio::ScanGraphPack(path_, gp_);
 //            debruijn_graph::graphio::ScanGraphPack(path_, gp_);
             DEBUG("Graph pack created")
             LoadFromGP();
         }
 
         inline bool IsCorrect() const {
-            if (!CheckFileExists(path_ + ".grp"))
-                return false;
-            if (!CheckFileExists(path_ + ".sqn"))
-                return false;
+            if (!debruijn_graph::graphio::CheckpointExists(path_)) {
+                if (!CheckFileExists(path_ + ".grp"))
+                    return false;
+                if (!CheckFileExists(path_ + ".sqn"))
+                    return false;
+            }
 
             size_t K = gp_.k_value;
             if (!(K >= runtime_k::MIN_K && cfg::get().K < runtime_k::MAX_K)) {
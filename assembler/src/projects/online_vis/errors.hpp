@@ -8,6 +8,7 @@
 #pragma once
 
 #include "vis_utils.hpp"
+#include "pipeline/binary_graphio.hpp"
 
 namespace online_visualization {
 
@@ -80,10 +81,12 @@ namespace online_visualization {
   }
 
   bool CheckEnvIsCorrect(string path, size_t K) {
-    if (!CheckFileExists(path + ".grp"))
-      return false;
-    if (!CheckFileExists(path + ".sqn"))
-      return false;
+    if (!debruijn_graph::graphio::CheckpointExists(path)) {
+      if (!CheckFileExists(path + ".grp"))
+        return false;
+      if (!CheckFileExists(path + ".sqn"))
+        return false;
+    }
 
     if (!(K >= runtime_k::MIN_K && cfg::get().K < runtime_k::MAX_K)) {
       LOG("K " << K << " is out of bounds");
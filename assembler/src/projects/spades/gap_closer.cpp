@@ -428,6 +428,7 @@ void GapClosing::run(conj_graph_pack &gp, const char *) {
         return;
     }
     gp.EnsureIndex();
+    gp.kmer_mapper.Freeze();
 
     auto& dataset = cfg::get_writable().ds;
     for (size_t i = 0; i < dataset.reads.lib_count(); ++i) {
@@ -293,7 +293,7 @@ void PacbioAlignLibrary(const conj_graph_pack& gp,
 
     // Initialize index
     pacbio::PacBioMappingIndex<Graph> pac_index(gp.g, pb,
-                                                mode);
+                                                mode, fs::append_path(gp.workdir, "bwa_index"));
 
     PacbioAligner aligner(pac_index, path_storage, gap_storage);
 
@@ -143,6 +143,11 @@ void assemble_genome() {
 
     SPAdes.run(conj_gp, cfg::get().entry_point.c_str());
 
+    // Cached BWA indices are of no use once the graph is gone
+    std::string bwa_cache_dir = fs::append_path(cfg::get().tmp_dir, "bwa_index");
+    if (fs::check_existence(bwa_cache_dir))
+        fs::remove_dir(bwa_cache_dir);
+
     // For informing spades.py about estimated params
     debruijn_graph::config::write_lib_data(fs::append_path(cfg::get().output_dir, "final"));
 
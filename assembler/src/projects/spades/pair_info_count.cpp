@@ -28,12 +28,14 @@ std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(const conj_graph_pack&
                                                           const SequencingLib& library) {
     if (library.type() == io::LibraryType::MatePairs) {
         INFO("Mapping mate-pairs using BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g, alignment::BWAIndex::AlignmentMode::Default, 0,
+                                                                 fs::append_path(gp.workdir, "bwa_index"));
     }
 
     if (library.data().unmerged_read_length < gp.k_value && library.type() == io::LibraryType::PairedEnd) {
         INFO("Mapping PE reads shorter than K with BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(gp.g, alignment::BWAIndex::AlignmentMode::Default, 0,
+                                                                 fs::append_path(gp.workdir, "bwa_index"));
     }
 
     INFO("Selecting usual mapper");
@@ -186,7 +188,8 @@ static bool ShouldObtainSingleReadsPaths(size_t ilib) {
 
 static bool CollectLibInformation(const conj_graph_pack &gp,
                                   size_t &edgepairs,
-                                  size_t ilib, size_t edge_length_threshold) {
+                                  size_t ilib, size_t edge_length_threshold,
+                                  SequenceMapperNotifier::MappingPathCacheT *cache) {
     INFO("Estimating insert size (takes a while)");
     InsertSizeCounter hist_counter(gp, edge_length_threshold);
     EdgePairCounterFiller pcounter(cfg::get().max_threads);
@@ -194,6 +197,8 @@ static bool CollectLibInformation(const conj_graph_pack &gp,
     SequenceMapperNotifier notifier(gp, cfg::get_writable().ds.reads.lib_count());
     notifier.Subscribe(ilib, &hist_counter);
     notifier.Subscribe(ilib, &pcounter);
+    if (cache)
+        notifier.SetMappingPathCache(*cache);
 
     SequencingLib &reads = cfg::get_writable().ds.reads[ilib];
     auto &data = reads.data();
@@ -272,7 +277,8 @@ static void ProcessSingleReads(conj_graph_pack &gp,
 static void ProcessPairedReads(conj_graph_pack &gp,
                                std::unique_ptr<PairedInfoFilter> filter,
                                unsigned filter_threshold,
-                               size_t ilib) {
+                               size_t ilib,
+                               SequenceMapperNotifier::MappingPathCacheT *cache) {
     SequencingLib &reads = cfg::get_writable().ds.reads[ilib];
     const auto &data = reads.data();
 
@@ -305,6 +311,8 @@ static void ProcessPairedReads(conj_graph_pack &gp,
                               weight, round_thr,
                               gp.paired_indices[ilib]);
     notifier.Subscribe(ilib, &pif);
+    if (cache)
+        notifier.SetMappingPathCache(*cache);
 
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, (size_t) data.mean_insert_size,
                                                 /*include merged*/true);
@@ -333,8 +341,13 @@ void PairInfoCount::run(conj_graph_pack &gp, const char *) {
                 size_t rl = lib_data.unmerged_read_length;
                 size_t k = cfg::get().K;
 
+                // Paired reads are mapped once, further passes replay the recorded paths
+                std::unique_ptr<SequenceMapperNotifier::MappingPathCacheT> cache;
+                if (cfg::get().cache_paired_mappings)
+                    cache.reset(new SequenceMapperNotifier::MappingPathCacheT(gp.g, fs::tmp::make_temp_dir(gp.workdir, "mapping_paths")));
+
                 size_t edgepairs = 0;
-                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold)) {
+                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold, cache.get())) {
                     cfg::get_writable().ds.reads[i].data().mean_insert_size = 0.0;
                     WARN("Unable to estimate insert size for paired library #" << i);
                     if (rl > 0 && rl <= k) {
@@ -373,6 +386,8 @@ void PairInfoCount::run(conj_graph_pack &gp, const char *) {
                         SequenceMapperNotifier notifier(gp, cfg::get_writable().ds.reads.lib_count());
                         DEFilter filter_counter(*filter, gp.g);
                         notifier.Subscribe(i, &filter_counter);
+                        if (cache)
+                            notifier.SetMappingPathCache(*cache);
 
                         VERIFY(lib.data().unmerged_read_length != 0);
                         auto reads = paired_binary_readers(lib, /*followed by rc*/false, 0, /*include merged*/true);
@@ -383,7 +398,7 @@ void PairInfoCount::run(conj_graph_pack &gp, const char *) {
                 INFO("Mapping library #" << i);
                 if (lib.data().mean_insert_size != 0.0) {
                     INFO("Mapping paired reads (takes a while) ");
-                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i);
+                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i, cache.get());
                 }
             }
 
@@ -30,7 +30,6 @@ def prepare_config_corr(filename, cfg, ext_python_modules_home):
     data["work_dir"] = cfg.tmp_dir
     #data["hard_memory_limit"] = cfg.max_memory
     data["max_nthreads"] = cfg.max_threads
-    data["bwa"] = cfg.bwa
     file_c = open(filename, 'w')
     pyyaml.dump(data, file_c,
                 default_flow_style=False, default_style='"', width=float("inf"))
@@ -0,0 +1,145 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_utils.hpp"
+#include "assembly_graph/dijkstra/dijkstra_helper.hpp"
+#include "paired_info/distance_estimation.hpp"
+#include "utils/perf/perfcounter.hpp"
+
+#include <queue>
+#include <set>
+
+namespace debruijn_graph {
+
+BOOST_AUTO_TEST_SUITE(dijkstra_tests)
+
+static const char DE_GRAPH[] = "./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation";
+
+inline std::vector<EdgeId> AllEdges(const Graph &g) {
+    std::vector<EdgeId> edges;
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        edges.push_back(*it);
+    return edges;
+}
+
+// Distance estimation between all pairs of edges, returns the total number
+// and length of the found paths
+inline std::pair<size_t, size_t> EstimateAllDistances(const Graph &g,
+                                                      const omnigraph::de::GraphDistanceFinder &finder) {
+    std::map<EdgeId, std::vector<size_t>> second_edges;
+    for (EdgeId e : AllEdges(g))
+        second_edges[e];
+
+    size_t cnt = 0, total = 0;
+    for (EdgeId e : AllEdges(g)) {
+        finder.FillGraphDistancesLengths(e, second_edges);
+        for (const auto &entry : second_edges) {
+            cnt += entry.second.size();
+            for (size_t len : entry.second)
+                total += len;
+        }
+    }
+    return { cnt, total };
+}
+
+// Plain bounded Dijkstra over std::map and std::priority_queue
+inline std::vector<std::pair<VertexId, size_t>> ReferenceDistances(const Graph &g, VertexId start, size_t bound,
+                                                                   std::set<VertexId> &processed) {
+    typedef std::pair<size_t, VertexId> entry_t;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+    std::map<VertexId, size_t> distances;
+    processed.clear();
+
+    queue.push({0, start});
+    while (!queue.empty()) {
+        entry_t entry = queue.top();
+        queue.pop();
+        if (!distances.insert({entry.second, entry.first}).second || entry.first > bound)
+            continue;
+        processed.insert(entry.second);
+        for (EdgeId e : g.OutgoingEdges(entry.second)) {
+            size_t dist = entry.first + g.length(e);
+            if (dist <= bound && !distances.count(g.EdgeEnd(e)))
+                queue.push({dist, g.EdgeEnd(e)});
+        }
+    }
+    return { distances.begin(), distances.end() };
+}
+
+inline std::vector<VertexId> SomeVertices(const Graph &g, size_t step) {
+    std::vector<VertexId> vertices;
+    size_t i = 0;
+    for (VertexId v : g) {
+        if (i++ % step == 0)
+            vertices.push_back(v);
+    }
+    return vertices;
+}
+
+BOOST_AUTO_TEST_CASE( BoundedDijkstraDistances ) {
+    Graph g(55);
+    graphio::ScanBasicGraph(DE_GRAPH, g);
+
+    for (size_t bound : { 0, 200, 1000, 5000 }) {
+        for (VertexId v : SomeVertices(g, 7)) {
+            auto dijkstra = omnigraph::DijkstraHelper<Graph>::CreateBoundedDijkstra(g, bound);
+            dijkstra.Run(v);
+
+            std::set<VertexId> processed;
+            auto expected = ReferenceDistances(g, v, bound, processed);
+            BOOST_CHECK(dijkstra.GetDistances() == expected);
+            BOOST_CHECK(dijkstra.ProcessedVertices() == processed);
+            BOOST_CHECK_EQUAL(dijkstra.ReachedVertices().size(), expected.size());
+            for (const auto &entry : expected) {
+                BOOST_CHECK(dijkstra.DistanceCounted(entry.first));
+                BOOST_CHECK_EQUAL(dijkstra.GetDistance(entry.first), entry.second);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( DijkstraWorkspaceReuse ) {
+    Graph g(55);
+    graphio::ScanBasicGraph(DE_GRAPH, g);
+
+    auto vertices = SomeVertices(g, 13);
+    auto outer = omnigraph::DijkstraHelper<Graph>::CreateBoundedDijkstra(g, 3000);
+    for (size_t i = 0; i + 1 < vertices.size(); ++i) {
+        outer.Run(vertices[i]);
+        auto before = outer.GetDistances();
+        {
+            // The second run must not share the state with the first one
+            auto inner = omnigraph::DijkstraHelper<Graph>::CreateBoundedDijkstra(g, 1000);
+            inner.Run(vertices[i + 1]);
+            std::set<VertexId> processed;
+            BOOST_CHECK(inner.GetDistances() == ReferenceDistances(g, vertices[i + 1], 1000, processed));
+        }
+        BOOST_CHECK(outer.GetDistances() == before);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( DistanceEstimationBenchmark ) {
+    Graph g(55);
+    graphio::ScanBasicGraph(DE_GRAPH, g);
+    omnigraph::de::GraphDistanceFinder finder(g, /*insert size*/ 1000, /*read length*/ 100, /*delta*/ 100);
+
+    const size_t rounds = 100;
+    utils::perf_counter pc;
+    for (size_t i = 0; i < rounds; ++i) {
+        auto res = EstimateAllDistances(g, finder);
+        BOOST_CHECK_EQUAL(res.first, 618);
+        BOOST_CHECK_EQUAL(res.second, 11525517);
+    }
+    INFO("Distance estimation: " << rounds * AllEdges(g).size() << " edges processed in " << pc.time() << " s");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
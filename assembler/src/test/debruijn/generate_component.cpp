@@ -9,7 +9,7 @@
 #include "utils/stl_utils.hpp"
 #include "utils/logger/log_writers.hpp"
 
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "assembly_graph/stats/picture_dump.hpp"
 
@@ -76,7 +76,8 @@ void Launch(size_t K, string saves_path, size_t start_vertex_int_id,
             string component_out_path) {
     conj_graph_pack gp(K, "tmp", 0);
     omnigraph::GraphElementFinder<Graph> element_finder(gp.g);
-    graphio::ScanGraphPack(saves_path, gp);
+    if (!graphio::ScanGraphPackBinary(saves_path, gp))
+        graphio::ScanGraphPack(saves_path, gp);
     INFO("Loaded graph with " << gp.g.size() << " vertices");
     VertexId starting_vertex = element_finder.ReturnVertexId(start_vertex_int_id);
     vector<VertexId> blocking_vertices;
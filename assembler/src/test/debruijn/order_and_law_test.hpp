@@ -9,6 +9,7 @@
 #include <boost/test/unit_test.hpp>
 #include "test_utils.hpp"
 #include "assembly_graph/handlers/id_track_handler.hpp"
+#include "pipeline/binary_graphio.hpp"
 
 namespace debruijn_graph {
 template<class Graph>
@@ -142,5 +143,28 @@ BOOST_AUTO_TEST_CASE( OrderTest ) {
 //    BOOST_CHECK(checker.CheckOrder(graph.SmartVertexBegin(), new_graph.SmartVertexBegin()));
 //    BOOST_CHECK(checker.CheckOrder(graph.SmartEdgeBegin(), new_graph.SmartEdgeBegin()));
 }
+
+// Tools reading stage saves (mts, online_vis, cap) load the binary checkpoint
+BOOST_AUTO_TEST_CASE( BinaryCheckpointTest ) {
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", gp);
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    string file_name = fs::append_path(workdir->dir(), "checkpoint");
+    graphio::PrintAllBinary(file_name, gp);
+
+    conj_graph_pack new_gp(55, "tmp", 0);
+    BOOST_CHECK(!graphio::ScanGraphPackBinary(file_name + "_absent", new_gp));
+    BOOST_REQUIRE(graphio::ScanGraphPackBinary(file_name, new_gp));
+    BOOST_CHECK_EQUAL(new_gp.g.size(), gp.g.size());
+    std::map<size_t, EdgeId> edges;
+    for (auto it = new_gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        edges[new_gp.g.int_id(*it)] = *it;
+    for (auto it = gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        auto found = edges.find(gp.g.int_id(*it));
+        BOOST_REQUIRE(found != edges.end());
+        BOOST_CHECK_EQUAL(new_gp.g.EdgeNucls(found->second), gp.g.EdgeNucls(*it));
+        BOOST_CHECK_EQUAL(new_gp.g.coverage(found->second), gp.g.coverage(*it));
+    }
+}
 BOOST_AUTO_TEST_SUITE_END()
 }
@@ -8,6 +8,15 @@
 
 #include <boost/test/unit_test.hpp>
 #include "paired_info/paired_info_helpers.hpp"
+#include "paired_info/frozen_paired_info.hpp"
+#include "paired_info/pair_info_filler.hpp"
+#include "paired_info/distance_estimation.hpp"
+#include "pipeline/graph_pack.hpp"
+#include "pipeline/graphio.hpp"
+#include "modules/alignment/sequence_mapper.hpp"
+
+#include <random>
+#include <unordered_set>
 
 namespace debruijn_graph {
 
@@ -68,7 +77,8 @@ EdgeSet GetNeighbours(const Index &pi, MockGraph::EdgeId e) {
     return result;
 }
 
-EdgeSet GetHalfNeighbours(const MockIndex &pi, MockGraph::EdgeId e) {
+template<typename Index>
+EdgeSet GetHalfNeighbours(const Index &pi, MockGraph::EdgeId e) {
     EdgeSet result;
     for (auto i : pi.GetHalf(e))
         result.insert(i.first);
@@ -87,7 +97,8 @@ EdgeDataSet GetEdgePairInfo(const MockIndex &pi) {
     return result;
 }
 
-EdgeDataSet GetNeighbourInfo(const MockIndex &pi, MockGraph::EdgeId e) {
+template<typename Index>
+EdgeDataSet GetNeighbourInfo(const Index &pi, MockGraph::EdgeId e) {
     EdgeDataSet result;
     for (auto i : pi.Get(e))
         for (auto j : i.second)
@@ -95,7 +106,8 @@ EdgeDataSet GetNeighbourInfo(const MockIndex &pi, MockGraph::EdgeId e) {
     return result;
 }
 
-bool Contains(const MockIndex &pi, MockGraph::EdgeId e1, MockGraph::EdgeId e2, float distance) {
+template<typename Index>
+bool Contains(const Index &pi, MockGraph::EdgeId e1, MockGraph::EdgeId e2, float distance) {
     for (auto p : pi.Get(e1, e2))
         if (math::eq(p.d, distance))
             return true;
@@ -435,6 +447,208 @@ BOOST_AUTO_TEST_CASE(PairedInfoPairTraverse) {
     BOOST_CHECK_EQUAL(GetEdgePairInfo(pi), test1);
 }
 
+using MockFrozenIndex = FrozenUnclusteredPairedInfoIndexT<MockGraph>;
+using MockFrozenClIndex = FrozenPairedInfoIndexT<MockGraph>;
+
+const MockGraph::EdgeId kMockEdges[] = {1, 2, 3, 4, 5, 7, 8, 9, 13, 14};
+
+//Checks that both indices give the same points, including weights and variances
+template<typename Index1, typename Index2>
+void CheckSameInfo(const Index1 &pi1, const Index2 &pi2) {
+    BOOST_CHECK_EQUAL(pi1.size(), pi2.size());
+    for (auto e1 : kMockEdges) {
+        BOOST_CHECK_EQUAL(pi1.contains(e1), pi2.contains(e1));
+        BOOST_CHECK_EQUAL(GetNeighbours(pi1, e1), GetNeighbours(pi2, e1));
+        BOOST_CHECK_EQUAL(GetHalfNeighbours(pi1, e1), GetHalfNeighbours(pi2, e1));
+        for (auto e2 : kMockEdges) {
+            BOOST_CHECK_EQUAL(pi1.contains(e1, e2), pi2.contains(e1, e2));
+            auto h1 = pi1.Get(e1, e2), h2 = pi2.Get(e1, e2);
+            BOOST_CHECK_EQUAL(h1.size(), h2.size());
+            BOOST_CHECK_EQUAL(pi1.GetHalf(e1)[e2].size(), pi2.GetHalf(e1)[e2].size());
+            auto i2 = h2.begin();
+            for (auto p1 : h1) {
+                auto p2 = *i2++;
+                BOOST_CHECK_EQUAL(p1.d, p2.d);
+                BOOST_CHECK_EQUAL(p1.weight, p2.weight);
+                BOOST_CHECK_EQUAL(p1.variance(), p2.variance());
+            }
+            BOOST_CHECK(i2 == h2.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FrozenPairedInfoAccess) {
+    MockGraph graph;
+    MockIndex pi(graph);
+    pi.Add(1, 3, RawPoint(1, 1));
+    pi.Add(1, 3, RawPoint(5, 2));
+    pi.Add(1, 3, RawPoint(300, 1));
+    pi.Add(1, 9, RawPoint(2, 1));
+    pi.Add(8, 14, RawPoint(-3, 1));
+    pi.Add(3, 2, RawPoint(4, 1.5));
+    pi.Add(13, 4, RawPoint(5.5, 1));
+    pi.Add(9, 2, RawPoint(6, 1));
+    pi.Add(2, 13, RawPoint(7, 1));
+    pi.Add(1, 1, RawPoint(0, 0));
+
+    MockFrozenIndex fpi(pi);
+    CheckSameInfo(pi, fpi);
+    BOOST_CHECK_EQUAL(GetNeighbourInfo(fpi, 1), GetNeighbourInfo(pi, 1));
+    BOOST_CHECK(Contains(fpi, 4, 2, 7));
+    BOOST_CHECK(fpi.Get(5).empty());
+    BOOST_CHECK_EQUAL(fpi.Get(1, 3).min().d, 1);
+    BOOST_CHECK_EQUAL(fpi.Get(1, 3).max().d, 300);
+    RawHistogram test13;
+    test13.insert({1, 1});
+    test13.insert({5, 2});
+    test13.insert({300, 1});
+    BOOST_CHECK_EQUAL(fpi.Get(1)[3].Unwrap(), test13);
+    BOOST_CHECK_EQUAL(fpi.GetHalf(4)[2].Unwrap(), RawHistogram());
+}
+
+BOOST_AUTO_TEST_CASE(FrozenPairedInfoClustered) {
+    MockGraph graph;
+    MockClIndex pi(graph);
+    pi.Add(1, 8, {1, 1, 0});
+    pi.Add(1, 3, {2, 2, 0.5});
+    pi.Add(1, 3, {10.25, 0.125, 3});
+    pi.Add(13, 2, {-7, 1, 2});
+
+    MockFrozenClIndex fpi(pi);
+    CheckSameInfo(pi, fpi);
+    BOOST_CHECK(!fpi.contains(5));
+    BOOST_CHECK(!fpi.contains(1, 5));
+    BOOST_CHECK(fpi.Get(1, 5).empty());
+}
+
+BOOST_AUTO_TEST_CASE(FrozenPairedInfoUnfreeze) {
+    MockGraph graph;
+    MockIndex pi(graph);
+    pi.Add(1, 3, RawPoint(1, 1));
+    pi.Add(1, 3, RawPoint(2.5, 3));
+    pi.Add(1, 9, RawPoint(2, 1));
+    pi.Add(3, 13, RawPoint(-4, 1));
+    pi.Add(1, 2, RawPoint(6, 1));
+    pi.Add(2, 2, RawPoint(0, 1));
+
+    MockFrozenIndex fpi(pi);
+    MockIndex upi(graph);
+    upi.Add(5, 7, RawPoint(1, 1));
+    fpi.Unfreeze(upi);
+    CheckSameInfo(pi, upi);
+    BOOST_CHECK_EQUAL(GetEdgePairInfo(upi), GetEdgePairInfo(pi));
+    BOOST_CHECK(!upi.contains(5));
+
+    //Conjugate pairs still share histograms
+    upi.Add(1, 3, RawPoint(7, 1));
+    BOOST_CHECK(Contains(upi, 4, 2, 9));
+
+    fpi.clear();
+    BOOST_CHECK_EQUAL(fpi.size(), 0);
+    BOOST_CHECK(!fpi.contains(1));
+    BOOST_CHECK(fpi.Get(1).empty());
+}
+
+static const size_t FROZEN_READ_LENGTH = 100;
+static const size_t FROZEN_INSERT_SIZE = 300;
+static const size_t FROZEN_IS_VAR = 20;
+
+//Paired reads are sampled from random walks over the graph, as if they were parts of the genome
+void FillSampledPairs(const conj_graph_pack &gp, UnclusteredPairedInfoIndexT<Graph> &pi) {
+    const Graph &g = gp.g;
+    auto mapper = MapperInstance(gp);
+    LatePairedIndexFiller filler(g, [](const std::pair<EdgeId, EdgeId> &, const MappingRange &, const MappingRange &) {
+                                     return 1.;
+                                 }, 0, pi);
+    std::mt19937 rnd(42);
+    std::normal_distribution<double> insert_size((double) FROZEN_INSERT_SIZE, (double) FROZEN_IS_VAR);
+
+    filler.StartProcessLibrary(1);
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        Sequence fragment = g.EdgeNucls(*it);
+        EdgeId e = *it;
+        while (fragment.size() < 3 * FROZEN_INSERT_SIZE && g.OutgoingEdgeCount(g.EdgeEnd(e))) {
+            auto out = g.OutgoingEdges(g.EdgeEnd(e));
+            e = *std::next(out.begin(), rnd() % g.OutgoingEdgeCount(g.EdgeEnd(e)));
+            fragment = fragment + g.EdgeNucls(e).Subseq(g.k());
+        }
+        for (size_t pos = 0; pos + FROZEN_INSERT_SIZE + 3 * FROZEN_IS_VAR < fragment.size(); pos += 10) {
+            size_t is = size_t(insert_size(rnd));
+            io::PairedRead pair(io::SingleRead("left", fragment.Subseq(pos, pos + FROZEN_READ_LENGTH).str()),
+                                io::SingleRead("right", fragment.Subseq(pos + is - FROZEN_READ_LENGTH, pos + is).str()),
+                                is);
+            filler.ProcessPairedRead(0, pair, mapper->MapRead(pair.first()), mapper->MapRead(pair.second()));
+        }
+    }
+    filler.StopProcessLibrary();
+}
+
+//Lower bound of the memory taken by a mutable index: the entries of the inner maps
+//and the histograms, without the tree nodes and the allocator overhead
+template<typename Index>
+size_t MutableIndexBytes(const Index &pi) {
+    std::unordered_set<const void*> hists;
+    size_t bytes = 0;
+    for (auto i = pi.data_begin(); i != pi.data_end(); ++i) {
+        for (const auto &entry : i->second) {
+            bytes += sizeof(entry);
+            if (hists.insert(entry.second.get()).second)
+                bytes += sizeof(*entry.second) + entry.second->size() * sizeof(*entry.second->begin());
+        }
+    }
+    return bytes;
+}
+
+template<typename Index, typename FrozenIndex>
+void CheckSameHistograms(const Index &pi, const FrozenIndex &fpi) {
+    BOOST_CHECK_EQUAL(pi.size(), fpi.size());
+    for (auto i = pi.data_begin(); i != pi.data_end(); ++i) {
+        for (const auto &entry : i->second) {
+            auto h1 = pi.Get(i->first, entry.first), h2 = fpi.Get(i->first, entry.first);
+            BOOST_REQUIRE_EQUAL(h1.size(), h2.size());
+            auto i2 = h2.begin();
+            for (auto p1 : h1) {
+                auto p2 = *i2++;
+                BOOST_CHECK_EQUAL(p1.d, p2.d);
+                BOOST_CHECK_EQUAL(p1.weight, p2.weight);
+                BOOST_CHECK_EQUAL(p1.variance(), p2.variance());
+            }
+        }
+    }
+}
+
+//As for real libraries, the pairs of edges mostly get a single distance, so the index
+//consists of many short histograms
+BOOST_AUTO_TEST_CASE(FrozenPairedInfoMemory) {
+    fs::make_dirs("tmp");
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", gp);
+
+    UnclusteredPairedInfoIndexT<Graph> raw(gp.g);
+    FillSampledPairs(gp, raw);
+    BOOST_REQUIRE(raw.size() > 0);
+
+    GraphDistanceFinder dist_finder(gp.g, FROZEN_INSERT_SIZE, FROZEN_READ_LENGTH, FROZEN_IS_VAR);
+    DistanceEstimator estimator(gp.g, raw, dist_finder, 0, 2 * FROZEN_IS_VAR);
+    PairedInfoIndexT<Graph> clustered(gp.g);
+    estimator.Estimate(clustered, 1);
+    BOOST_REQUIRE(clustered.size() > 0);
+
+    FrozenUnclusteredPairedInfoIndexT<Graph> frozen_raw(raw);
+    CheckSameHistograms(raw, frozen_raw);
+    size_t raw_bytes = MutableIndexBytes(raw);
+    INFO("Unclustered index: " << raw.size() << " points, " << raw_bytes << " bytes mutable (at least), "
+         << frozen_raw.bytes_used() << " bytes frozen");
+    BOOST_CHECK_LT(frozen_raw.bytes_used(), raw_bytes);
+
+    FrozenPairedInfoIndexT<Graph> frozen_clustered(clustered);
+    CheckSameHistograms(clustered, frozen_clustered);
+    size_t clustered_bytes = MutableIndexBytes(clustered);
+    INFO("Clustered index: " << clustered.size() << " points, " << clustered_bytes << " bytes mutable (at least), "
+         << frozen_clustered.bytes_used() << " bytes frozen");
+    BOOST_CHECK_LT(frozen_clustered.bytes_used(), clustered_bytes);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -22,6 +22,19 @@
 #include "modules/path_extend/pe_utils.hpp"
 namespace path_extend {
 
+//Checks LengthAt against lengths recomputed from the edges and gaps
+inline bool LengthsConsistent(const BidirectionalPath &path) {
+    size_t len = 0;
+    for (size_t i = path.Size(); i > 0; --i) {
+        len += path.g().length(path[i - 1]);
+        if (path.LengthAt(i - 1) != len)
+            return false;
+        if (i > 1)
+            len += path.GapAt(i - 1).gap;
+    }
+    return path.Length() == len;
+}
+
 BOOST_FIXTURE_TEST_SUITE(path_extend_basic, fs::TmpFolderFixture)
 
 BOOST_AUTO_TEST_CASE( BidirectionalPathConstructor ) {
@@ -765,6 +778,132 @@ BOOST_AUTO_TEST_CASE( BidirectionalPathLoopDetector ) {
 }
 
 
+BOOST_AUTO_TEST_CASE( BidirectionalPathPositionLengths ) {
+    Graph g(13);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/path_extend/distance_estimation", g);
+    EdgeId start = *g.ConstEdgeBegin();
+
+    // 98 26 145 70
+    EdgeId e1 = g.conjugate(start);
+    EdgeId e2 = *(g.OutgoingEdges(g.EdgeEnd(e1)).begin());
+    EdgeId e3 = *(g.OutgoingEdges(g.EdgeEnd(e2)).begin());
+    EdgeId e4 = *(g.OutgoingEdges(g.EdgeEnd(e3)).begin());
+
+    BidirectionalPath p(g);
+    BidirectionalPath cp(g);
+    cp.Subscribe(&p);
+    p.Subscribe(&cp);
+
+    //Pushes to cp are pushes to the front of p and vice versa
+    p.PushBack(e2);
+    cp.PushBack(g.conjugate(e1), Gap(7));
+    p.PushBack(e3, Gap(-5));
+    p.PushBack(e4, Gap(100));
+    BOOST_CHECK_EQUAL(p.Size(), 4);
+    BOOST_CHECK_EQUAL(p.Front(), e1);
+    BOOST_CHECK_EQUAL(p.Length(), 1164);
+    BOOST_CHECK_EQUAL(p.LengthAt(1), 731);
+    BOOST_CHECK_EQUAL(cp.Length(), 1164);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+    BOOST_CHECK(cp.Conjugate() == p);
+    BOOST_CHECK(LengthsConsistent(p.Conjugate()));
+
+    //Removal from both ends
+    p.PopBack();
+    BOOST_CHECK_EQUAL(p.Length(), 1008);
+    BOOST_CHECK(LengthsConsistent(p));
+    cp.PopBack();
+    BOOST_CHECK_EQUAL(p.Front(), e2);
+    BOOST_CHECK_EQUAL(p.Length(), 575);
+    BOOST_CHECK_EQUAL(p.GapAt(0).gap, 0);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+
+    //Growing again after removals reuses the freed positions
+    cp.PushBack(g.conjugate(e1), Gap(3));
+    p.PushBack(e4, Gap(1));
+    BOOST_CHECK_EQUAL(p.Length(), 1061);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+
+    for (size_t from = 0; from < p.Size(); ++from) {
+        for (size_t to = from; to <= p.Size(); ++to) {
+            BidirectionalPath sub = p.SubPath(from, to);
+            BOOST_CHECK(LengthsConsistent(sub));
+            if (from < to)
+                BOOST_CHECK_EQUAL(sub.Length(), p.LengthAt(from) - p.LengthAt(to - 1) + g.length(p[to - 1]));
+        }
+    }
+
+    p.Clear();
+    BOOST_CHECK(p.Empty());
+    BOOST_CHECK(cp.Empty());
+    BOOST_CHECK_EQUAL(p.Length(), 0);
+
+    p.PushBack(e3);
+    cp.PushBack(g.conjugate(e2), Gap(20));
+    BOOST_CHECK_EQUAL(p.Length(), 600);
+    BOOST_CHECK_EQUAL(p.LengthAt(1), 579);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+}
+
+BOOST_AUTO_TEST_CASE( BidirectionalPathLong ) {
+    Graph g(13);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/path_extend/distance_estimation", g);
+    EdgeId start = *g.ConstEdgeBegin();
+
+    // 98 26 145 70 3 139 139
+    EdgeId e1 = g.conjugate(start);
+    EdgeId e2 = *(g.OutgoingEdges(g.EdgeEnd(e1)).begin());
+    EdgeId e3 = *(g.OutgoingEdges(g.EdgeEnd(e2)).begin());
+    EdgeId e4 = *(g.OutgoingEdges(g.EdgeEnd(e3)).begin());
+    EdgeId e5 = *(g.OutgoingEdges(g.EdgeEnd(e4)).begin());
+    auto it5 = g.OutgoingEdges(g.EdgeEnd(e5)).begin();
+    ++it5;
+    EdgeId e6 = *it5;
+
+    BidirectionalPath p(g);
+    BidirectionalPath cp(g);
+    cp.Subscribe(&p);
+    p.Subscribe(&cp);
+
+    //Would take ~10^10 length updates if every push shifted all the lengths
+    const size_t size = 100000;
+    const size_t cycle_length = g.length(e5) + g.length(e6);
+    for (size_t i = 0; i < size / 2; ++i) {
+        p.PushBack(e5);
+        p.PushBack(e6);
+    }
+    BOOST_CHECK_EQUAL(p.Size(), size);
+    BOOST_CHECK_EQUAL(p.Length(), size / 2 * cycle_length);
+    BOOST_CHECK_EQUAL(p.LengthAt(size / 2), size / 4 * cycle_length);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+
+    for (size_t i = 0; i < size / 4; ++i) {
+        cp.PopBack();
+        p.PopBack();
+    }
+    BOOST_CHECK_EQUAL(p.Size(), size / 2);
+    BOOST_CHECK_EQUAL(p.Front(), e5);
+    BOOST_CHECK_EQUAL(p.Back(), e6);
+    BOOST_CHECK_EQUAL(p.Length(), size / 4 * cycle_length);
+    BOOST_CHECK(LengthsConsistent(p));
+    BOOST_CHECK(LengthsConsistent(cp));
+
+    BidirectionalPath sub = p.SubPath(size / 8, size / 4);
+    BOOST_CHECK_EQUAL(sub.Length(), size / 16 * cycle_length);
+    BOOST_CHECK(LengthsConsistent(sub));
+    BOOST_CHECK(cp.Conjugate() == p);
+
+    p.Clear();
+    BOOST_CHECK(cp.Empty());
+    BOOST_CHECK_EQUAL(cp.Length(), 0);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
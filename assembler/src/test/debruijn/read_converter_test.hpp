@@ -0,0 +1,81 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+
+#include "pipeline/config_struct.hpp"
+#include "io/dataset_support/read_converter.hpp"
+#include "utils/filesystem/temporary.hpp"
+
+namespace debruijn_graph {
+
+BOOST_AUTO_TEST_SUITE(read_converter_tests)
+
+static const size_t CONVERTER_BUFFER_SIZE = 16ULL << 20;
+
+inline io::DataSet<config::LibraryData> PairedDataSet() {
+    io::SequencingLibrary<config::LibraryData> lib;
+    lib.set_type(io::LibraryType::PairedEnd);
+    lib.set_orientation(io::LibraryOrientation::FR);
+    lib.push_back_paired(fs::make_full_path("./test_dataset/ecoli_1K_1.fq.gz"),
+                         fs::make_full_path("./test_dataset/ecoli_1K_2.fq.gz"));
+
+    io::DataSet<config::LibraryData> dataset;
+    dataset.push_back(lib);
+    return dataset;
+}
+
+inline size_t CountPairedReads(io::SequencingLibrary<config::LibraryData> &lib) {
+    auto streams = io::paired_binary_readers(lib, false, 0, false);
+    size_t cnt = 0;
+    io::PairedReadSeq read;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        while (!streams[i].eof()) {
+            streams[i] >> read;
+            ++cnt;
+        }
+    }
+    return cnt;
+}
+
+// Restart reads the library data saved by the previous run: the reads are already
+// converted and the binary files have to be split between the current threads
+BOOST_AUTO_TEST_CASE( BinaryReadsAfterRestart ) {
+    fs::make_dirs("tmp");
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    std::string bin_path = workdir->dir() + "/";
+
+    auto dataset = PairedDataSet();
+    config::init_libs(dataset, 2, CONVERTER_BUFFER_SIZE, bin_path);
+    size_t read_cnt = CountPairedReads(dataset[0]);
+    BOOST_REQUIRE(read_cnt > 0);
+    BOOST_CHECK_EQUAL(dataset[0].data().binary_reads_info.file_num, 2u);
+
+    std::string lib_data = bin_path + "lib_data.yaml";
+    dataset.save(lib_data);
+
+    for (size_t threads : {1, 2, 3}) {
+        io::DataSet<config::LibraryData> restarted(lib_data);
+        config::init_libs(restarted, threads, CONVERTER_BUFFER_SIZE, bin_path);
+        const auto &info = restarted[0].data().binary_reads_info;
+        BOOST_CHECK(info.binary_converted);
+        BOOST_CHECK_EQUAL(info.file_num, 2u);
+        BOOST_CHECK_EQUAL(CountPairedReads(restarted[0]), read_cnt);
+    }
+
+    // Library data saved by the older versions lacks the number of binary files
+    io::DataSet<config::LibraryData> restarted(lib_data);
+    config::init_libs(restarted, 3, CONVERTER_BUFFER_SIZE, bin_path);
+    restarted[0].data().binary_reads_info.file_num = 0;
+    BOOST_CHECK_EQUAL(CountPairedReads(restarted[0]), read_cnt);
+    BOOST_CHECK_EQUAL(restarted[0].data().binary_reads_info.file_num, 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,172 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+
+#include "test_utils.hpp"
+#include "pipeline/graph_pack.hpp"
+#include "modules/alignment/sequence_mapper.hpp"
+#include "utils/perf/perfcounter.hpp"
+
+namespace debruijn_graph {
+
+BOOST_AUTO_TEST_SUITE(sequence_mapper_tests)
+
+static const char MAPPER_GRAPH[] = "./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation";
+static const size_t MAPPER_READ_LENGTH = 150;
+
+struct SampledRead {
+    Sequence read;
+    EdgeId edge;
+    size_t offset;
+};
+
+// Error-free reads sampled from the edges with the given step
+inline std::vector<SampledRead> SampleReads(const Graph &g, size_t step) {
+    std::vector<SampledRead> reads;
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        const Sequence &nucls = g.EdgeNucls(*it);
+        for (size_t offset = 0; offset + MAPPER_READ_LENGTH <= nucls.size(); offset += step)
+            reads.push_back({ nucls.Subseq(offset, offset + MAPPER_READ_LENGTH), *it, offset });
+    }
+    return reads;
+}
+
+inline Sequence WithSubstitution(const Sequence &s, size_t pos) {
+    std::string nucls = s.str();
+    nucls[pos] = (nucls[pos] == 'A' ? 'C' : 'A');
+    return Sequence(nucls);
+}
+
+BOOST_AUTO_TEST_CASE( MapEdgeSubstrings ) {
+    // The edge index is built from scratch in the working directory
+    fs::make_dirs("tmp");
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack(MAPPER_GRAPH, gp);
+    auto mapper = MapperInstance(gp);
+
+    size_t kmers = MAPPER_READ_LENGTH - gp.g.k();
+    for (const auto &r : SampleReads(gp.g, 37)) {
+        auto path = mapper->MapSequence(r.read);
+        BOOST_REQUIRE_EQUAL(path.size(), 1u);
+        BOOST_CHECK(path.edge_at(0) == r.edge);
+        BOOST_CHECK_EQUAL(path.mapping_at(0).initial_range, Range(0, kmers));
+        BOOST_CHECK_EQUAL(path.mapping_at(0).mapped_range, Range(r.offset, r.offset + kmers));
+
+        // K-mers on both sides of the error are looked up in the index (and prefetched)
+        auto err_path = mapper->MapSequence(WithSubstitution(r.read, MAPPER_READ_LENGTH / 2));
+        BOOST_REQUIRE(!err_path.empty());
+        BOOST_CHECK(err_path.edge_at(0) == r.edge);
+        BOOST_CHECK(err_path.edge_at(err_path.size() - 1) == r.edge);
+        BOOST_CHECK_EQUAL(err_path.mapping_at(0).mapped_range.start_pos, r.offset);
+        BOOST_CHECK_EQUAL(err_path.mapping_at(err_path.size() - 1).mapped_range.end_pos, r.offset + kmers);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( SequenceMappingBenchmark ) {
+    fs::make_dirs("tmp");
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack(MAPPER_GRAPH, gp);
+    auto mapper = MapperInstance(gp);
+
+    std::vector<Sequence> reads;
+    for (const auto &r : SampleReads(gp.g, 7)) {
+        reads.push_back(r.read);
+        reads.push_back(WithSubstitution(r.read, MAPPER_READ_LENGTH / 3));
+    }
+
+    const size_t rounds = 5;
+    size_t mapped = 0;
+    utils::perf_counter pc;
+    for (size_t i = 0; i < rounds; ++i) {
+        for (const auto &read : reads)
+            mapped += mapper->MapSequence(read).size();
+    }
+    BOOST_CHECK(mapped >= rounds * reads.size());
+    INFO("Sequence mapping: " << rounds * reads.size() << " reads mapped in " << pc.time() << " s");
+}
+
+// K-mers (and their complements) around the substitution, both remapped and not
+inline void CollectKmers(const Sequence &s, size_t pos, unsigned k, std::vector<RtSeq> &kmers) {
+    Sequence window = s.Subseq(pos - k - 1, pos + k + 2);
+    RtSeq kmer = window.start<RtSeq>(k) >> 'A';
+    for (size_t i = k - 1; i < window.size(); ++i) {
+        kmer <<= window[i];
+        kmers.push_back(kmer);
+        kmers.push_back(!kmer);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( KmerMapperFreeze ) {
+    fs::make_dirs("tmp");
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack(MAPPER_GRAPH, gp);
+    auto &kmer_mapper = gp.kmer_mapper;
+    kmer_mapper.SetUnsafeMode(false);
+    unsigned k = kmer_mapper.k();
+
+    // Two substitutions are glued into the edge one after another, as the bulges
+    // would be, so that the mapping has chains to be normalized by Freeze
+    std::vector<RtSeq> kmers;
+    std::vector<std::pair<RtSeq, RtSeq>> chains;
+    for (auto it = gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        const Sequence &nucls = gp.g.EdgeNucls(*it);
+        if (nucls.size() < 3 * k)
+            continue;
+        size_t pos = nucls.size() / 2;
+        Sequence err1 = WithSubstitution(nucls, pos);
+        Sequence err2 = WithSubstitution(err1, pos + 1);
+        kmer_mapper.RemapKmers(err2, err1);
+        kmer_mapper.RemapKmers(err1, nucls);
+        for (const auto &s : { nucls, err1, err2 })
+            CollectKmers(s, pos, k, kmers);
+        chains.emplace_back(RtSeq(k, err2, pos + 1 - k + 1), RtSeq(k, nucls, pos + 1 - k + 1));
+    }
+    BOOST_REQUIRE(!chains.empty());
+    BOOST_REQUIRE(kmer_mapper.size() > 0);
+
+    std::vector<RtSeq> substituted;
+    std::vector<bool> mapped;
+    for (const auto &kmer : kmers) {
+        substituted.push_back(kmer_mapper.Substitute(kmer));
+        mapped.push_back(kmer_mapper.CanSubstitute(kmer));
+    }
+    for (const auto &chain : chains)
+        BOOST_CHECK_EQUAL(kmer_mapper.Substitute(chain.first), chain.second);
+
+    auto check_lookups = [&]() {
+        for (size_t i = 0; i < kmers.size(); ++i) {
+            BOOST_CHECK_EQUAL(kmer_mapper.Substitute(kmers[i]), substituted[i]);
+            BOOST_CHECK_EQUAL(kmer_mapper.CanSubstitute(kmers[i]), mapped[i]);
+        }
+    };
+
+    kmer_mapper.Freeze();
+    BOOST_REQUIRE(kmer_mapper.frozen());
+    check_lookups();
+    kmer_mapper.Thaw();
+    BOOST_REQUIRE(!kmer_mapper.frozen());
+    check_lookups();
+
+    // Frozen copy of the plain map has the same keys and values
+    KMerMap map(k);
+    for (auto it = kmer_mapper.begin(); it != kmer_mapper.end(); ++it)
+        map.set(it->first, it->second);
+    FrozenKMerMap frozen(map, k);
+    BOOST_CHECK_EQUAL(frozen.size(), map.size());
+    for (const auto &kmer : kmers) {
+        const auto *value = frozen.find(kmer);
+        BOOST_CHECK_EQUAL(value != nullptr, map.count(kmer));
+        if (value && map.count(kmer))
+            BOOST_CHECK_EQUAL(RtSeq(k, value), RtSeq(k, map.find(kmer)));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -9,7 +9,7 @@
 #include "utils/stl_utils.hpp"
 #include "utils/logger/log_writers.hpp"
 
-#include "pipeline/graphio.hpp"
+#include "pipeline/binary_graphio.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "assembly_graph/stats/picture_dump.hpp"
 #include "assembly_graph/components/splitters.hpp"
@@ -50,7 +50,8 @@ void Launch(size_t K, string saves_path, size_t edge_length_bound,
     fs::TmpFolderFixture tmp_dir("tmp");
     //TODO no need for whole graph pack; change to Graph
     conj_graph_pack gp(K, "tmp", 0);
-    graphio::ScanGraphPack(saves_path, gp);
+    if (!graphio::ScanGraphPackBinary(saves_path, gp))
+        graphio::ScanGraphPack(saves_path, gp);
 
 
     io::OFastaReadStream oss(fastg_output);
@@ -20,6 +20,9 @@
 #include "overlap_analysis_test.hpp"
 //#include "detail_coverage_test.hpp"
 #include "paired_info_test.hpp"
+#include "dijkstra_test.hpp"
+#include "sequence_mapper_test.hpp"
+#include "read_converter_test.hpp"
 //fixme why is it disabled
 //#include "pair_info_test.hpp"
 